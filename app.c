@@ -1,17 +1,39 @@
 #include "raylib.h"
-#include <sqlite3.h>
+#include "db.h"
+#include "dbworker.h"
+#include "frame.h"
+#include "input.h"
+#include "journal.h"
+#include "profile.h"
+#include "reminder.h"
+#include "search.h"
+#include "server.h"
+#include "storage.h"
+#include "taskcore.h"
+#include "taskstore.h"
+#include "textcache.h"
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <time.h>
 
 #define MAX_INPUT_LEN 256
-#define MAX_TASKS 100
-
-typedef struct {
-    int id;
-    char title[MAX_INPUT_LEN];
-    bool completed;
-} Task;
+#define LIST_TOP 150
+#define LIST_HEIGHT 450
+#define ROW_HEIGHT 50
+#define SCROLL_STEP 40.0f
+#define MAX_PENDING 64
+#define HEADER_HEIGHT 130
+#define TRACE_PATH "trace.json"
+#define DEFAULT_DB_PATH "users.db"
+#define BENCH_SCROLL_ROWS 3
+#define TITLE_MAX_WIDTH 540 // Row titles stop short of the Done button
+#define BULK_BAR_Y 127
+#define DRAG_THRESHOLD 6 // Pixels a press must travel to become a drag
+#define REMINDER_BAR_Y 58
+#define SNOOZE_SECONDS 600
 
 typedef enum {
     SCREEN_REGISTRATION,
@@ -19,108 +41,530 @@ typedef enum {
     SCREEN_DASHBOARD
 } ScreenState;
 
+typedef struct {
+    float scrollOffset; // Pixels scrolled past the first row
+    int dragId;         // Task pressed for a possible drag; 0 for none
+    int dragIndex;      // Its row when pressed
+    int dragStartY;
+    bool dragging;      // Moved far enough that the release drops it
+} TaskListView;
+
+// Timed runs: the scripted scroll for bench scale, or a replay. Every frame
+// is drawn and timed, then the frame times and the resulting task list are
+// summarised as JSON.
+typedef struct {
+    int frames;           // Scripted frames to draw; 0 for none
+    const char *jsonPath;
+    double *samples;      // Milliseconds per frame, including the buffer swap
+    int count;
+    int capacity;
+} FrameBenchmark;
+
+// Jobs submitted to the database worker that have not completed yet, in
+// the order they were made. Held jobs are not submitted yet (id 0): they
+// wait for the journal to write out the changes made before them.
+typedef struct {
+    DbJob jobs[MAX_PENDING];
+    int count;
+    int held;
+} PendingJobs;
+
+// Selected rows as sorted, disjoint spans of list keys. A shift-click range
+// over the whole list is one span, so it can cover rows that were never
+// loaded; search results are added one key at a time, since the rows between
+// two matches aren't selected. selected counts rows as of when they were
+// picked and only feeds the label.
+typedef struct {
+    TaskSpan *spans;
+    int count;
+    int capacity;
+    int anchorIndex; // Row of the last plain or ctrl click; -1 for none
+    TaskKey anchorKey;
+    int selected;
+} TaskSelection;
+
 // Function Prototypes
-void AddTask(const char *username, const char *title, sqlite3 *db);
-int FetchTasks(const char *username, Task tasks[], sqlite3 *db);
-void MarkTaskComplete(int taskId, sqlite3 *db);
-void DeleteTask(int taskId, sqlite3 *db);
-void DrawDashboard(const char *username, sqlite3 *db);
+bool SubmitPendingJob(DbWorker *worker, PendingJobs *pending, DbJob *job);
+bool SubmitDirectJob(DbWorker *worker, PendingJobs *pending, TaskJournal *journal, DbJob *job);
+void SubmitHeldJobs(DbWorker *worker, PendingJobs *pending, TaskJournal *journal);
+void SubmitBulkJob(DbWorker *worker, PendingJobs *pending, TaskJournal *journal, DbJobType type, int userId, TaskSelection *selection);
+void FinishPendingJob(PendingJobs *pending, unsigned jobId);
+const DbJob *FindPendingTaskJob(const PendingJobs *pending, TaskKey key);
+void ApplyJobToTaskStore(TaskStore *store, const DbJob *job);
+void SubmitJournalBatch(DbWorker *worker, PendingJobs *pending, TaskJournal *journal, FrameScheduler *frames);
+void DrainTaskJournal(DbWorker *worker, PendingJobs *pending, TaskJournal *journal);
+RenderTexture2D BuildDashboardHeader(const char *username);
+void DrawDashboard(RenderTexture2D header, int userId, DbWorker *worker, TaskStore *store, TaskSearch *search, ReminderScheduler *reminders, PendingJobs *pending, TaskJournal *journal, FrameScheduler *frames);
+void DrawReminderBar(ReminderScheduler *reminders, int userId, DbWorker *worker, PendingJobs *pending, TaskJournal *journal);
 void HandleTaskInput(bool *focused, char input[], int maxLength);
-void DrawTasks(Task tasks[], int taskCount, sqlite3 *db);
+void ScrollTaskList(TaskListView *view, int taskCount);
+void DrawTasks(TaskListView *view, TaskStore *store, TaskSearch *search, bool searching, bool typing, DbWorker *worker, PendingJobs *pending, TaskJournal *journal, TaskSelection *selection);
+void ClearSelection(TaskSelection *selection);
+bool AddSelectedTask(TaskSelection *selection, TaskKey key);
+void ToggleSelectedTask(TaskSelection *selection, TaskKey key);
+void SelectTaskRange(TaskSelection *selection, TaskSearch *search, bool searching, int index, TaskKey key);
+void SelectAllTasks(TaskSelection *selection, TaskSearch *search, bool searching, int taskCount);
+bool DropDraggedTask(TaskListView *view, TaskStore *store, int taskCount, DbWorker *worker, PendingJobs *pending, TaskJournal *journal);
+bool DrawSmallButton(const char *label, int x, int y, int width);
+void DrawProfilerOverlay(void);
+void AddFrameSample(FrameBenchmark *bench, double ms);
+bool WriteFrameBenchmark(FrameBenchmark *bench, const char *dbPath, int userId);
 
-int main(void) {
-    InitWindow(800, 600, "Task Manager");
-    SetTargetFPS(60);
+// File scope so the frame benchmark can drive scrolling
+static TaskListView listView = {0};
+// Row text is laid out once and redrawn from here
+static TextCache textCache;
+// File scope too, since a rank rebalance seen by the completion loop clears it
+static TaskSelection selection = {.anchorIndex = -1};
 
-    sqlite3 *db;
-    if (sqlite3_open("users.db", &db)) {
-        printf("Failed to open database: %s\n", sqlite3_errmsg(db));
+int main(int argc, char **argv) {
+    const char *dbPath = DEFAULT_DB_PATH;
+    char loggedInUsername[MAX_INPUT_LEN] = "testuser"; // Simulated logged-in user
+    FrameBenchmark bench = {0};
+    ServerConfig server = {.maxBatch = SERVER_BATCH_MAX};
+    bool badOption = false;
+    for (int i = 1; i < argc && !badOption; i++) {
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            dbPath = argv[++i];
+        } else if (strcmp(argv[i], "--user") == 0 && i + 1 < argc) {
+            snprintf(loggedInUsername, sizeof(loggedInUsername), "%s", argv[++i]);
+        } else if (strcmp(argv[i], "--bench-frames") == 0 && i + 1 < argc) {
+            bench.frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-json") == 0 && i + 1 < argc) {
+            bench.jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            server.socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--serve-batch") == 0 && i + 1 < argc) {
+            server.maxBatch = atoi(argv[++i]);
+        } else {
+            badOption = !ParseInputOption(argc, argv, &i);
+        }
+    }
+    if (badOption || server.maxBatch < 1 || server.maxBatch > SERVER_BATCH_MAX) {
+        printf("usage: %s [--db PATH] [--user NAME] [--bench-frames N] [--bench-json PATH]\n", argv[0]);
+        printf("          [--record FILE | --replay FILE [--headless]]\n");
+        printf("       %s [--db PATH] --serve SOCKET [--serve-batch N]\n", argv[0]);
         return 1;
     }
 
-    // Create the tasks table
-    const char *createTaskTableQuery =
-        "CREATE TABLE IF NOT EXISTS tasks ("
-        "id INTEGER PRIMARY KEY, "
-        "username TEXT, "
-        "title TEXT, "
-        "completed INTEGER);";
-    sqlite3_exec(db, createTaskTableQuery, NULL, NULL, NULL);
+    // Server mode never opens a window; taskwire.h describes the protocol
+    if (server.socketPath != NULL) {
+        StorageConfig storageConfig = DefaultStorageConfig();
+        LoadStorageConfig("storage.conf", &storageConfig);
+        SetStorageConfig(&storageConfig);
+        server.dbPath = dbPath;
+        return RunTaskServer(&server) ? 0 : 1;
+    }
+
+    bool timed = bench.frames > 0 || IsInputReplaying();
+
+    PrepareInputWindow();
+    InitWindow(800, 600, "Task Manager");
+    // Escape clears the selection instead; the window's close button quits
+    SetExitKey(KEY_NULL);
+    SetTargetFPS(timed ? 0 : 60);
+    if (!StartInput()) {
+        CloseWindow();
+        return 1;
+    }
+    InitTextCache(&textCache);
+
+    StorageConfig storageConfig = DefaultStorageConfig();
+    LoadStorageConfig("storage.conf", &storageConfig);
+    SetStorageConfig(&storageConfig);
+
+    // Started before any connection is opened so every one gets the SQL trace
+    StartProfiler();
+    bool showProfiler = false;
 
-    char loggedInUsername[MAX_INPUT_LEN] = "testuser"; // Simulated logged-in user
     ScreenState currentScreen = SCREEN_DASHBOARD;
 
+    // Resolved once before the frame loop starts
+    Database *db = OpenDatabase(dbPath);
+    if (db == NULL) {
+        return 1;
+    }
+    int loggedInUserId = FindOrCreateUser(loggedInUsername, db);
+    // Whatever a crash left in the journal's log lands before anything reads
+    TaskJournal *journal = loggedInUserId < 0 ? NULL : OpenTaskJournal(dbPath, loggedInUserId, db);
+    CloseDatabase(db);
+    if (journal == NULL) {
+        return 1;
+    }
+
+    DbWorker *worker = CreateDbWorker(dbPath, RunDbJob);
+    if (worker == NULL) {
+        CloseTaskJournal(journal);
+        return 1;
+    }
+    Checkpointer *checkpointer = StartCheckpointer(dbPath);
+
+    TaskStore *store = CreateTaskStore(dbPath, loggedInUserId);
+    TaskSearch *search = CreateTaskSearch(dbPath, loggedInUserId);
+    // Reminders follow the wall clock, so timed runs go without them to
+    // stay repeatable
+    ReminderScheduler *reminders = timed ? NULL : CreateReminderScheduler(dbPath, loggedInUserId);
+    if (store == NULL || search == NULL || (!timed && reminders == NULL)) {
+        DestroyReminderScheduler(reminders);
+        DestroyTaskSearch(search);
+        DestroyTaskStore(store);
+        StopCheckpointer(checkpointer);
+        DestroyDbWorker(worker);
+        CloseTaskJournal(journal);
+        return 1;
+    }
+
+    PendingJobs pending = {0};
+    FrameScheduler frames;
+    InitFrameScheduler(&frames);
+    unsigned storeChanges = 0;
+    unsigned searchChanges = 0;
+    unsigned reminderChanges = 0;
+    RenderTexture2D header = BuildDashboardHeader(loggedInUsername);
+
     while (!WindowShouldClose()) {
+        if (bench.frames > 0) {
+            if (bench.count == bench.frames) {
+                break;
+            }
+            MarkFrameDirty(&frames);
+        }
+
+        // Apply whatever the worker finished since the last frame
+        long long updateStart = ProfileNow();
+        DbJob finished;
+        while (CanApplyInputCompletion() && PollDbCompletion(worker, &finished)) {
+            NoteInputCompletion();
+            FinishPendingJob(&pending, finished.id);
+            if (finished.ok) {
+                ApplyJobToTaskStore(store, &finished);
+                RefreshTaskSearch(search);
+                if (reminders != NULL && (finished.dueAt > 0 || finished.type == JOB_APPLY_OPS)) {
+                    RefreshReminders(reminders);
+                }
+            }
+            if (finished.type == JOB_MOVE_TASK && finished.rowId > 0) {
+                ClearSelection(&selection);
+            }
+            if (finished.type == JOB_APPLY_OPS) {
+                FinishJournalBatch(journal, &finished, InputTime());
+            }
+            free(finished.spans);
+            free(finished.ops);
+            MarkFrameDirty(&frames);
+        }
+        WatchFrameCounter(&frames, &storeChanges, GetTaskStoreChangeCount(store));
+        WatchFrameCounter(&frames, &searchChanges, GetTaskSearchChangeCount(search));
+        if (reminders != NULL) {
+            WatchFrameCounter(&frames, &reminderChanges, GetReminderChangeCount(reminders));
+        }
+
+        // Replays draw every recorded frame, each once its completions are in
+        // and the rows and search results it shows have loaded
+        if (IsInputReplaying()) {
+            if (IsInputReplayFinished()) {
+                break;
+            }
+            if (!IsInputFrameReady() || !IsTaskStoreSettled(store) || !IsTaskSearchSettled(search)) {
+                WaitTime(0.001);
+                continue;
+            }
+            MarkFrameDirty(&frames);
+        }
+
+        if (!ShouldDrawFrame(&frames)) {
+            continue;
+        }
+        EndProfileZone("frame", "update", updateStart);
+        long long frameStart = ProfileNow();
+        PollInputFrame();
+
+        // F5 forces a full resync from the database, F3 toggles the profiler
+        // overlay and F2 saves the recorded trace
+        if (InputKeyPressed(KEY_F5)) {
+            InvalidateTaskStore(store);
+        }
+        if (InputKeyPressed(KEY_F3)) {
+            showProfiler = !showProfiler;
+        }
+        if (InputKeyPressed(KEY_F2)) {
+            ExportProfileTrace(TRACE_PATH);
+        }
+        EndProfileZone("frame", "input", frameStart);
+
+        // Benchmark runs scroll a few rows a frame and wrap once the list
+        // stops moving at its end
+        float scrolledTo = listView.scrollOffset;
+        if (bench.frames > 0) {
+            listView.scrollOffset += BENCH_SCROLL_ROWS * ROW_HEIGHT;
+        }
+
         BeginDrawing();
         ClearBackground(RAYWHITE);
+        BeginTextCacheFrame(&textCache);
 
         if (currentScreen == SCREEN_DASHBOARD) {
-            DrawDashboard(loggedInUsername, db);
+            DrawDashboard(header, loggedInUserId, worker, store, search, reminders, &pending, journal, &frames);
         }
+        if (showProfiler) {
+            DrawProfilerOverlay();
+        }
+        EndProfileFrame(frameStart);
 
+        // Buffer swap, input polling and the frame-rate wait
+        long long presentStart = ProfileNow();
         EndDrawing();
+        EndProfileZone("frame", "present", presentStart);
+
+        if (timed) {
+            AddFrameSample(&bench, (ProfileNow() - frameStart) / 1000.0);
+        }
+        if (bench.frames > 0 && listView.scrollOffset == scrolledTo) {
+            listView.scrollOffset = 0;
+        }
     }
 
-    sqlite3_close(db);
+    // The journal's last changes go out before anything shuts down; if
+    // they can't be written the log keeps them for the next start
+    DrainTaskJournal(worker, &pending, journal);
+
+    PrintFrameStats(&frames);
+    PrintTaskJournalStats(journal);
+    StopInput();
+    StopProfiler();
+    PrintTaskStoreStats(store);
+    PrintTextCacheStats(&textCache);
+    FreeTextCache(&textCache);
+    UnloadRenderTexture(header);
+    DestroyReminderScheduler(reminders);
+    DestroyTaskSearch(search);
+    DestroyTaskStore(store);
+    StopCheckpointer(checkpointer);
+    DestroyDbWorker(worker);
+    CloseTaskJournal(journal);
     CloseWindow();
-    return 0;
+
+    // After the worker has drained, so the digest covers every queued change
+    int status = 0;
+    if (timed) {
+        status = WriteFrameBenchmark(&bench, dbPath, loggedInUserId) ? 0 : 1;
+        free(bench.samples);
+    }
+    return status;
 }
 
-// Add a new task
-void AddTask(const char *username, const char *title, sqlite3 *db) {
-    const char *insertQuery = "INSERT INTO tasks (username, title, completed) VALUES (?, ?, 0);";
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, insertQuery, -1, &stmt, NULL);
-    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, title, -1, SQLITE_STATIC);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+// Queue a job and remember it so the UI can show it as in flight
+bool SubmitPendingJob(DbWorker *worker, PendingJobs *pending, DbJob *job) {
+    if (pending->count == MAX_PENDING || SubmitDbJob(worker, job) == 0) {
+        return false;
+    }
+    pending->jobs[pending->count++] = *job;
+    return true;
 }
 
-// Fetch tasks for a specific user
-int FetchTasks(const char *username, Task tasks[], sqlite3 *db) {
-    const char *selectQuery = "SELECT id, title, completed FROM tasks WHERE username = ?;";
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, selectQuery, -1, &stmt, NULL);
-    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+// A change the journal doesn't carry. The worker runs jobs in the order
+// they're submitted, so it must not go ahead of changes the journal still
+// holds: until those have landed it is held, the journal sends them at
+// once, and it refuses new changes that would overtake the held job.
+bool SubmitDirectJob(DbWorker *worker, PendingJobs *pending, TaskJournal *journal, DbJob *job) {
+    if (pending->held == 0 && CountJournalOps(journal) == 0) {
+        return SubmitPendingJob(worker, pending, job);
+    }
+    if (pending->count == MAX_PENDING) {
+        return false;
+    }
+    job->id = 0;
+    pending->jobs[pending->count++] = *job;
+    pending->held++;
+    journal->held = true;
+    return true;
+}
 
-    int taskCount = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW && taskCount < MAX_TASKS) {
-        tasks[taskCount].id = sqlite3_column_int(stmt, 0);
-        strcpy(tasks[taskCount].title, (const char *)sqlite3_column_text(stmt, 1));
-        tasks[taskCount].completed = sqlite3_column_int(stmt, 2);
-        taskCount++;
+// Once the journal is empty, in the order they were held
+void SubmitHeldJobs(DbWorker *worker, PendingJobs *pending, TaskJournal *journal) {
+    for (int i = 0; i < pending->count && pending->held > 0; i++) {
+        DbJob *job = &pending->jobs[i];
+        if (job->id != 0) {
+            continue;
+        }
+        if (SubmitDbJob(worker, job) == 0) {
+            return;
+        }
+        pending->held--;
     }
-    sqlite3_finalize(stmt);
-    return taskCount;
+    journal->held = pending->held > 0;
 }
 
-// Mark a task as completed
-void MarkTaskComplete(int taskId, sqlite3 *db) {
-    const char *updateQuery = "UPDATE tasks SET completed = 1 WHERE id = ?;";
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, updateQuery, -1, &stmt, NULL);
-    sqlite3_bind_int(stmt, 1, taskId);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+// The whole selection as one job; the job takes a copy of the spans, freed
+// once its completion has been applied
+void SubmitBulkJob(DbWorker *worker, PendingJobs *pending, TaskJournal *journal, DbJobType type, int userId, TaskSelection *selection) {
+    TaskSpan *spans = malloc(selection->count * sizeof(TaskSpan));
+    if (spans == NULL) {
+        return;
+    }
+    memcpy(spans, selection->spans, selection->count * sizeof(TaskSpan));
+    DbJob job = {.type = type, .userId = userId, .spans = spans, .spanCount = selection->count};
+    if (!SubmitDirectJob(worker, pending, journal, &job)) {
+        free(spans);
+        return;
+    }
+    ClearSelection(selection);
 }
 
-// Delete a task
-void DeleteTask(int taskId, sqlite3 *db) {
-    const char *deleteQuery = "DELETE FROM tasks WHERE id = ?;";
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, deleteQuery, -1, &stmt, NULL);
-    sqlite3_bind_int(stmt, 1, taskId);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+// Keeps the rest in order, which held jobs are submitted in
+void FinishPendingJob(PendingJobs *pending, unsigned jobId) {
+    for (int i = 0; i < pending->count; i++) {
+        if (pending->jobs[i].id == jobId) {
+            pending->count--;
+            memmove(&pending->jobs[i], &pending->jobs[i + 1], (pending->count - i) * sizeof(DbJob));
+            return;
+        }
+    }
+}
+
+const DbJob *FindPendingTaskJob(const PendingJobs *pending, TaskKey key) {
+    for (int i = 0; i < pending->count; i++) {
+        const DbJob *job = &pending->jobs[i];
+        bool bulk = job->spans != NULL;
+        if ((bulk && FindTaskSpan(job->spans, job->spanCount, key) >= 0) ||
+            (!bulk && job->type != JOB_ADD_TASK && job->type != JOB_APPLY_OPS && job->taskId == key.id)) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+// Patch a finished mutation into the cached list instead of reloading it
+void ApplyJobToTaskStore(TaskStore *store, const DbJob *job) {
+    switch (job->type) {
+        case JOB_ADD_TASK:
+            ApplyTaskAdded(store, (int)job->rowId, job->rank, job->text, job->dueAt, job->repeatEvery);
+            break;
+        case JOB_COMPLETE_TASK:
+            ApplyTaskCompleted(store, job->taskId, true);
+            break;
+        case JOB_DELETE_TASK:
+            ApplyTaskDeleted(store, job->taskId);
+            break;
+        case JOB_SET_DUE:
+            ApplyTaskDue(store, job->taskId, job->dueAt, job->repeatEvery);
+            break;
+        case JOB_MOVE_TASK:
+            // A rebalance rewrote every rank, so nothing cached still holds
+            if (job->rowId > 0) {
+                InvalidateTaskStore(store);
+            } else {
+                ApplyTaskMoved(store, job->taskId, job->rank);
+            }
+            break;
+        case JOB_BULK_COMPLETE:
+        case JOB_BULK_UNCOMPLETE:
+            if (job->rowId > 0) {
+                ApplyTasksCompleted(store, job->spans, job->spanCount, job->type == JOB_BULK_COMPLETE);
+            }
+            break;
+        case JOB_BULK_DELETE:
+            // The removed rows can be spread over pages we don't hold, so
+            // resync rather than patch
+            if (job->rowId > 0) {
+                InvalidateTaskStore(store);
+            }
+            break;
+        case JOB_APPLY_OPS:
+            for (int i = 0; i < job->opCount; i++) {
+                const TaskOp *op = &job->ops[i];
+                if (!op->ok) {
+                    continue;
+                }
+                if (op->type == TASK_OP_ADD) {
+                    ApplyTaskAdded(store, op->taskId, op->rank, op->title, op->dueAt, op->repeatEvery);
+                } else if (op->type == TASK_OP_COMPLETE || op->type == TASK_OP_UNCOMPLETE) {
+                    ApplyTaskCompleted(store, op->taskId, op->type == TASK_OP_COMPLETE);
+                } else if (op->type == TASK_OP_DELETE) {
+                    ApplyTaskDeleted(store, op->taskId);
+                } else {
+                    Task task = {op->taskId, op->rank, op->title, op->completed, op->dueAt, op->repeatEvery};
+                    ApplyTaskRestored(store, &task);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Hand the journal's queued changes to the worker once they're due, or at
+// once while jobs are held behind them, and make sure a frame comes round
+// when they will be
+void SubmitJournalBatch(DbWorker *worker, PendingJobs *pending, TaskJournal *journal, FrameScheduler *frames) {
+    DbJob job;
+    if (TakeJournalBatch(journal, InputTime(), pending->held > 0, &job) && !SubmitPendingJob(worker, pending, &job)) {
+        job.ok = false;
+        FinishJournalBatch(journal, &job, InputTime());
+        free(job.ops);
+    }
+    if (pending->held > 0 && CountJournalOps(journal) == 0) {
+        SubmitHeldJobs(worker, pending, journal);
+    }
+    double delay = GetJournalFlushDelay(journal, InputTime());
+    if (delay >= 0) {
+        RequestFrameIn(frames, delay);
+    }
+}
+
+// Writes out everything the journal holds, a batch at a time, before the
+// worker stops, then the jobs held behind it. Gives up on a batch that
+// fails or can't be taken, which stays in the log; the held jobs still go,
+// since the log is only replayed after them anyway.
+void DrainTaskJournal(DbWorker *worker, PendingJobs *pending, TaskJournal *journal) {
+    while (CountJournalOps(journal) > 0) {
+        DbJob job;
+        bool taken = TakeJournalBatch(journal, 0, true, &job);
+        if (taken && SubmitDbJob(worker, &job) == 0) {
+            job.ok = false;
+            FinishJournalBatch(journal, &job, 0);
+            free(job.ops);
+            break;
+        }
+        if (!taken && journal->flying == 0) {
+            break;
+        }
+        if (!PollDbCompletion(worker, &job)) {
+            WaitTime(0.001);
+            continue;
+        }
+        bool failed = job.type == JOB_APPLY_OPS && !job.ok;
+        if (job.type == JOB_APPLY_OPS) {
+            FinishJournalBatch(journal, &job, 0);
+        }
+        free(job.spans);
+        free(job.ops);
+        if (failed) {
+            break;
+        }
+    }
+    while (pending->held > 0) {
+        SubmitHeldJobs(worker, pending, journal);
+        DbJob job;
+        if (pending->held == 0) {
+            break;
+        }
+        // The worker's queue is full; make room for it to finish into
+        if (PollDbCompletion(worker, &job)) {
+            free(job.spans);
+            free(job.ops);
+        } else {
+            WaitTime(0.001);
+        }
+    }
 }
 
 // Handle task input box
 void HandleTaskInput(bool *focused, char input[], int maxLength) {
-    if (*focused && IsKeyPressed(KEY_BACKSPACE) && strlen(input) > 0) {
+    if (*focused && InputKeyPressed(KEY_BACKSPACE) && strlen(input) > 0) {
         input[strlen(input) - 1] = '\0';
     } else if (*focused) {
-        int key = GetCharPressed();
+        int key = InputCharPressed();
         if (key > 0 && key < 128 && strlen(input) < maxLength - 1) {
             input[strlen(input)] = (char)key;
             input[strlen(input) + 1] = '\0';
@@ -128,17 +572,35 @@ void HandleTaskInput(bool *focused, char input[], int maxLength) {
     }
 }
 
+// Render the parts of the header that never change once: the greeting and the
+// input, button and search box backgrounds
+RenderTexture2D BuildDashboardHeader(const char *username) {
+    RenderTexture2D header = LoadRenderTexture(800, HEADER_HEIGHT);
+    BeginTextureMode(header);
+    ClearBackground(RAYWHITE);
+    DrawText(TextFormat("Welcome, %s!", username), 20, 20, 30, DARKGRAY);
+    DrawRectangle(20, 80, 400, 40, LIGHTGRAY);
+    DrawRectangle(440, 80, 100, 40, LIGHTGRAY);
+    DrawText("Add Task", 450, 90, 20, BLACK);
+    DrawRectangle(500, 20, 280, 36, LIGHTGRAY);
+    EndTextureMode();
+    return header;
+}
+
 // Draw the dashboard
-void DrawDashboard(const char *username, sqlite3 *db) {
-    static Task tasks[MAX_TASKS];
-    static int taskCount = 0;
+void DrawDashboard(RenderTexture2D header, int userId, DbWorker *worker, TaskStore *store, TaskSearch *search, ReminderScheduler *reminders, PendingJobs *pending, TaskJournal *journal, FrameScheduler *frames) {
     static char newTaskTitle[MAX_INPUT_LEN] = "";
     static bool taskInputFocused = false;
+    static char searchText[SEARCH_QUERY_LEN] = "";
+    static char submittedSearch[SEARCH_QUERY_LEN] = "";
+    static bool searchFocused = false;
+    static double lastSearchEdit = 0;
+    long long headerStart = ProfileNow();
 
-    DrawText(TextFormat("Welcome, %s!", username), 20, 20, 30, DARKGRAY);
+    // Render textures are stored bottom-up, hence the negative height
+    DrawTextureRec(header.texture, (Rectangle){0, 0, 800, -HEADER_HEIGHT}, (Vector2){0, 0}, WHITE);
 
     // Task input box
-    DrawRectangle(20, 80, 400, 40, LIGHTGRAY);
     if (taskInputFocused) {
         DrawRectangleLines(20, 80, 400, 40, BLUE);
     } else {
@@ -147,59 +609,547 @@ void DrawDashboard(const char *username, sqlite3 *db) {
     DrawText(strlen(newTaskTitle) > 0 ? newTaskTitle : "Enter new task title...", 25, 90, 20, strlen(newTaskTitle) > 0 ? BLACK : GRAY);
 
     // Add Task button
-    bool addTaskHovered = GetMouseX() > 440 && GetMouseX() < 540 && GetMouseY() > 80 && GetMouseY() < 120;
-    Color addTaskColor = addTaskHovered ? DARKGRAY : LIGHTGRAY;
-    DrawRectangle(440, 80, 100, 40, addTaskColor);
-    DrawText("Add Task", 450, 90, 20, BLACK);
+    bool addTaskHovered = InputMouseX() > 440 && InputMouseX() < 540 && InputMouseY() > 80 && InputMouseY() < 120;
+    if (addTaskHovered) {
+        DrawRectangle(440, 80, 100, 40, DARKGRAY);
+        DrawText("Add Task", 450, 90, 20, BLACK);
+    }
+
+    // Search box
+    DrawRectangleLines(500, 20, 280, 36, searchFocused ? BLUE : GRAY);
+    DrawText(strlen(searchText) > 0 ? searchText : "Search tasks...", 508, 28, 20, strlen(searchText) > 0 ? BLACK : GRAY);
 
     // Handle input focus and button clicks
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-        if (GetMouseX() > 20 && GetMouseX() < 420 && GetMouseY() > 80 && GetMouseY() < 120) {
+    if (InputMousePressed(MOUSE_LEFT_BUTTON)) {
+        if (InputMouseX() > 20 && InputMouseX() < 420 && InputMouseY() > 80 && InputMouseY() < 120) {
             taskInputFocused = true;
         } else {
             taskInputFocused = false;
         }
+        searchFocused = InputMouseX() > 500 && InputMouseX() < 780 && InputMouseY() > 20 && InputMouseY() < 56;
         if (addTaskHovered && strlen(newTaskTitle) > 0) {
-            AddTask(username, newTaskTitle, db);
-            memset(newTaskTitle, 0, sizeof(newTaskTitle));
-            taskCount = FetchTasks(username, tasks, db);
+            char title[MAX_INPUT_LEN];
+            long long dueAt = 0;
+            int repeatEvery = 0;
+            snprintf(title, sizeof(title), "%s", newTaskTitle);
+            // "Title @SPEC" adds the task with a due date
+            SplitTaskDue(title, time(NULL), &dueAt, &repeatEvery);
+            if (RecordTaskAdded(journal, title, dueAt, repeatEvery, InputTime())) {
+                memset(newTaskTitle, 0, sizeof(newTaskTitle));
+            }
         }
     }
 
     HandleTaskInput(&taskInputFocused, newTaskTitle, MAX_INPUT_LEN);
 
-    // Fetch and display tasks
-    if (taskCount == 0) {
-        taskCount = FetchTasks(username, tasks, db);
+    // Search as you type, once the keystrokes pause for the debounce interval
+    size_t searchLength = strlen(searchText);
+    HandleTaskInput(&searchFocused, searchText, SEARCH_QUERY_LEN);
+    if (strlen(searchText) != searchLength) {
+        lastSearchEdit = InputTime();
+        RequestFrameIn(frames, SEARCH_DEBOUNCE_SECONDS);
+    }
+    if (strcmp(searchText, submittedSearch) != 0 && InputTime() - lastSearchEdit >= SEARCH_DEBOUNCE_SECONDS) {
+        strcpy(submittedSearch, searchText);
+        SubmitTaskSearch(search, submittedSearch);
+        listView.scrollOffset = 0;
+        ClearSelection(&selection);
+    }
+    bool searching = submittedSearch[0] != '\0';
+
+    int saving = pending->count + journal->queued;
+    if (saving > 0) {
+        DrawText(TextFormat("Saving %d change(s)...", saving), 20, 126, 16, GRAY);
+    }
+
+    if (searching && !IsTaskSearchSettled(search)) {
+        DrawText("Searching...", 650, 126, 16, GRAY);
     }
-    DrawTasks(tasks, taskCount, db);
+
+    // Bulk actions over the selection
+    if (selection.count > 0) {
+        DrawText(TextFormat("%d selected", selection.selected), 200, BULK_BAR_Y + 2, 16, DARKGRAY);
+        if (DrawSmallButton("Done", 300, BULK_BAR_Y, 70)) {
+            SubmitBulkJob(worker, pending, journal, JOB_BULK_COMPLETE, userId, &selection);
+        } else if (DrawSmallButton("Undone", 380, BULK_BAR_Y, 70)) {
+            SubmitBulkJob(worker, pending, journal, JOB_BULK_UNCOMPLETE, userId, &selection);
+        } else if (DrawSmallButton("Delete", 460, BULK_BAR_Y, 70)) {
+            SubmitBulkJob(worker, pending, journal, JOB_BULK_DELETE, userId, &selection);
+        } else if (DrawSmallButton("Clear", 540, BULK_BAR_Y, 70)) {
+            ClearSelection(&selection);
+        }
+    }
+    if (reminders != NULL) {
+        DrawReminderBar(reminders, userId, worker, pending, journal);
+    }
+
+    // Per-user totals, which the store reads from task_counts
+    TaskCounts counts = GetTaskStoreCounts(store);
+    DrawText(TextFormat("%d open  %d done", counts.total - counts.completed, counts.completed), 555, 82, 16, DARKGRAY);
+    if (counts.overdue > 0) {
+        DrawText(TextFormat("%d overdue", counts.overdue), 555, 100, 16, RED);
+    }
+    EndProfileZone("frame", "header", headerStart);
+
+    long long tasksStart = ProfileNow();
+    DrawTasks(&listView, store, search, searching, taskInputFocused || searchFocused, worker, pending, journal, &selection);
+    EndProfileZone("frame", "tasks", tasksStart);
+
+    SubmitJournalBatch(worker, pending, journal, frames);
 }
 
-// Draw tasks and their actions
-void DrawTasks(Task tasks[], int taskCount, sqlite3 *db) {
-    for (int i = 0; i < taskCount; i++) {
-        Color textColor = tasks[i].completed ? GRAY : BLACK;
-        DrawText(tasks[i].title, 50, 150 + i * 50, 20, textColor);
+// The oldest fired reminder, under the greeting. Snoozing gives a one-off
+// task a new due time; a recurring one has already moved to its next.
+void DrawReminderBar(ReminderScheduler *reminders, int userId, DbWorker *worker, PendingJobs *pending, TaskJournal *journal) {
+    Reminder reminder;
+    int queued = PeekReminder(reminders, &reminder);
+    if (queued == 0) {
+        return;
+    }
+    DrawRectangle(20, REMINDER_BAR_Y, 760, 20, (Color){255, 240, 200, 255});
+    const char *label = queued > 1 ? TextFormat("Due: %s (+%d more)", reminder.title, queued - 1) : TextFormat("Due: %s", reminder.title);
+    DrawCachedText(&textCache, label, 26, REMINDER_BAR_Y + 2, 16, 500, DARKGRAY);
+    if (reminder.repeatEvery == 0 && DrawSmallButton("Snooze", 600, REMINDER_BAR_Y, 80)) {
+        DbJob job = {.type = JOB_SET_DUE, .taskId = reminder.taskId, .userId = userId, .dueAt = (long long)time(NULL) + SNOOZE_SECONDS};
+        SubmitDirectJob(worker, pending, journal, &job);
+        DismissReminder(reminders);
+    } else if (DrawSmallButton("Dismiss", 690, REMINDER_BAR_Y, 80)) {
+        DismissReminder(reminders);
+    }
+}
+
+// Apply mouse-wheel and keyboard scrolling, clamped to the list length
+void ScrollTaskList(TaskListView *view, int taskCount) {
+    bool overList = InputMouseY() > LIST_TOP && InputMouseY() < LIST_TOP + LIST_HEIGHT;
+    if (overList) {
+        view->scrollOffset -= InputMouseWheel() * SCROLL_STEP;
+    }
+
+    if (InputKeyPressed(KEY_DOWN)) view->scrollOffset += ROW_HEIGHT;
+    if (InputKeyPressed(KEY_UP)) view->scrollOffset -= ROW_HEIGHT;
+    if (InputKeyPressed(KEY_PAGE_DOWN)) view->scrollOffset += LIST_HEIGHT - ROW_HEIGHT;
+    if (InputKeyPressed(KEY_PAGE_UP)) view->scrollOffset -= LIST_HEIGHT - ROW_HEIGHT;
+    if (InputKeyPressed(KEY_HOME)) view->scrollOffset = 0;
+    if (InputKeyPressed(KEY_END)) view->scrollOffset = (float)taskCount * ROW_HEIGHT;
+
+    float maxOffset = (float)taskCount * ROW_HEIGHT - LIST_HEIGHT;
+    if (view->scrollOffset > maxOffset) view->scrollOffset = maxOffset;
+    if (view->scrollOffset < 0) view->scrollOffset = 0;
+}
+
+// Draw only the rows inside the list viewport, plus a scrollbar
+// While searching the rows come from the search results instead of the store
+// Clicking a title selects its row; shift extends from the last click and
+// ctrl toggles. Ctrl+A selects everything the list shows and Escape clears.
+// Outside a search a title can also be dragged to a new place in the list.
+// Done and Del go through the journal; Ctrl+Z undoes the last add, done or
+// delete and Ctrl+Y redoes it.
+void DrawTasks(TaskListView *view, TaskStore *store, TaskSearch *search, bool searching, bool typing, DbWorker *worker, PendingJobs *pending, TaskJournal *journal, TaskSelection *selection) {
+    Task completeTask = {0};
+    Task deleteTask = {0};
+    int clickedIndex = -1;
+    TaskKey clickedKey = {0};
+    const char *draggedTitle = NULL;
+    long long now = time(NULL);
+
+    if (searching) {
+        LockTaskSearch(search);
+    } else {
+        LockTaskStore(store);
+    }
+    int taskCount = searching ? GetSearchResultCount(search) : GetTaskCount(store);
+    ScrollTaskList(view, taskCount);
+
+    int scroll = (int)view->scrollOffset;
+    int firstRow = scroll / ROW_HEIGHT;
+    int lastRow = (scroll + LIST_HEIGHT - 1) / ROW_HEIGHT;
+    if (lastRow > taskCount - 1) lastRow = taskCount - 1;
+
+    bool mouseInList = InputMouseY() > LIST_TOP && InputMouseY() < LIST_TOP + LIST_HEIGHT;
+
+    long long rowsStart = ProfileNow();
+    BeginScissorMode(0, LIST_TOP, 800, LIST_HEIGHT);
+    for (int i = firstRow; i <= lastRow; i++) {
+        int y = LIST_TOP + i * ROW_HEIGHT - scroll;
+        Task task;
+        bool loaded = searching ? GetSearchResult(search, i, &task) : GetTask(store, i, &task);
+        if (!loaded) {
+            DrawCachedText(&textCache, "Loading...", 50, y, 20, 0, LIGHTGRAY);
+            continue;
+        }
+
+        TaskKey key = {task.rank, task.id};
+        if (FindTaskSpan(selection->spans, selection->count, key) >= 0) {
+            DrawRectangle(40, y, 550, 40, (Color){210, 225, 250, 255});
+        }
+
+        // In-flight changes are drawn as if they had already landed; the
+        // journal's latest change to a row is newer than any job's
+        const DbJob *inFlight = FindPendingTaskJob(pending, key);
+        const TaskOp *journaled = FindJournalOp(journal, task.id);
+        bool deleting = journaled != NULL ? journaled->type == TASK_OP_DELETE
+                                          : inFlight != NULL && (inFlight->type == JOB_DELETE_TASK || inFlight->type == JOB_BULK_DELETE);
+        if (deleting) {
+            DrawCachedText(&textCache, task.title, 50, y, 20, TITLE_MAX_WIDTH, LIGHTGRAY);
+            DrawCachedText(&textCache, "Deleting...", 610, y + 10, 20, 0, LIGHTGRAY);
+            continue;
+        }
+
+        bool completed = task.completed;
+        if (journaled != NULL && (journaled->type == TASK_OP_COMPLETE || journaled->type == TASK_OP_UNCOMPLETE)) {
+            completed = journaled->type == TASK_OP_COMPLETE;
+        } else if (inFlight != NULL && (inFlight->type == JOB_COMPLETE_TASK || inFlight->type == JOB_BULK_COMPLETE)) {
+            completed = true;
+        } else if (inFlight != NULL && inFlight->type == JOB_BULK_UNCOMPLETE) {
+            completed = false;
+        }
+        // The dragged row, and one whose move hasn't landed, stay behind greyed out
+        bool dragged = view->dragging && task.id == view->dragId;
+        bool moving = dragged || (inFlight != NULL && inFlight->type == JOB_MOVE_TASK);
+        if (dragged) {
+            draggedTitle = task.title;
+        }
+        Color textColor = moving ? LIGHTGRAY : completed ? GRAY : BLACK;
+        DrawCachedText(&textCache, task.title, 50, y, 20, TITLE_MAX_WIDTH, textColor);
+        if (task.dueAt > 0) {
+            char due[TASK_DUE_LEN];
+            FormatTaskDue(task.dueAt, task.repeatEvery, due, sizeof(due));
+            bool overdue = !completed && task.dueAt <= now;
+            DrawCachedText(&textCache, TextFormat("%s %s", overdue ? "Overdue" : "Due", due), 50, y + 23, 14, 0,
+                           overdue ? RED : GRAY);
+        }
 
         // Complete button
-        DrawRectangle(600, 150 + i * 50, 60, 40, LIGHTGRAY);
-        DrawText("Done", 610, 160 + i * 50, 20, DARKGRAY);
+        DrawRectangle(600, y, 60, 40, LIGHTGRAY);
+        DrawCachedText(&textCache, "Done", 610, y + 10, 20, 0, DARKGRAY);
 
         // Delete button
-        DrawRectangle(670, 150 + i * 50, 60, 40, RED);
-        DrawText("Del", 685, 160 + i * 50, 20, WHITE);
+        DrawRectangle(670, y, 60, 40, RED);
+        DrawCachedText(&textCache, "Del", 685, y + 10, 20, 0, WHITE);
+
+        bool rowHovered = mouseInList && InputMouseY() > y && InputMouseY() < y + 40;
+        bool completeHovered = rowHovered && InputMouseX() > 600 && InputMouseX() < 660;
+        bool deleteHovered = rowHovered && InputMouseX() > 670 && InputMouseX() < 730;
+        bool titleHovered = rowHovered && InputMouseX() < 600;
+
+        if (titleHovered && InputMousePressed(MOUSE_LEFT_BUTTON)) {
+            clickedIndex = i;
+            clickedKey = key;
+        }
+
+        if (completeHovered && InputMousePressed(MOUSE_LEFT_BUTTON)) {
+            completeTask = task;
+            completeTask.completed = completed;
+        }
+
+        if (deleteHovered && InputMousePressed(MOUSE_LEFT_BUTTON)) {
+            deleteTask = task;
+            deleteTask.completed = completed;
+        }
+    }
+
+    // The drop point, and the dragged title following the mouse
+    if (view->dragging) {
+        int gap = (InputMouseY() - LIST_TOP + scroll + ROW_HEIGHT / 2) / ROW_HEIGHT;
+        if (gap < 0) gap = 0;
+        if (gap > taskCount) gap = taskCount;
+        DrawRectangle(40, LIST_TOP + gap * ROW_HEIGHT - scroll - 6, 550, 2, BLUE);
+        if (draggedTitle != NULL) {
+            DrawCachedText(&textCache, draggedTitle, 50, InputMouseY() - 10, 20, TITLE_MAX_WIDTH, DARKGRAY);
+        }
+    }
+    EndScissorMode();
+    EndProfileZone("frame", "rows", rowsStart);
+
+    // Ranges, select-all and drops read rows, so they're resolved under the lock
+    bool shift = InputKeyDown(KEY_LEFT_SHIFT);
+    bool control = InputKeyDown(KEY_LEFT_CONTROL);
+    if (clickedIndex >= 0) {
+        if (shift && selection->anchorIndex >= 0) {
+            SelectTaskRange(selection, search, searching, clickedIndex, clickedKey);
+        } else {
+            if (!control) {
+                ClearSelection(selection);
+            }
+            ToggleSelectedTask(selection, clickedKey);
+            selection->anchorIndex = clickedIndex;
+            selection->anchorKey = clickedKey;
+        }
+        if (!searching && !shift && !control) {
+            view->dragId = clickedKey.id;
+            view->dragIndex = clickedIndex;
+            view->dragStartY = InputMouseY();
+            view->dragging = false;
+        }
+    }
+    if (view->dragId != 0) {
+        if (searching) {
+            view->dragId = 0;
+        } else if (InputMouseDown(MOUSE_LEFT_BUTTON)) {
+            int distance = InputMouseY() - view->dragStartY;
+            view->dragging = view->dragging || distance > DRAG_THRESHOLD || distance < -DRAG_THRESHOLD;
+        } else {
+            // Spans are keyed by rank, and the dropped row's is about to change
+            if (view->dragging && DropDraggedTask(view, store, taskCount, worker, pending, journal)) {
+                ClearSelection(selection);
+            }
+            view->dragId = 0;
+            view->dragging = false;
+        }
+    }
+    if (!typing && control && InputKeyPressed(KEY_A)) {
+        SelectAllTasks(selection, search, searching, taskCount);
+    }
+    if (!typing && InputKeyPressed(KEY_ESCAPE)) {
+        ClearSelection(selection);
+    }
+
+    // Recorded while the clicked rows' titles are still valid. A task put
+    // back by an undo or redo could land inside a selected span.
+    if (completeTask.id != 0) {
+        RecordTaskCompleted(journal, &completeTask, InputTime());
+    }
+    if (deleteTask.id != 0) {
+        RecordTaskDeleted(journal, &deleteTask, InputTime());
+    }
+    if (!typing && control && InputKeyPressed(KEY_Z) && UndoTaskChange(journal, InputTime())) {
+        ClearSelection(selection);
+    }
+    if (!typing && control && InputKeyPressed(KEY_Y) && RedoTaskChange(journal, InputTime())) {
+        ClearSelection(selection);
+    }
+
+    // Scrollbar
+    if (taskCount * ROW_HEIGHT > LIST_HEIGHT) {
+        int thumbHeight = LIST_HEIGHT * LIST_HEIGHT / (taskCount * ROW_HEIGHT);
+        if (thumbHeight < 20) thumbHeight = 20;
+        int thumbY = LIST_TOP + (int)((float)(LIST_HEIGHT - thumbHeight) * scroll / (taskCount * ROW_HEIGHT - LIST_HEIGHT));
+        DrawRectangle(780, LIST_TOP, 10, LIST_HEIGHT, LIGHTGRAY);
+        DrawRectangle(780, thumbY, 10, thumbHeight, GRAY);
+    }
+    if (searching) {
+        UnlockTaskSearch(search);
+    } else {
+        UnlockTaskStore(store);
+    }
+
+    if (!searching) {
+        RequestTaskRange(store, firstRow, lastRow < firstRow ? firstRow : lastRow);
+    }
+}
 
-        bool completeHovered = GetMouseX() > 600 && GetMouseX() < 660 && GetMouseY() > (150 + i * 50) && GetMouseY() < (190 + i * 50);
-        bool deleteHovered = GetMouseX() > 670 && GetMouseX() < 730 && GetMouseY() > (150 + i * 50) && GetMouseY() < (190 + i * 50);
+void ClearSelection(TaskSelection *selection) {
+    selection->count = 0;
+    selection->selected = 0;
+    selection->anchorIndex = -1;
+}
 
-        if (completeHovered && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            MarkTaskComplete(tasks[i].id, db);
-            taskCount = FetchTasks("testuser", tasks, db);
+static bool InsertSelectedSpan(TaskSelection *selection, int index, TaskSpan span) {
+    if (selection->count == selection->capacity) {
+        int capacity = selection->capacity > 0 ? selection->capacity * 2 : 16;
+        TaskSpan *spans = realloc(selection->spans, capacity * sizeof(TaskSpan));
+        if (spans == NULL) {
+            return false;
         }
+        selection->spans = spans;
+        selection->capacity = capacity;
+    }
+    memmove(&selection->spans[index + 1], &selection->spans[index], (selection->count - index) * sizeof(TaskSpan));
+    selection->spans[index] = span;
+    selection->count++;
+    return true;
+}
+
+// Where key's span would go to keep the list sorted
+static int FindSelectedSpanSlot(const TaskSelection *selection, TaskKey key) {
+    int at = 0;
+    while (at < selection->count && CompareTaskKeys(selection->spans[at].last, key) < 0) {
+        at++;
+    }
+    return at;
+}
 
-        if (deleteHovered && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            DeleteTask(tasks[i].id, db);
-            taskCount = FetchTasks("testuser", tasks, db);
+// Adds a single row unless it is already selected
+bool AddSelectedTask(TaskSelection *selection, TaskKey key) {
+    if (FindTaskSpan(selection->spans, selection->count, key) >= 0) {
+        return false;
+    }
+    if (!InsertSelectedSpan(selection, FindSelectedSpanSlot(selection, key), (TaskSpan){key, key})) {
+        return false;
+    }
+    selection->selected++;
+    return true;
+}
+
+// Flip one row in or out, splitting the span it falls inside if need be.
+// Ids are integers, so (rank, id - 1) is the last key before the row's.
+void ToggleSelectedTask(TaskSelection *selection, TaskKey key) {
+    int index = FindTaskSpan(selection->spans, selection->count, key);
+    if (index < 0) {
+        AddSelectedTask(selection, key);
+        return;
+    }
+
+    TaskSpan span = selection->spans[index];
+    TaskKey before = {key.rank, key.id - 1};
+    TaskKey after = {key.rank, key.id + 1};
+    bool first = CompareTaskKeys(key, span.first) == 0;
+    bool last = CompareTaskKeys(key, span.last) == 0;
+    if (first && last) {
+        memmove(&selection->spans[index], &selection->spans[index + 1], (selection->count - index - 1) * sizeof(TaskSpan));
+        selection->count--;
+    } else if (first) {
+        selection->spans[index].first = after;
+    } else if (last) {
+        selection->spans[index].last = before;
+    } else {
+        if (!InsertSelectedSpan(selection, index + 1, (TaskSpan){after, span.last})) {
+            return;
+        }
+        selection->spans[index].last = before;
+    }
+    selection->selected--;
+}
+
+// Replace the selection with the rows from the anchor to index
+void SelectTaskRange(TaskSelection *selection, TaskSearch *search, bool searching, int index, TaskKey key) {
+    int first = selection->anchorIndex < index ? selection->anchorIndex : index;
+    int last = selection->anchorIndex < index ? index : selection->anchorIndex;
+    int anchorIndex = selection->anchorIndex;
+    TaskKey anchorKey = selection->anchorKey;
+    ClearSelection(selection);
+    selection->anchorIndex = anchorIndex;
+    selection->anchorKey = anchorKey;
+
+    if (!searching) {
+        bool anchorFirst = CompareTaskKeys(anchorKey, key) < 0;
+        TaskSpan span = {anchorFirst ? anchorKey : key, anchorFirst ? key : anchorKey};
+        if (InsertSelectedSpan(selection, 0, span)) {
+            selection->selected = last - first + 1;
+        }
+        return;
+    }
+    Task task;
+    for (int i = first; i <= last; i++) {
+        if (GetSearchResult(search, i, &task)) {
+            AddSelectedTask(selection, (TaskKey){task.rank, task.id});
+        }
+    }
+}
+
+// Every task the list currently shows: the whole key range, or each result
+void SelectAllTasks(TaskSelection *selection, TaskSearch *search, bool searching, int taskCount) {
+    ClearSelection(selection);
+    if (!searching) {
+        if (InsertSelectedSpan(selection, 0, (TaskSpan){TASK_KEY_FIRST, TASK_KEY_LAST})) {
+            selection->selected = taskCount;
+        }
+        return;
+    }
+    Task task;
+    for (int i = 0; i < taskCount; i++) {
+        if (GetSearchResult(search, i, &task)) {
+            AddSelectedTask(selection, (TaskKey){task.rank, task.id});
         }
     }
 }
+
+// Drop the dragged row into the gap nearest the mouse. The job only names
+// the new neighbours; the worker reads their ranks when it runs. Called with
+// the store locked; returns whether a move was submitted.
+bool DropDraggedTask(TaskListView *view, TaskStore *store, int taskCount, DbWorker *worker, PendingJobs *pending, TaskJournal *journal) {
+    int gap = (InputMouseY() - LIST_TOP + (int)view->scrollOffset + ROW_HEIGHT / 2) / ROW_HEIGHT;
+    if (gap < 0) gap = 0;
+    if (gap > taskCount) gap = taskCount;
+    if (gap == view->dragIndex || gap == view->dragIndex + 1) {
+        return false;
+    }
+
+    // Every row involved must still be loaded and where it was
+    Task dragged, after, before;
+    if (!GetTask(store, view->dragIndex, &dragged) || dragged.id != view->dragId) {
+        return false;
+    }
+    DbJob job = {.type = JOB_MOVE_TASK, .taskId = dragged.id, .userId = store->userId};
+    if (gap > 0) {
+        if (!GetTask(store, gap - 1, &after)) {
+            return false;
+        }
+        job.afterId = after.id;
+    }
+    if (gap < taskCount) {
+        if (!GetTask(store, gap, &before)) {
+            return false;
+        }
+        job.beforeId = before.id;
+    }
+    return SubmitDirectJob(worker, pending, journal, &job);
+}
+
+bool DrawSmallButton(const char *label, int x, int y, int width) {
+    bool hovered = InputMouseX() > x && InputMouseX() < x + width && InputMouseY() > y && InputMouseY() < y + 20;
+    DrawRectangle(x, y, width, 20, hovered ? DARKGRAY : LIGHTGRAY);
+    DrawText(label, x + 8, y + 2, 16, BLACK);
+    return hovered && InputMousePressed(MOUSE_LEFT_BUTTON);
+}
+
+// Frame and statement latency percentiles over the last PROFILE_SAMPLE_COUNT samples
+void DrawProfilerOverlay(void) {
+    ProfileSummary summary = GetProfileSummary();
+    DrawRectangle(480, 500, 310, 90, (Color){0, 0, 0, 180});
+    DrawText(TextFormat("Frame  p50 %.2f ms  p99 %.2f ms", summary.frameP50Ms, summary.frameP99Ms), 490, 510, 16, WHITE);
+    DrawText(TextFormat("SQL    p50 %.2f ms  p99 %.2f ms", summary.statementP50Ms, summary.statementP99Ms), 490, 532, 16, WHITE);
+    DrawText(TextFormat("%ld frames, %ld statements", summary.frames, summary.statements), 490, 554, 16, LIGHTGRAY);
+    DrawText("F2: save " TRACE_PATH, 490, 572, 12, LIGHTGRAY);
+}
+
+static int CompareFrameTimes(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void AddFrameSample(FrameBenchmark *bench, double ms) {
+    if (bench->count == bench->capacity) {
+        int capacity = bench->capacity > 0 ? bench->capacity * 2 : 1024;
+        double *samples = realloc(bench->samples, capacity * sizeof(double));
+        if (samples == NULL) {
+            return;
+        }
+        bench->samples = samples;
+        bench->capacity = capacity;
+    }
+    bench->samples[bench->count++] = ms;
+}
+
+// Frame-time summary and final task-list digest as one JSON object, to
+// stdout when no path was given
+bool WriteFrameBenchmark(FrameBenchmark *bench, const char *dbPath, int userId) {
+    if (bench->count == 0) {
+        return false;
+    }
+    double total = 0;
+    for (int i = 0; i < bench->count; i++) {
+        total += bench->samples[i];
+    }
+    qsort(bench->samples, bench->count, sizeof(double), CompareFrameTimes);
+
+    Database *db = OpenDatabase(dbPath);
+    if (db == NULL) {
+        return false;
+    }
+    int taskCount = 0;
+    unsigned long long digest = DigestTasks(userId, db, &taskCount);
+    CloseDatabase(db);
+
+    FILE *out = bench->jsonPath != NULL ? fopen(bench->jsonPath, "w") : stdout;
+    if (out == NULL) {
+        printf("Failed to open %s for writing\n", bench->jsonPath);
+        return false;
+    }
+    fprintf(out, "{\"frames\": %d, \"tasks\": %d, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, "
+                 "\"max_ms\": %.4f, \"state_digest\": \"%016llx\"}\n",
+            bench->count, taskCount, total / bench->count, bench->samples[(int)(0.50 * (bench->count - 1))],
+            bench->samples[(int)(0.99 * (bench->count - 1))], bench->samples[bench->count - 1], digest);
+    return out == stdout || fclose(out) == 0;
+}
@@ -0,0 +1,143 @@
+#include "authpool.h"
+#include "profile.h"
+#include "taskcore.h"
+#include <openssl/crypto.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void *AuthThreadMain(void *arg) {
+    AuthThread *self = arg;
+    AuthPool *pool = self->pool;
+    AuthRequest request;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->pendingHead == pool->pendingTail && !pool->quit) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        // Finish whatever was queued before shutting down, like DbWorker
+        if (pool->pendingHead == pool->pendingTail) {
+            break;
+        }
+        request = pool->pending[pool->pendingHead++ % AUTH_QUEUE_SIZE];
+        pthread_mutex_unlock(&pool->lock);
+
+        long long start = ProfileNow();
+        if (request.type == AUTH_REGISTER) {
+            request.ok = RegisterUser(request.username, request.password, self->db);
+        } else {
+            request.ok = LoginUser(request.username, request.password, self->db);
+        }
+        EndProfileZone("auth", request.type == AUTH_REGISTER ? "register" : "login", start);
+        OPENSSL_cleanse(request.password, sizeof(request.password));
+
+        // inFlight caps both queues together, so there is always room here
+        pthread_mutex_lock(&pool->lock);
+        pool->done[pool->doneTail++ % AUTH_QUEUE_SIZE] = request;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+AuthPool *CreateAuthPool(const char *path, int threads, AuthCallback callback, void *context) {
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (int)cores : 1;
+    }
+    if (threads > AUTH_MAX_THREADS) {
+        threads = AUTH_MAX_THREADS;
+    }
+
+    AuthPool *pool = calloc(1, sizeof(AuthPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->callback = callback;
+    pool->context = context;
+    pool->nextId = 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    // Open every connection up front so a bad path fails here, not per request
+    for (int i = 0; i < threads; i++) {
+        pool->threads[i].pool = pool;
+        pool->threads[i].db = OpenDatabase(path);
+        if (pool->threads[i].db == NULL) {
+            DestroyAuthPool(pool);
+            return NULL;
+        }
+        pool->threadCount++;
+        pthread_create(&pool->threads[i].thread, NULL, AuthThreadMain, &pool->threads[i]);
+    }
+    return pool;
+}
+
+// Finishes every queued request; results nobody dispatched are dropped
+void DestroyAuthPool(AuthPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->threadCount; i++) {
+        pthread_join(pool->threads[i].thread, NULL);
+        CloseDatabase(pool->threads[i].db);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// Queue a request for the pool. Returns its id, or 0 if too many are in flight.
+unsigned SubmitAuthRequest(AuthPool *pool, const AuthRequest *request) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->inFlight == AUTH_QUEUE_SIZE) {
+        pthread_mutex_unlock(&pool->lock);
+        return 0;
+    }
+    unsigned id = pool->nextId++;
+    if (pool->nextId == 0) {
+        pool->nextId = 1;
+    }
+    AuthRequest *slot = &pool->pending[pool->pendingTail++ % AUTH_QUEUE_SIZE];
+    *slot = *request;
+    slot->id = id;
+    pool->inFlight++;
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    return id;
+}
+
+// Hand up to maxResults finished requests to the callback, in completion
+// order. Returns how many were dispatched.
+int DispatchAuthResults(AuthPool *pool, int maxResults) {
+    int dispatched = 0;
+    while (dispatched < maxResults) {
+        AuthRequest result;
+        pthread_mutex_lock(&pool->lock);
+        bool any = pool->doneHead != pool->doneTail;
+        if (any) {
+            result = pool->done[pool->doneHead++ % AUTH_QUEUE_SIZE];
+            pool->inFlight--;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if (!any) {
+            break;
+        }
+        if (pool->callback != NULL) {
+            pool->callback(&result, pool->context);
+        }
+        dispatched++;
+    }
+    return dispatched;
+}
+
+bool IsAuthPoolBusy(AuthPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    bool busy = pool->inFlight > 0;
+    pthread_mutex_unlock(&pool->lock);
+    return busy;
+}
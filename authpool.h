@@ -0,0 +1,65 @@
+#ifndef AUTHPOOL_H
+#define AUTHPOOL_H
+
+#include "db.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+#define AUTH_MAX_THREADS 64
+#define AUTH_QUEUE_SIZE 64
+#define AUTH_TEXT_LEN 256
+
+typedef enum {
+    AUTH_REGISTER,
+    AUTH_LOGIN
+} AuthRequestType;
+
+typedef struct {
+    AuthRequestType type;
+    unsigned id;                     // Assigned by SubmitAuthRequest
+    char username[AUTH_TEXT_LEN];
+    char password[AUTH_TEXT_LEN];    // Wiped before the result is dispatched
+    bool ok;                         // Filled in by the pool
+} AuthRequest;
+
+// Runs on the thread that calls DispatchAuthResults, never on the pool
+typedef void (*AuthCallback)(const AuthRequest *result, void *context);
+
+struct AuthPool;
+
+typedef struct {
+    struct AuthPool *pool;
+    Database *db;
+    pthread_t thread;
+} AuthThread;
+
+// Register/login requests verified by a pool of threads, each with its own
+// connection, so the slow password KDF runs in parallel and never on the
+// frame loop. Finished requests wait in a queue until the owner drains them
+// with DispatchAuthResults, which hands each one to the callback.
+typedef struct AuthPool {
+    AuthThread threads[AUTH_MAX_THREADS];
+    int threadCount;
+    AuthCallback callback;
+    void *context;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool quit;
+    unsigned nextId;
+    unsigned inFlight;               // Submitted but not yet dispatched
+    AuthRequest pending[AUTH_QUEUE_SIZE];
+    unsigned pendingHead;
+    unsigned pendingTail;
+    AuthRequest done[AUTH_QUEUE_SIZE];
+    unsigned doneHead;
+    unsigned doneTail;
+} AuthPool;
+
+// threads <= 0 means one per online core
+AuthPool *CreateAuthPool(const char *path, int threads, AuthCallback callback, void *context);
+void DestroyAuthPool(AuthPool *pool);
+unsigned SubmitAuthRequest(AuthPool *pool, const AuthRequest *request);
+int DispatchAuthResults(AuthPool *pool, int maxResults);
+bool IsAuthPoolBusy(AuthPool *pool);
+
+#endif
@@ -0,0 +1,1217 @@
+#include "authpool.h"
+#include "db.h"
+#include "reminder.h"
+#include "search.h"
+#include "storage.h"
+#include "taskcore.h"
+#include "taskio.h"
+#include "taskstore.h"
+#include "taskwire.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DB_PATH "bench.db"
+#define DEFAULT_ROWS 2000
+
+#define SCALE_DB_PATH "bench-scale.db"
+#define SCALE_JSON_PATH "bench-scale.json"
+#define DEFAULT_USERS 100
+#define DEFAULT_TASKS_PER_USER 1000
+#define DEFAULT_TITLE_MEAN 24
+#define DEFAULT_TITLE_MAX 200
+#define DEFAULT_SAMPLES 1000
+#define DEFAULT_FRAMES 600
+#define SCALE_PAGE_SIZE 64
+// The dataset registers every user, so scale hashes cheaply by default;
+// bench kdf measures the real cost
+#define SCALE_KDF_ITERATIONS 1000
+
+#define KDF_DB_PATH "bench-kdf.db"
+#define KDF_USERS 8
+#define DEFAULT_KDF_LOGINS 16
+#define MAX_KDF_COSTS 16
+#define MAX_SERIES 16
+
+#define DEFAULT_LOAD_CONNECTIONS 16
+#define DEFAULT_LOAD_REQUESTS 5000 // Per connection
+#define DEFAULT_LOAD_PIPELINE 8
+#define LOAD_LIST_LIMIT 50
+#define LOAD_KNOWN_IDS 256         // Acknowledged task ids each client completes and deletes from
+
+typedef struct {
+    const char *name;
+    double *samples; // Milliseconds per operation
+    int count;
+    double totalMs;
+} LatencySeries;
+
+// bench scale options
+typedef struct {
+    int users;
+    int tasksPerUser;
+    int titleMean;       // Title lengths are exponential around this...
+    int titleMax;        // ...and clipped here
+    int samples;         // Operations timed per path
+    int frames;
+    unsigned seed;
+    const char *dbPath;
+    const char *appPath; // Dashboard binary for the frame-time run, if any
+    const char *jsonPath;
+    bool keep;
+    int kdfIterations;
+} ScaleConfig;
+
+// bench kdf options
+typedef struct {
+    int costs[MAX_KDF_COSTS];
+    int costCount;
+    int threads;         // Pool size for the parallel run; 0 for one per core
+    int logins;
+    const char *jsonPath; // Optional
+} KdfConfig;
+
+typedef struct {
+    int iterations;
+    int threads;
+    int logins;
+    int failed;
+    double seconds;
+} KdfResult;
+
+// Counts what the pool hands back during a KDF run
+typedef struct {
+    int finished;
+    int failed;
+} KdfProgress;
+
+// bench server options
+typedef struct {
+    const char *socketPath;
+    int connections;
+    int requests;        // Per connection, after it has registered
+    int pipeline;        // Requests each connection keeps in flight
+    const char *jsonPath; // Optional
+} LoadConfig;
+
+typedef enum {
+    LOAD_ADD,
+    LOAD_LIST,
+    LOAD_COMPLETE,
+    LOAD_DELETE,
+    LOAD_OP_COUNT
+} LoadOp;
+
+static const char *loadOpNames[LOAD_OP_COUNT] = {"add", "list", "complete", "delete"};
+
+// One connection's share of a bench server run
+typedef struct {
+    const LoadConfig *config;
+    int index;
+    pthread_t thread;
+    pthread_barrier_t *start;
+    unsigned long long rng;
+    int fd;
+    WireBuffer in;
+    WireBuffer out;
+    double *samples;     // Milliseconds from send to response, per request
+    unsigned char *ops;  // LoadOp of each sample
+    int count;
+    int failed;          // Answered with something other than WIRE_OK
+    bool broken;         // Couldn't connect or register, or lost the connection
+    int knownIds[LOAD_KNOWN_IDS];
+    int knownCount;
+} LoadClient;
+
+typedef struct {
+    const char *name;
+    int ops;
+    double opsPerSecond;
+    double meanMs;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+} SeriesSummary;
+
+typedef struct {
+    SeriesSummary series[MAX_SERIES];
+    int seriesCount;
+    long long tasks;
+    double generateSeconds;
+    long long dbBytes;
+    int listTasks;       // user0's whole list loaded into one TaskList
+    size_t listBytes;
+    double listLoadMs;
+    char *frames;        // JSON object written by the dashboard, or NULL
+} ScaleResults;
+
+static const char *titleWords[] = {
+    "buy", "milk", "call", "mom", "review", "pull", "request", "fix", "login", "bug",
+    "write", "report", "plan", "sprint", "book", "flight", "pay", "rent", "clean", "kitchen",
+    "update", "docs", "email", "team", "schedule", "meeting", "order", "parts", "renew", "license",
+    "backup", "server", "deploy", "release", "water", "plants", "walk", "dog", "read", "chapter",
+    "prepare", "slides", "refactor", "parser", "measure", "latency", "archive", "invoices", "draft", "proposal",
+    "groceries", "dentist", "appointment", "garage", "taxes", "budget", "onboarding", "checklist", "migrate", "database",
+    "profile", "search", "index", "cache",
+};
+#define TITLE_WORD_COUNT (int)(sizeof(titleWords) / sizeof(titleWords[0]))
+
+static unsigned long long rngState;
+
+static double NowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double Percentile(LatencySeries *series, double p) {
+    if (series->count == 0) {
+        return 0;
+    }
+    qsort(series->samples, series->count, sizeof(double), CompareDoubles);
+    int index = (int)(p * (series->count - 1));
+    return series->samples[index];
+}
+
+static void PrintSeries(const char *config, LatencySeries *series) {
+    printf("%-16s %-10s %8d ops %10.0f ops/s   p50 %7.3f ms   p99 %7.3f ms\n",
+           config, series->name, series->count, series->count / (series->totalMs / 1000.0),
+           Percentile(series, 0.50), Percentile(series, 0.99));
+}
+
+static void RemoveDatabaseFiles(const char *path) {
+    const char *suffixes[] = {"", "-wal", "-shm", "-journal"};
+    char file[1024];
+    for (int i = 0; i < 4; i++) {
+        snprintf(file, sizeof(file), "%s%s", path, suffixes[i]);
+        unlink(file);
+    }
+}
+
+static void RemoveBenchFiles(void) {
+    RemoveDatabaseFiles(BENCH_DB_PATH);
+}
+
+// Single-row autocommit writes, the way the dashboard issues them, then
+// keyset page reads over the result
+static void RunStorageBenchmark(const char *name, const StorageConfig *config, int rows) {
+    RemoveBenchFiles();
+    SetStorageConfig(config);
+
+    Database *db = OpenDatabase(BENCH_DB_PATH);
+    if (db == NULL) {
+        return;
+    }
+    Checkpointer *checkpointer = StartCheckpointer(BENCH_DB_PATH);
+    int userId = FindOrCreateUser("bench", db);
+
+    double *samples = malloc(rows * sizeof(double));
+    LatencySeries inserts = {"insert", samples, 0, 0};
+    for (int i = 0; i < rows; i++) {
+        char title[64];
+        snprintf(title, sizeof(title), "Benchmark task %d", i);
+        double start = NowMs();
+        AddTask(userId, title, 0, 0, NULL, db);
+        inserts.samples[inserts.count++] = NowMs() - start;
+        inserts.totalMs += inserts.samples[inserts.count - 1];
+    }
+    PrintSeries(name, &inserts);
+
+    LatencySeries updates = {"complete", samples, 0, 0};
+    for (int i = 0; i < rows; i++) {
+        double start = NowMs();
+        MarkTaskComplete(userId, i + 1, db);
+        updates.samples[updates.count++] = NowMs() - start;
+        updates.totalMs += updates.samples[updates.count - 1];
+    }
+    PrintSeries(name, &updates);
+
+    LatencySeries pages = {"page read", samples, 0, 0};
+    TaskKey last = TASK_KEY_FIRST;
+    for (;;) {
+        double start = NowMs();
+        int fetched = 0;
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_SELECT_TASK_PAGE);
+        sqlite3_bind_int(stmt, 1, userId);
+        sqlite3_bind_double(stmt, 2, last.rank);
+        sqlite3_bind_int(stmt, 3, last.id);
+        sqlite3_bind_int(stmt, 4, 64);
+        while (StepStatement(db, stmt) == SQLITE_ROW) {
+            last.id = sqlite3_column_int(stmt, 0);
+            last.rank = sqlite3_column_double(stmt, 3);
+            fetched++;
+        }
+        EndStatement(db, stmt);
+        if (fetched == 0) {
+            break;
+        }
+        pages.samples[pages.count++] = NowMs() - start;
+        pages.totalMs += pages.samples[pages.count - 1];
+    }
+    PrintSeries(name, &pages);
+
+    free(samples);
+    StopCheckpointer(checkpointer);
+    CloseDatabase(db);
+    RemoveBenchFiles();
+}
+
+// xorshift64*; the dataset only depends on the seed
+static unsigned NextRandom(void) {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (unsigned)((rngState * 2685821657736338717ULL) >> 32);
+}
+
+static int RandomBelow(int limit) {
+    return (int)(NextRandom() % (unsigned)limit);
+}
+
+static void RandomTitle(const ScaleConfig *config, char *title, int capacity) {
+    double unit = (NextRandom() + 1.0) / 4294967297.0;
+    int length = 1 + (int)(-log(unit) * config->titleMean);
+    if (length > config->titleMax) length = config->titleMax;
+    if (length > capacity - 1) length = capacity - 1;
+
+    int used = 0;
+    while (used < length) {
+        const char *word = titleWords[RandomBelow(TITLE_WORD_COUNT)];
+        if (used > 0) {
+            title[used++] = ' ';
+        }
+        for (const char *c = word; *c != '\0' && used < length; c++) {
+            title[used++] = *c;
+        }
+    }
+    title[used] = '\0';
+}
+
+static void AddSample(LatencySeries *series, double ms) {
+    series->samples[series->count++] = ms;
+    series->totalMs += ms;
+}
+
+// Sorts the samples; call once the series is complete
+static void Summarize(ScaleResults *results, LatencySeries *series) {
+    if (results->seriesCount == MAX_SERIES) {
+        return;
+    }
+    SeriesSummary *summary = &results->series[results->seriesCount++];
+    summary->name = series->name;
+    summary->ops = series->count;
+    summary->opsPerSecond = series->totalMs > 0 ? series->count / (series->totalMs / 1000.0) : 0;
+    summary->meanMs = series->count > 0 ? series->totalMs / series->count : 0;
+    summary->p50Ms = Percentile(series, 0.50);
+    summary->p99Ms = Percentile(series, 0.99);
+    summary->maxMs = series->count > 0 ? series->samples[series->count - 1] : 0;
+    printf("scale            %-18s %8d ops %10.0f ops/s   p50 %7.3f ms   p99 %7.3f ms\n",
+            summary->name, summary->ops, summary->opsPerSecond, summary->p50Ms, summary->p99Ms);
+}
+
+static long long DatabaseBytes(const char *path) {
+    const char *suffixes[] = {"", "-wal"};
+    char file[1024];
+    long long bytes = 0;
+    for (int i = 0; i < 2; i++) {
+        struct stat info;
+        snprintf(file, sizeof(file), "%s%s", path, suffixes[i]);
+        if (stat(file, &info) == 0) {
+            bytes += info.st_size;
+        }
+    }
+    return bytes;
+}
+
+// Registers users x tasksPerUser, timing each registration. Every user's
+// tasks get consecutive ids starting at firstTaskIds[u], ranked one
+// TASK_RANK_STEP apart in the same order.
+static bool GenerateDataset(Database *db, const ScaleConfig *config, int *userIds, int *firstTaskIds,
+                            ScaleResults *results, double *samples) {
+    char username[64];
+    char password[64];
+    LatencySeries registrations = {"register", samples, 0, 0};
+    for (int u = 0; u < config->users; u++) {
+        snprintf(username, sizeof(username), "user%d", u);
+        snprintf(password, sizeof(password), "password%d", u);
+        double start = NowMs();
+        if (!RegisterUser(username, password, db)) {
+            printf("Failed to register %s; is %s left over from an earlier run?\n", username, config->dbPath);
+            return false;
+        }
+        AddSample(&registrations, NowMs() - start);
+        userIds[u] = (int)sqlite3_last_insert_rowid(db->handle);
+    }
+    Summarize(results, &registrations);
+
+    // Bulk load in the importer's batch size
+    double start = NowMs();
+    char title[IMPORT_TITLE_MAX];
+    long long inBatch = 0;
+    RunStatement(db, STMT_BEGIN);
+    for (int u = 0; u < config->users; u++) {
+        for (int t = 0; t < config->tasksPerUser; t++) {
+            RandomTitle(config, title, sizeof(title));
+            sqlite3_stmt *stmt = BeginStatement(db, STMT_IMPORT_TASK);
+            sqlite3_bind_int(stmt, 1, userIds[u]);
+            sqlite3_bind_text(stmt, 2, title, -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt, 3, RandomBelow(10) < 3);
+            bool inserted = StepStatement(db, stmt) == SQLITE_DONE;
+            EndStatement(db, stmt);
+            if (!inserted) {
+                printf("Failed to insert task: %s\n", sqlite3_errmsg(db->handle));
+                RunStatement(db, STMT_ROLLBACK);
+                return false;
+            }
+            if (t == 0) {
+                firstTaskIds[u] = (int)sqlite3_last_insert_rowid(db->handle);
+            }
+            if (++inBatch == IMPORT_BATCH_SIZE) {
+                RunStatement(db, STMT_COMMIT);
+                RunStatement(db, STMT_BEGIN);
+                inBatch = 0;
+            }
+        }
+    }
+    RunStatement(db, STMT_COMMIT);
+    results->tasks = (long long)config->users * config->tasksPerUser;
+    results->generateSeconds = (NowMs() - start) / 1000.0;
+    return true;
+}
+
+// Times every path the dashboard and taskcli exercise against random users
+static void RunScalePaths(Database *db, const ScaleConfig *config, const int *userIds, const int *firstTaskIds,
+                          ScaleResults *results, double *samples) {
+    TaskList tasks;
+    InitTaskList(&tasks);
+    char text[IMPORT_TITLE_MAX];
+    char password[64];
+    int n = config->samples;
+
+    LatencySeries logins = {"login", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        int u = RandomBelow(config->users);
+        char username[64];
+        snprintf(username, sizeof(username), "user%d", u);
+        snprintf(password, sizeof(password), "password%d", u);
+        double start = NowMs();
+        LoginUser(username, password, db);
+        AddSample(&logins, NowMs() - start);
+    }
+    Summarize(results, &logins);
+
+    LatencySeries counts = {"count", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        double start = NowMs();
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_COUNT_TASKS);
+        sqlite3_bind_int(stmt, 1, userIds[RandomBelow(config->users)]);
+        StepStatement(db, stmt);
+        EndStatement(db, stmt);
+        AddSample(&counts, NowMs() - start);
+    }
+    Summarize(results, &counts);
+
+    LatencySeries statsReads = {"stats_read", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        TaskCounts taskCounts;
+        double start = NowMs();
+        ReadTaskCounts(userIds[RandomBelow(config->users)], time(NULL), &taskCounts, db);
+        AddSample(&statsReads, NowMs() - start);
+    }
+    Summarize(results, &statsReads);
+
+    LatencySeries firstPages = {"fetch_first_page", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        double start = NowMs();
+        ListTasks(userIds[RandomBelow(config->users)], TASK_KEY_FIRST, &tasks, SCALE_PAGE_SIZE, db);
+        AddSample(&firstPages, NowMs() - start);
+        TruncateTaskList(&tasks, 0);
+    }
+    Summarize(results, &firstPages);
+
+    LatencySeries deepPages = {"fetch_deep_page", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        int u = RandomBelow(config->users);
+        TaskKey after = {(double)RandomBelow(config->tasksPerUser) * TASK_RANK_STEP, INT_MAX};
+        double start = NowMs();
+        ListTasks(userIds[u], after, &tasks, SCALE_PAGE_SIZE, db);
+        AddSample(&deepPages, NowMs() - start);
+        TruncateTaskList(&tasks, 0);
+    }
+    Summarize(results, &deepPages);
+
+    LatencySeries searches = {"search", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        // Three-letter prefixes, the way search-as-you-type first fires
+        snprintf(text, 4, "%s", titleWords[RandomBelow(TITLE_WORD_COUNT)]);
+        double start = NowMs();
+        SearchTasks(userIds[RandomBelow(config->users)], text, &tasks, SEARCH_RESULT_LIMIT, db);
+        AddSample(&searches, NowMs() - start);
+        TruncateTaskList(&tasks, 0);
+    }
+    Summarize(results, &searches);
+
+    // Footprint of one user's entire list held in memory at once
+    double start = NowMs();
+    TaskKey last = TASK_KEY_FIRST;
+    while (ListTasks(userIds[0], last, &tasks, SCALE_PAGE_SIZE, db) > 0) {
+        last = GetTaskKey(&tasks, tasks.count - 1);
+    }
+    results->listLoadMs = NowMs() - start;
+    results->listTasks = tasks.count;
+    results->listBytes = GetTaskListBytes(&tasks);
+    FreeTaskList(&tasks);
+    printf("scale            user0 list       %d tasks in %zu bytes (%.1f bytes/task), loaded in %.1f ms\n",
+           results->listTasks, results->listBytes,
+           results->listTasks > 0 ? (double)results->listBytes / results->listTasks : 0.0, results->listLoadMs);
+
+    LatencySeries adds = {"add", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        RandomTitle(config, text, sizeof(text));
+        double start = NowMs();
+        AddTask(userIds[RandomBelow(config->users)], text, 0, 0, NULL, db);
+        AddSample(&adds, NowMs() - start);
+    }
+    Summarize(results, &adds);
+
+    // Drag-and-drop: a random task dropped between two generated neighbours
+    LatencySeries moves = {"move", samples, 0, 0};
+    for (int i = 0; i < n && config->tasksPerUser > 2; i++) {
+        int u = RandomBelow(config->users);
+        int after = firstTaskIds[u] + RandomBelow(config->tasksPerUser - 1);
+        int taskId = firstTaskIds[u] + RandomBelow(config->tasksPerUser);
+        if (taskId == after || taskId == after + 1) {
+            continue;
+        }
+        double rank;
+        bool rebalanced;
+        double start = NowMs();
+        MoveTask(userIds[u], taskId, after, after + 1, &rank, &rebalanced, db);
+        AddSample(&moves, NowMs() - start);
+    }
+    Summarize(results, &moves);
+
+    // Due dates spread over the next week, then the day-ahead window the
+    // reminder scheduler loads from tasks_due
+    long long now = time(NULL);
+    LatencySeries dues = {"set_due", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        int u = RandomBelow(config->users);
+        long long dueAt = now + 1 + RandomBelow(7 * 86400);
+        double start = NowMs();
+        SetTaskDue(userIds[u], firstTaskIds[u] + RandomBelow(config->tasksPerUser), dueAt, 0, db);
+        AddSample(&dues, NowMs() - start);
+    }
+    Summarize(results, &dues);
+
+    LatencySeries dueWindows = {"due_window", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        double start = NowMs();
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_SELECT_DUE_TASKS);
+        sqlite3_bind_int(stmt, 1, userIds[RandomBelow(config->users)]);
+        sqlite3_bind_int64(stmt, 2, now);
+        sqlite3_bind_int(stmt, 3, INT_MAX);
+        sqlite3_bind_int64(stmt, 4, now + REMINDER_WINDOW_SECONDS);
+        sqlite3_bind_int(stmt, 5, REMINDER_CAPACITY);
+        while (StepStatement(db, stmt) == SQLITE_ROW) {
+        }
+        EndStatement(db, stmt);
+        AddSample(&dueWindows, NowMs() - start);
+    }
+    Summarize(results, &dueWindows);
+
+    LatencySeries completes = {"complete", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        int u = RandomBelow(config->users);
+        double start = NowMs();
+        MarkTaskComplete(userIds[u], firstTaskIds[u] + RandomBelow(config->tasksPerUser), db);
+        AddSample(&completes, NowMs() - start);
+    }
+    Summarize(results, &completes);
+
+    LatencySeries deletes = {"delete", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        int u = RandomBelow(config->users);
+        double start = NowMs();
+        DeleteTask(userIds[u], firstTaskIds[u] + RandomBelow(config->tasksPerUser), db);
+        AddSample(&deletes, NowMs() - start);
+    }
+    Summarize(results, &deletes);
+
+    // What a TaskStore reads after another connection commits: one user's
+    // share of the recent changes, each joined to its row
+    sqlite3_stmt *bounds = BeginStatement(db, STMT_FEED_BOUNDS);
+    long long newest = StepStatement(db, bounds) == SQLITE_ROW ? sqlite3_column_int64(bounds, 1) : 0;
+    EndStatement(db, bounds);
+    LatencySeries feedTails = {"feed_tail", samples, 0, 0};
+    for (int i = 0; i < n; i++) {
+        double start = NowMs();
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_SELECT_CHANGES);
+        sqlite3_bind_int(stmt, 1, userIds[RandomBelow(config->users)]);
+        sqlite3_bind_int64(stmt, 2, newest - 4 * n);
+        sqlite3_bind_int(stmt, 3, TASK_FEED_BATCH);
+        while (StepStatement(db, stmt) == SQLITE_ROW) {
+        }
+        EndStatement(db, stmt);
+        AddSample(&feedTails, NowMs() - start);
+    }
+    Summarize(results, &feedTails);
+}
+
+// Runs the dashboard's scripted scroll against user0 and keeps its JSON
+static char *RunFrameBenchmark(const ScaleConfig *config) {
+    char jsonPath[1024];
+    char command[4096];
+    snprintf(jsonPath, sizeof(jsonPath), "%s.frames.json", config->dbPath);
+    snprintf(command, sizeof(command), "'%s' --db '%s' --user user0 --bench-frames %d --bench-json '%s' > /dev/null",
+             config->appPath, config->dbPath, config->frames, jsonPath);
+    if (system(command) != 0) {
+        printf("Frame benchmark failed: %s\n", command);
+        return NULL;
+    }
+
+    FILE *in = fopen(jsonPath, "r");
+    if (in == NULL) {
+        return NULL;
+    }
+    char *frames = calloc(1, 4096);
+    size_t length = frames != NULL ? fread(frames, 1, 4095, in) : 0;
+    fclose(in);
+    unlink(jsonPath);
+    while (length > 0 && (frames[length - 1] == '\n' || frames[length - 1] == ' ')) {
+        frames[--length] = '\0';
+    }
+    return frames;
+}
+
+static bool WriteScaleJson(const ScaleConfig *config, const ScaleResults *results) {
+    FILE *out = fopen(config->jsonPath, "w");
+    if (out == NULL) {
+        printf("Failed to open %s for writing\n", config->jsonPath);
+        return false;
+    }
+
+    fprintf(out, "{\n  \"benchmark\": \"scale\",\n");
+    fprintf(out, "  \"config\": {\"users\": %d, \"tasks_per_user\": %d, \"title_mean\": %d, \"title_max\": %d, "
+                 "\"samples\": %d, \"seed\": %u, \"kdf_iterations\": %d},\n",
+            config->users, config->tasksPerUser, config->titleMean, config->titleMax, config->samples, config->seed,
+            config->kdfIterations);
+    fprintf(out, "  \"dataset\": {\"tasks\": %lld, \"generate_seconds\": %.3f, \"tasks_per_second\": %.0f, \"db_bytes\": %lld},\n",
+            results->tasks, results->generateSeconds,
+            results->generateSeconds > 0 ? results->tasks / results->generateSeconds : 0, results->dbBytes);
+    fprintf(out, "  \"task_list\": {\"tasks\": %d, \"bytes\": %zu, \"bytes_per_task\": %.1f, \"load_ms\": %.3f},\n",
+            results->listTasks, results->listBytes,
+            results->listTasks > 0 ? (double)results->listBytes / results->listTasks : 0.0, results->listLoadMs);
+    fprintf(out, "  \"results\": {\n");
+    for (int i = 0; i < results->seriesCount; i++) {
+        const SeriesSummary *s = &results->series[i];
+        fprintf(out, "    \"%s\": {\"ops\": %d, \"ops_per_second\": %.1f, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+                     "\"p99_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+                s->name, s->ops, s->opsPerSecond, s->meanMs, s->p50Ms, s->p99Ms, s->maxMs,
+                i + 1 < results->seriesCount ? "," : "");
+    }
+    fprintf(out, "  },\n  \"frames\": %s\n}\n", results->frames != NULL ? results->frames : "null");
+    if (fclose(out) != 0) {
+        return false;
+    }
+    printf("Results written to %s\n", config->jsonPath);
+    return true;
+}
+
+// Synthetic dataset at the configured size, then per-path latencies as JSON
+static int RunScaleBenchmark(const ScaleConfig *config) {
+    StorageConfig storage = DefaultStorageConfig();
+    LoadStorageConfig("storage.conf", &storage);
+    storage.passwordIterations = config->kdfIterations;
+    SetStorageConfig(&storage);
+    RemoveDatabaseFiles(config->dbPath);
+    rngState = config->seed * 2654435761ULL + 1;
+
+    Database *db = OpenDatabase(config->dbPath);
+    if (db == NULL) {
+        return 1;
+    }
+    Checkpointer *checkpointer = StartCheckpointer(config->dbPath);
+
+    int *userIds = malloc(config->users * sizeof(int));
+    int *firstTaskIds = malloc(config->users * sizeof(int));
+    int sampleCapacity = config->users > config->samples ? config->users : config->samples;
+    double *samples = malloc(sampleCapacity * sizeof(double));
+    ScaleResults results = {0};
+
+    bool ok = GenerateDataset(db, config, userIds, firstTaskIds, &results, samples);
+    if (ok) {
+        printf("scale            generated %lld tasks in %.2f s\n", results.tasks, results.generateSeconds);
+        RunScalePaths(db, config, userIds, firstTaskIds, &results, samples);
+    }
+    StopCheckpointer(checkpointer);
+    CloseDatabase(db);
+    results.dbBytes = DatabaseBytes(config->dbPath);
+
+    if (ok && config->appPath != NULL) {
+        results.frames = RunFrameBenchmark(config);
+    }
+    if (ok) {
+        ok = WriteScaleJson(config, &results);
+    }
+
+    free(results.frames);
+    free(samples);
+    free(firstTaskIds);
+    free(userIds);
+    if (!config->keep) {
+        RemoveDatabaseFiles(config->dbPath);
+    }
+    return ok ? 0 : 1;
+}
+
+static void CountAuthResult(const AuthRequest *result, void *context) {
+    KdfProgress *progress = context;
+    progress->finished++;
+    if (!result->ok) {
+        progress->failed++;
+    }
+}
+
+// Logs in round-robin over the registered users through a pool of the given
+// size, keeping it saturated. Pool start-up is not timed.
+static bool RunKdfLogins(int threads, int logins, KdfResult *result) {
+    KdfProgress progress = {0};
+    AuthPool *pool = CreateAuthPool(KDF_DB_PATH, threads, CountAuthResult, &progress);
+    if (pool == NULL) {
+        return false;
+    }
+
+    double start = NowMs();
+    int submitted = 0;
+    while (progress.finished < logins) {
+        while (submitted < logins) {
+            AuthRequest request = {.type = AUTH_LOGIN};
+            snprintf(request.username, sizeof(request.username), "kdf%d", submitted % KDF_USERS);
+            snprintf(request.password, sizeof(request.password), "password%d", submitted % KDF_USERS);
+            if (SubmitAuthRequest(pool, &request) == 0) {
+                break;
+            }
+            submitted++;
+        }
+        if (DispatchAuthResults(pool, AUTH_QUEUE_SIZE) == 0) {
+            usleep(200);
+        }
+    }
+    result->seconds = (NowMs() - start) / 1000.0;
+    result->threads = pool->threadCount;
+    result->logins = logins;
+    result->failed = progress.failed;
+    DestroyAuthPool(pool);
+    return true;
+}
+
+static void PrintKdfResult(const KdfResult *result) {
+    double perSecond = result->logins / result->seconds;
+    printf("kdf %8d iterations %3d thread%s %9.1f logins/s %9.1f per core %9.2f ms/login%s\n",
+           result->iterations, result->threads, result->threads == 1 ? " " : "s", perSecond,
+           perSecond / result->threads, 1000.0 * result->seconds * result->threads / result->logins,
+           result->failed > 0 ? "  FAILED LOGINS" : "");
+}
+
+static bool WriteKdfJson(const char *path, const KdfResult *results, int count) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+    fprintf(out, "{\n  \"benchmark\": \"kdf\",\n  \"results\": [\n");
+    for (int i = 0; i < count; i++) {
+        const KdfResult *r = &results[i];
+        double perSecond = r->logins / r->seconds;
+        fprintf(out, "    {\"iterations\": %d, \"threads\": %d, \"logins\": %d, \"failed\": %d, "
+                     "\"logins_per_second\": %.2f, \"logins_per_second_per_core\": %.2f}%s\n",
+                r->iterations, r->threads, r->logins, r->failed, perSecond, perSecond / r->threads,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    if (fclose(out) != 0) {
+        return false;
+    }
+    printf("Results written to %s\n", path);
+    return true;
+}
+
+// For every cost: register a few users at that cost, then time logins on a
+// single auth thread and on the whole pool
+static int RunKdfBenchmark(const KdfConfig *config) {
+    StorageConfig storage = DefaultStorageConfig();
+    LoadStorageConfig("storage.conf", &storage);
+    KdfResult results[MAX_KDF_COSTS * 2];
+    int resultCount = 0;
+    bool ok = true;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int parallel = config->threads > 0 ? config->threads : cores > 0 ? (int)cores : 1;
+
+    for (int c = 0; c < config->costCount && ok; c++) {
+        storage.passwordIterations = config->costs[c];
+        SetStorageConfig(&storage);
+        RemoveDatabaseFiles(KDF_DB_PATH);
+
+        Database *db = OpenDatabase(KDF_DB_PATH);
+        if (db == NULL) {
+            return 1;
+        }
+        for (int u = 0; u < KDF_USERS && ok; u++) {
+            char username[32];
+            char password[32];
+            snprintf(username, sizeof(username), "kdf%d", u);
+            snprintf(password, sizeof(password), "password%d", u);
+            ok = RegisterUser(username, password, db);
+        }
+        CloseDatabase(db);
+
+        // On one core the parallel run would only repeat the first
+        int threadCounts[2] = {1, parallel};
+        for (int t = 0; t < (parallel > 1 ? 2 : 1) && ok; t++) {
+            KdfResult *result = &results[resultCount];
+            result->iterations = config->costs[c];
+            ok = RunKdfLogins(threadCounts[t], config->logins, result);
+            if (ok) {
+                PrintKdfResult(result);
+                resultCount++;
+            }
+        }
+    }
+    RemoveDatabaseFiles(KDF_DB_PATH);
+
+    if (ok && config->jsonPath != NULL) {
+        ok = WriteKdfJson(config->jsonPath, results, resultCount);
+    }
+    return ok ? 0 : 1;
+}
+
+// xorshift64* per client, so the threads don't share the dataset's state
+static unsigned NextLoadRandom(LoadClient *client) {
+    client->rng ^= client->rng >> 12;
+    client->rng ^= client->rng << 25;
+    client->rng ^= client->rng >> 27;
+    return (unsigned)((client->rng * 2685821657736338717ULL) >> 32);
+}
+
+static bool SendLoadRequests(LoadClient *client) {
+    size_t sent = 0;
+    while (sent < client->out.length) {
+        ssize_t count = send(client->fd, client->out.data + sent, client->out.length - sent, MSG_NOSIGNAL);
+        if (count <= 0) {
+            return false;
+        }
+        sent += count;
+    }
+    client->out.length = 0;
+    return !client->out.failed;
+}
+
+// Blocks until a whole response is buffered; returns its length, header
+// included, or 0 if the connection went away
+static long ReceiveLoadResponse(LoadClient *client) {
+    for (;;) {
+        long frame = PeekWireFrame(client->in.data, client->in.length, WIRE_MAX_RESPONSE);
+        if (frame != 0) {
+            return frame > 0 ? frame : 0;
+        }
+        if (!ReserveWireBuffer(&client->in, 65536)) {
+            return 0;
+        }
+        ssize_t received = recv(client->fd, client->in.data + client->in.length, 65536, 0);
+        if (received <= 0) {
+            return 0;
+        }
+        client->in.length += received;
+    }
+}
+
+static bool ConnectLoadClient(LoadClient *client) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", client->config->socketPath);
+    client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        return false;
+    }
+
+    // A fresh account per connection, so runs never see each other's tasks
+    char username[64];
+    snprintf(username, sizeof(username), "load%d-%d-%d", (int)getpid(), (int)time(NULL), client->index);
+    size_t start = BeginWireFrame(&client->out);
+    PutWireU8(&client->out, WIRE_REGISTER);
+    PutWireString(&client->out, username);
+    PutWireString(&client->out, "load-password");
+    EndWireFrame(&client->out, start);
+    long frame = SendLoadRequests(client) ? ReceiveLoadResponse(client) : 0;
+    bool ok = frame > WIRE_HEADER_LEN && client->in.data[WIRE_HEADER_LEN] == WIRE_OK;
+    ConsumeWireBuffer(&client->in, frame);
+    return ok;
+}
+
+// Half adds, then lists, completes and deletes of tasks the server has
+// already acknowledged
+static LoadOp NextLoadOp(LoadClient *client, WireBuffer *out) {
+    unsigned roll = NextLoadRandom(client) % 10;
+    LoadOp op = client->knownCount == 0 || roll < 5 ? LOAD_ADD : roll < 7 ? LOAD_LIST : roll < 9 ? LOAD_COMPLETE : LOAD_DELETE;
+    size_t start = BeginWireFrame(out);
+    if (op == LOAD_ADD) {
+        char title[64];
+        snprintf(title, sizeof(title), "load task %u", NextLoadRandom(client) % 100000);
+        PutWireU8(out, WIRE_ADD);
+        PutWireString(out, title);
+    } else if (op == LOAD_LIST) {
+        PutWireU8(out, WIRE_LIST);
+        PutWireF64(out, 0);
+        PutWireU32(out, 0);
+        PutWireU16(out, LOAD_LIST_LIMIT);
+    } else {
+        int slot = (int)(NextLoadRandom(client) % (unsigned)client->knownCount);
+        PutWireU8(out, op == LOAD_COMPLETE ? WIRE_COMPLETE : WIRE_DELETE);
+        PutWireU32(out, (unsigned)client->knownIds[slot]);
+        if (op == LOAD_DELETE) {
+            client->knownIds[slot] = client->knownIds[--client->knownCount];
+        }
+    }
+    EndWireFrame(out, start);
+    return op;
+}
+
+static void *LoadClientMain(void *arg) {
+    LoadClient *client = arg;
+    const LoadConfig *config = client->config;
+    client->broken = client->samples == NULL || client->ops == NULL || !ConnectLoadClient(client);
+    pthread_barrier_wait(client->start);
+    if (client->broken) {
+        return NULL;
+    }
+
+    // Ring of the requests in flight, oldest first
+    double *sentAt = calloc(config->pipeline, sizeof(double));
+    unsigned char *inFlight = calloc(config->pipeline, 1);
+    int sent = 0;
+    while (client->count < config->requests && sentAt != NULL && inFlight != NULL) {
+        int batch = 0;
+        while (sent < config->requests && sent - client->count < config->pipeline) {
+            inFlight[sent % config->pipeline] = (unsigned char)NextLoadOp(client, &client->out);
+            sent++;
+            batch++;
+        }
+        double now = NowMs();
+        for (int i = sent - batch; i < sent; i++) {
+            sentAt[i % config->pipeline] = now;
+        }
+        if (batch > 0 && !SendLoadRequests(client)) {
+            break;
+        }
+
+        long frame = ReceiveLoadResponse(client);
+        if (frame <= WIRE_HEADER_LEN) {
+            break;
+        }
+        int slot = client->count % config->pipeline;
+        WireReader reader;
+        InitWireReader(&reader, client->in.data + WIRE_HEADER_LEN, frame - WIRE_HEADER_LEN);
+        bool ok = GetWireU8(&reader) == WIRE_OK;
+        if (ok && inFlight[slot] == LOAD_ADD && client->knownCount < LOAD_KNOWN_IDS) {
+            client->knownIds[client->knownCount++] = (int)GetWireU32(&reader);
+        }
+        client->failed += !ok;
+        client->samples[client->count] = NowMs() - sentAt[slot];
+        client->ops[client->count++] = inFlight[slot];
+        ConsumeWireBuffer(&client->in, frame);
+    }
+    client->broken = client->count < config->requests;
+    free(sentAt);
+    free(inFlight);
+    return NULL;
+}
+
+static void PrintLoadSeries(LatencySeries *series) {
+    double maxMs = series->count > 0 ? Percentile(series, 1.0) : 0;
+    printf("server           %-10s %8d ops   mean %7.3f ms   p50 %7.3f ms   p99 %7.3f ms   p99.9 %7.3f ms   max %7.3f ms\n",
+           series->name, series->count, series->count > 0 ? series->totalMs / series->count : 0.0,
+           Percentile(series, 0.50), Percentile(series, 0.99), Percentile(series, 0.999), maxMs);
+}
+
+static bool WriteLoadJson(const char *path, const LoadConfig *config, double seconds, long requests, long failed,
+                          LatencySeries *series, int seriesCount) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+    fprintf(out, "{\n  \"benchmark\": \"server\",\n  \"connections\": %d,\n  \"pipeline\": %d,\n",
+            config->connections, config->pipeline);
+    fprintf(out, "  \"requests\": %ld,\n  \"failed\": %ld,\n  \"seconds\": %.3f,\n  \"requests_per_second\": %.1f,\n",
+            requests, failed, seconds, requests / seconds);
+    fprintf(out, "  \"series\": [\n");
+    for (int i = 0; i < seriesCount; i++) {
+        LatencySeries *s = &series[i];
+        fprintf(out, "    {\"name\": \"%s\", \"ops\": %d, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"p999_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+                s->name, s->count, Percentile(s, 0.50), Percentile(s, 0.99), Percentile(s, 0.999), Percentile(s, 1.0),
+                i + 1 < seriesCount ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    if (fclose(out) != 0) {
+        return false;
+    }
+    printf("Results written to %s\n", path);
+    return true;
+}
+
+// Every connection registers its own account, then all of them start
+// together and keep config->pipeline requests in flight until each has had
+// config->requests answered. Throughput is over that whole stretch; latency
+// is per request, from the send that carried it to its response.
+static int RunLoadBenchmark(const LoadConfig *config) {
+    LoadClient *clients = calloc(config->connections, sizeof(LoadClient));
+    pthread_barrier_t start;
+    if (clients == NULL) {
+        return 1;
+    }
+    pthread_barrier_init(&start, NULL, (unsigned)config->connections + 1);
+    for (int i = 0; i < config->connections; i++) {
+        LoadClient *client = &clients[i];
+        client->config = config;
+        client->index = i;
+        client->start = &start;
+        client->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        client->fd = -1;
+        InitWireBuffer(&client->in);
+        InitWireBuffer(&client->out);
+        client->samples = malloc(config->requests * sizeof(double));
+        client->ops = malloc(config->requests);
+        pthread_create(&client->thread, NULL, LoadClientMain, client);
+    }
+    pthread_barrier_wait(&start);
+    double startMs = NowMs();
+    for (int i = 0; i < config->connections; i++) {
+        pthread_join(clients[i].thread, NULL);
+    }
+    double seconds = (NowMs() - startMs) / 1000.0;
+    pthread_barrier_destroy(&start);
+
+    long total = 0;
+    long failed = 0;
+    int broken = 0;
+    for (int i = 0; i < config->connections; i++) {
+        total += clients[i].count;
+        failed += clients[i].failed;
+        broken += clients[i].broken;
+    }
+    double *samples = malloc((total > 0 ? total : 1) * sizeof(double) * 2);
+    LatencySeries series[LOAD_OP_COUNT + 1];
+    long offset = total;
+    series[0] = (LatencySeries){"all", samples, 0, 0};
+    for (int op = 0; op < LOAD_OP_COUNT && samples != NULL; op++) {
+        series[op + 1] = (LatencySeries){loadOpNames[op], samples + offset, 0, 0};
+        for (int i = 0; i < config->connections; i++) {
+            for (int j = 0; j < clients[i].count; j++) {
+                if (clients[i].ops[j] == op) {
+                    AddSample(&series[0], clients[i].samples[j]);
+                    AddSample(&series[op + 1], clients[i].samples[j]);
+                }
+            }
+        }
+        offset += series[op + 1].count;
+    }
+
+    bool ok = samples != NULL && broken == 0;
+    printf("server           %d connections x %d in flight: %ld requests in %.2f s, %.0f requests/s, %ld failed\n",
+           config->connections, config->pipeline, total, seconds, total / seconds, failed);
+    if (broken > 0) {
+        printf("server           %d connection%s could not finish\n", broken, broken == 1 ? "" : "s");
+    }
+    for (int i = 0; i <= LOAD_OP_COUNT && samples != NULL; i++) {
+        PrintLoadSeries(&series[i]);
+    }
+    if (ok && config->jsonPath != NULL) {
+        ok = WriteLoadJson(config->jsonPath, config, seconds, total, failed, series, LOAD_OP_COUNT + 1);
+    }
+
+    for (int i = 0; i < config->connections; i++) {
+        if (clients[i].fd >= 0) {
+            close(clients[i].fd);
+        }
+        FreeWireBuffer(&clients[i].in);
+        FreeWireBuffer(&clients[i].out);
+        free(clients[i].samples);
+        free(clients[i].ops);
+    }
+    free(samples);
+    free(clients);
+    return ok ? 0 : 1;
+}
+
+static void PrintUsage(const char *program) {
+    printf("usage: %s [rows]\n", program);
+    printf("       %s scale [--users N] [--tasks N] [--title-mean N] [--title-max N] [--samples N]\n", program);
+    printf("             [--seed N] [--db PATH] [--keep] [--app PATH [--frames N]] [--json PATH]\n");
+    printf("             [--kdf-iterations N]\n");
+    printf("       %s kdf [--costs N,N,...] [--threads N] [--logins N] [--json PATH]\n", program);
+    printf("       %s server --socket PATH [--connections N] [--requests N] [--pipeline N] [--json PATH]\n", program);
+    printf("The first form compares storage settings. scale generates users x tasks and\n");
+    printf("writes per-path latencies as JSON to " SCALE_JSON_PATH " or --json; --app also times\n");
+    printf("dashboard frames by running that binary against the dataset. kdf reports logins\n");
+    printf("per second per core through the auth pool at each password hashing cost.\n");
+    printf("server load-tests a running app --serve: requests/s and per-request latency\n");
+    printf("over --requests requests per connection, --pipeline of them in flight at once.\n");
+}
+
+static int ScaleCommand(int argc, char **argv) {
+    ScaleConfig config = {DEFAULT_USERS, DEFAULT_TASKS_PER_USER, DEFAULT_TITLE_MEAN, DEFAULT_TITLE_MAX,
+                          DEFAULT_SAMPLES, DEFAULT_FRAMES, 1, SCALE_DB_PATH, NULL, SCALE_JSON_PATH, false,
+                          SCALE_KDF_ITERATIONS};
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--users") == 0 && hasValue) {
+            config.users = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tasks") == 0 && hasValue) {
+            config.tasksPerUser = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--title-mean") == 0 && hasValue) {
+            config.titleMean = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--title-max") == 0 && hasValue) {
+            config.titleMax = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--samples") == 0 && hasValue) {
+            config.samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            config.frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            config.seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--db") == 0 && hasValue) {
+            config.dbPath = argv[++i];
+        } else if (strcmp(argv[i], "--app") == 0 && hasValue) {
+            config.appPath = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            config.jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--kdf-iterations") == 0 && hasValue) {
+            config.kdfIterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--keep") == 0) {
+            config.keep = true;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.users <= 0 || config.tasksPerUser <= 0 || config.titleMean <= 0 || config.titleMax <= 0 ||
+        config.samples <= 0 || config.frames <= 0 || config.kdfIterations <= 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    return RunScaleBenchmark(&config);
+}
+
+// Parses "N,N,..." into config->costs
+static bool ParseKdfCosts(const char *text, KdfConfig *config) {
+    config->costCount = 0;
+    while (*text != '\0') {
+        char *end;
+        long cost = strtol(text, &end, 10);
+        if (end == text || cost <= 0 || cost > 100000000 || config->costCount == MAX_KDF_COSTS) {
+            return false;
+        }
+        config->costs[config->costCount++] = (int)cost;
+        text = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            return false;
+        }
+    }
+    return config->costCount > 0;
+}
+
+static int KdfCommand(int argc, char **argv) {
+    KdfConfig config = {{10000, 100000, 310000, 600000}, 4, 0, DEFAULT_KDF_LOGINS, NULL};
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--costs") == 0 && hasValue) {
+            if (!ParseKdfCosts(argv[++i], &config)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            config.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--logins") == 0 && hasValue) {
+            config.logins = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            config.jsonPath = argv[++i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.threads < 0 || config.logins <= 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    return RunKdfBenchmark(&config);
+}
+
+static int ServerCommand(int argc, char **argv) {
+    LoadConfig config = {NULL, DEFAULT_LOAD_CONNECTIONS, DEFAULT_LOAD_REQUESTS, DEFAULT_LOAD_PIPELINE, NULL};
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--socket") == 0 && hasValue) {
+            config.socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--connections") == 0 && hasValue) {
+            config.connections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--requests") == 0 && hasValue) {
+            config.requests = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pipeline") == 0 && hasValue) {
+            config.pipeline = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            config.jsonPath = argv[++i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.socketPath == NULL || config.connections <= 0 || config.requests <= 0 || config.pipeline <= 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    return RunLoadBenchmark(&config);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "scale") == 0) {
+        return ScaleCommand(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "kdf") == 0) {
+        return KdfCommand(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "server") == 0) {
+        return ServerCommand(argc, argv);
+    }
+
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    if (rows <= 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    StorageConfig rollback = DefaultStorageConfig();
+    rollback.walMode = false;
+    rollback.synchronous = 2;
+    rollback.cacheSizeKb = 2000;
+    rollback.mmapSizeBytes = 0;
+
+    StorageConfig wal = DefaultStorageConfig();
+    LoadStorageConfig("storage.conf", &wal);
+
+    RunStorageBenchmark("rollback/FULL", &rollback, rows);
+    RunStorageBenchmark("configured", &wal, rows);
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include "db.h"
+#include "profile.h"
+#include "schema.h"
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define STRINGIFY(x) #x
+#define SQL_NUMBER(x) STRINGIFY(x)
+
+// New tasks go after the user's last one
+#define NEXT_RANK "(SELECT IFNULL(MAX(rank), 0) + " SQL_NUMBER(TASK_RANK_STEP) " FROM tasks WHERE user_id = ?1)"
+
+static const char *statementQueries[STMT_COUNT] = {
+    [STMT_INSERT_USER] = "INSERT INTO users (username, password) VALUES (?, ?);",
+    [STMT_LOGIN_USER] = "SELECT id, password FROM users WHERE username = ?;",
+    [STMT_FIND_USER] = "SELECT id FROM users WHERE username = ?;",
+    // Only replaces the hash that was just verified, so a concurrent
+    // password change is never overwritten by a rehash
+    [STMT_UPDATE_PASSWORD] = "UPDATE users SET password = ? WHERE id = ? AND password = ?;",
+    [STMT_INSERT_TASK] = "INSERT INTO tasks (user_id, title, completed, rank, due_at, recur_every) "
+                         "VALUES (?1, ?2, 0, " NEXT_RANK ", ?3, ?4) RETURNING rank;",
+    [STMT_SELECT_TASK_PAGE] = "SELECT id, title, completed, rank, due_at, recur_every FROM tasks WHERE user_id = ? AND (rank, id) > (?, ?) "
+                              "ORDER BY rank, id LIMIT ?;",
+    [STMT_SELECT_PAGE_START] = "SELECT rank, id FROM tasks WHERE user_id = ? AND (rank, id) > (?, ?) "
+                               "ORDER BY rank, id LIMIT 1 OFFSET ?;",
+    [STMT_COUNT_TASKS] = "SELECT COUNT(*) FROM tasks WHERE user_id = ?;",
+    [STMT_DATA_VERSION] = "PRAGMA data_version;",
+    [STMT_TASK_RANK] = "SELECT rank FROM tasks WHERE id = ? AND user_id = ?;",
+    [STMT_MOVE_TASK] = "UPDATE tasks SET rank = ? WHERE id = ? AND user_id = ?;",
+    // Evenly spaced again, in the same order
+    [STMT_REBALANCE_RANKS] = "WITH ordered AS (SELECT id, ROW_NUMBER() OVER (ORDER BY rank, id) AS position "
+                             "FROM tasks WHERE user_id = ?1) "
+                             "UPDATE tasks SET rank = ordered.position * " SQL_NUMBER(TASK_RANK_STEP) " "
+                             "FROM ordered WHERE tasks.id = ordered.id;",
+    [STMT_SET_TASK_DUE] = "UPDATE tasks SET due_at = ?, recur_every = ? WHERE id = ? AND user_id = ?;",
+    // Open tasks coming due in [after, until), in firing order, off tasks_due
+    [STMT_SELECT_DUE_TASKS] = "SELECT id, due_at FROM tasks WHERE user_id = ?1 AND (due_at, id) > (?2, ?3) AND due_at < ?4 "
+                              "AND completed = 0 ORDER BY due_at, id LIMIT ?5;",
+    // Whether a fired timer still stands: same due time and still open
+    [STMT_DUE_REMINDER] = "SELECT title, recur_every FROM tasks WHERE id = ? AND user_id = ? AND due_at = ? AND completed = 0;",
+    // Only moves a due time nobody has changed since it fired
+    [STMT_ADVANCE_DUE] = "UPDATE tasks SET due_at = ? WHERE id = ? AND user_id = ? AND due_at = ?;",
+    // Oldest and newest change still in the feed, 0 when it is empty
+    [STMT_FEED_BOUNDS] = "SELECT IFNULL((SELECT MIN(seq) FROM task_changes), 0), IFNULL((SELECT MAX(seq) FROM task_changes), 0);",
+    // A user's changes after a sequence number, each with the row as it is now
+    // (NULLs once it is gone)
+    [STMT_SELECT_CHANGES] = "SELECT c.seq, c.task_id, c.kind, c.rank, t.title, t.completed, t.rank, t.due_at, t.recur_every "
+                            "FROM task_changes c LEFT JOIN tasks t ON t.id = c.task_id "
+                            "WHERE c.user_id = ? AND c.seq > ? ORDER BY c.seq LIMIT ?;",
+    // The stored counts plus tasks that fell due since the last write, so a
+    // read costs one row lookup and a short tasks_due range
+    [STMT_SELECT_TASK_COUNTS] = "SELECT c.total, c.completed, c.overdue + (SELECT COUNT(*) FROM tasks t WHERE t.user_id = c.user_id "
+                                "AND t.due_at > c.overdue_as_of AND t.due_at <= ?2 AND t.completed = 0) "
+                                "FROM task_counts c WHERE c.user_id = ?1;",
+    // Every user's stored counts next to the same counts taken from scratch
+    [STMT_VERIFY_TASK_COUNTS] = "SELECT u.id, u.username, c.total, c.completed, c.overdue, COUNT(t.id), "
+                                "IFNULL(SUM(t.completed <> 0), 0), IFNULL(SUM(t.completed = 0 AND t.due_at <= c.overdue_as_of), 0) "
+                                "FROM users u LEFT JOIN task_counts c ON c.user_id = u.id LEFT JOIN tasks t ON t.user_id = u.id "
+                                "GROUP BY u.id ORDER BY u.id;",
+    [STMT_COMPLETE_TASK] = "UPDATE tasks SET completed = 1 WHERE id = ? AND user_id = ?;",
+    [STMT_DELETE_TASK] = "DELETE FROM tasks WHERE id = ? AND user_id = ?;",
+    [STMT_UNCOMPLETE_TASK] = "UPDATE tasks SET completed = 0 WHERE id = ? AND user_id = ?;",
+    // A deleted row put back as it was, id and place in the list included,
+    // under a new id if another task has taken its old one since
+    [STMT_RESTORE_TASK] = "INSERT INTO tasks (id, user_id, title, completed, rank, due_at, recur_every) "
+                          "VALUES ((SELECT CASE WHEN EXISTS (SELECT 1 FROM tasks WHERE id = ?1) THEN NULL ELSE ?1 END), "
+                          "?2, ?3, ?4, ?5, ?6, ?7) RETURNING id;",
+    [STMT_JOURNAL_SEQ] = "SELECT seq FROM journal_applied WHERE user_id = ?;",
+    [STMT_SET_JOURNAL_SEQ] = "INSERT INTO journal_applied (user_id, seq) VALUES (?1, ?2) "
+                             "ON CONFLICT (user_id) DO UPDATE SET seq = MAX(seq, excluded.seq);",
+    [STMT_IMPORT_TASK] = "INSERT INTO tasks (user_id, title, completed, rank) VALUES (?1, ?2, ?3, " NEXT_RANK ");",
+    [STMT_EXPORT_TASKS] = "SELECT id, title, completed FROM tasks WHERE user_id = ? ORDER BY rank, id;",
+    // CROSS JOIN keeps the full-text match as the outer loop; the other way
+    // round SQLite re-runs the MATCH for every one of the user's rows
+    [STMT_SEARCH_TASKS] = "SELECT t.id, t.title, t.completed, t.rank, t.due_at, t.recur_every FROM tasks_fts CROSS JOIN tasks t ON t.id = tasks_fts.rowid "
+                          "WHERE tasks_fts MATCH ? AND t.user_id = ? ORDER BY tasks_fts.rowid LIMIT ?;",
+    [STMT_CLEAR_BULK_SPANS] = "DELETE FROM temp.bulk_spans;",
+    [STMT_INSERT_BULK_SPAN] = "INSERT INTO temp.bulk_spans (first_rank, first_id, last_rank, last_id) VALUES (?, ?, ?, ?);",
+    // Each span is a range scan of tasks_rank, so only the named rows are
+    // visited however many tasks the user has
+    [STMT_BULK_SET_COMPLETED] = "UPDATE tasks SET completed = ?1 WHERE completed <> ?1 AND id IN "
+                                "(SELECT t.id FROM temp.bulk_spans s JOIN tasks t ON t.user_id = ?2 "
+                                "AND (t.rank, t.id) BETWEEN (s.first_rank, s.first_id) AND (s.last_rank, s.last_id));",
+    [STMT_BULK_DELETE] = "DELETE FROM tasks WHERE id IN "
+                         "(SELECT t.id FROM temp.bulk_spans s JOIN tasks t ON t.user_id = ?1 "
+                         "AND (t.rank, t.id) BETWEEN (s.first_rank, s.first_id) AND (s.last_rank, s.last_id));",
+    [STMT_BEGIN] = "BEGIN IMMEDIATE;",
+    [STMT_COMMIT] = "COMMIT;",
+    [STMT_ROLLBACK] = "ROLLBACK;",
+};
+
+const char *GetStatementQuery(StatementId id) {
+    return statementQueries[id];
+}
+
+// Open the database, migrate the schema and prepare every statement up front
+Database *OpenDatabase(const char *path) {
+    Database *db = calloc(1, sizeof(Database));
+    if (db == NULL) {
+        return NULL;
+    }
+
+    if (sqlite3_open(path, &db->handle)) {
+        printf("Failed to open database: %s\n", sqlite3_errmsg(db->handle));
+        CloseDatabase(db);
+        return NULL;
+    }
+
+    if (IsProfilerRunning()) {
+        TraceStatements(db->handle);
+    }
+    sqlite3_exec(db->handle, "PRAGMA foreign_keys = ON;", NULL, NULL, NULL);
+    if (!ApplyStorageConfig(db->handle, GetStorageConfig())) {
+        CloseDatabase(db);
+        return NULL;
+    }
+    if (!MigrateSchema(db->handle)) {
+        CloseDatabase(db);
+        return NULL;
+    }
+
+    // Per-connection scratch table the bulk statements take their id spans from
+    if (sqlite3_exec(db->handle, "CREATE TEMP TABLE IF NOT EXISTS bulk_spans "
+                     "(first_rank REAL NOT NULL, first_id INTEGER NOT NULL, last_rank REAL NOT NULL, last_id INTEGER NOT NULL);",
+                     NULL, NULL, NULL) != SQLITE_OK) {
+        printf("Failed to create bulk table: %s\n", sqlite3_errmsg(db->handle));
+        CloseDatabase(db);
+        return NULL;
+    }
+
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (sqlite3_prepare_v3(db->handle, statementQueries[i], -1, SQLITE_PREPARE_PERSISTENT,
+                               &db->statements[i], NULL) != SQLITE_OK) {
+            printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db->handle));
+            CloseDatabase(db);
+            return NULL;
+        }
+        db->stats.prepares++;
+    }
+
+    return db;
+}
+
+void CloseDatabase(Database *db) {
+    if (db == NULL) {
+        return;
+    }
+    for (int i = 0; i < STMT_COUNT; i++) {
+        sqlite3_finalize(db->statements[i]);
+    }
+    sqlite3_close(db->handle);
+    free(db);
+}
+
+// Hand out a cached statement ready for binding
+sqlite3_stmt *BeginStatement(Database *db, StatementId id) {
+    return db->statements[id];
+}
+
+// SQLite only allows a busy statement to be run again outside an explicit
+// transaction (it rolled back on its own) or when it is the COMMIT
+static bool CanRetryBusy(Database *db, sqlite3_stmt *stmt, int rc) {
+    return (rc & 0xff) == SQLITE_BUSY &&
+           (sqlite3_get_autocommit(db->handle) || stmt == db->statements[STMT_COMMIT]);
+}
+
+// Sleep a little longer after each busy attempt, with jitter so writers that
+// collided don't collide again
+static void BackOffBusy(int attempt) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long delayMs = (DB_BUSY_BACKOFF_MS << attempt) + now.tv_nsec % DB_BUSY_BACKOFF_MS;
+    struct timespec delay = {delayMs / 1000, (delayMs % 1000) * 1000000L};
+    nanosleep(&delay, NULL);
+}
+
+// The busy handler waits out most lock contention; what it gives up on (or
+// is never asked about, like a stale WAL snapshot) is retried here a few
+// times before the caller sees SQLITE_BUSY. Only a statement's first step
+// is retried, since a half-read SELECT would start over.
+int StepStatement(Database *db, sqlite3_stmt *stmt) {
+    bool fresh = !sqlite3_stmt_busy(stmt);
+    db->stats.steps++;
+    int rc = sqlite3_step(stmt);
+    for (int attempt = 0; fresh && attempt < DB_BUSY_RETRIES && CanRetryBusy(db, stmt, rc); attempt++) {
+        db->stats.busyRetries++;
+        sqlite3_reset(stmt);
+        BackOffBusy(attempt);
+        rc = sqlite3_step(stmt);
+    }
+    if ((rc & 0xff) == SQLITE_BUSY) {
+        db->stats.busyFailures++;
+        printf("Database busy: %s\n", sqlite3_errmsg(db->handle));
+    }
+    return rc;
+}
+
+// Reset right after use so a half-read SELECT never holds its read lock
+void EndStatement(Database *db, sqlite3_stmt *stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    db->stats.resets++;
+}
+
+void PrintDatabaseStats(const Database *db) {
+    printf("Statements: %ld prepared, %ld steps, %ld resets, %ld busy retries, %ld busy failures\n",
+           db->stats.prepares, db->stats.steps, db->stats.resets, db->stats.busyRetries, db->stats.busyFailures);
+}
+
+// Step a statement that takes no parameters, such as BEGIN or COMMIT
+bool RunStatement(Database *db, StatementId id) {
+    sqlite3_stmt *stmt = BeginStatement(db, id);
+    bool done = StepStatement(db, stmt) == SQLITE_DONE;
+    EndStatement(db, stmt);
+    return done;
+}
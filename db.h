@@ -0,0 +1,77 @@
+#ifndef DB_H
+#define DB_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+
+// Rank gap between neighbouring tasks when appending or rebalancing
+#define TASK_RANK_STEP 1024
+// Further attempts at a statement SQLite reports busy past the busy timeout
+#define DB_BUSY_RETRIES 3
+#define DB_BUSY_BACKOFF_MS 20
+// Every statement the app runs, prepared once in OpenDatabase
+typedef enum {
+    STMT_INSERT_USER,
+    STMT_LOGIN_USER,
+    STMT_FIND_USER,
+    STMT_UPDATE_PASSWORD,
+    STMT_INSERT_TASK,
+    STMT_SELECT_TASK_PAGE,
+    STMT_SELECT_PAGE_START,
+    STMT_COUNT_TASKS,
+    STMT_DATA_VERSION,
+    STMT_TASK_RANK,
+    STMT_MOVE_TASK,
+    STMT_REBALANCE_RANKS,
+    STMT_SET_TASK_DUE,
+    STMT_SELECT_DUE_TASKS,
+    STMT_DUE_REMINDER,
+    STMT_ADVANCE_DUE,
+    STMT_FEED_BOUNDS,
+    STMT_SELECT_CHANGES,
+    STMT_SELECT_TASK_COUNTS,
+    STMT_VERIFY_TASK_COUNTS,
+    STMT_COMPLETE_TASK,
+    STMT_DELETE_TASK,
+    STMT_UNCOMPLETE_TASK,
+    STMT_RESTORE_TASK,
+    STMT_JOURNAL_SEQ,
+    STMT_SET_JOURNAL_SEQ,
+    STMT_IMPORT_TASK,
+    STMT_EXPORT_TASKS,
+    STMT_SEARCH_TASKS,
+    STMT_CLEAR_BULK_SPANS,
+    STMT_INSERT_BULK_SPAN,
+    STMT_BULK_SET_COMPLETED,
+    STMT_BULK_DELETE,
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_ROLLBACK,
+    STMT_COUNT
+} StatementId;
+
+typedef struct {
+    long prepares;
+    long steps;
+    long resets;
+    long busyRetries;
+    long busyFailures;   // Steps still busy after every retry
+} DbStats;
+
+typedef struct {
+    sqlite3 *handle;
+    sqlite3_stmt *statements[STMT_COUNT];
+    DbStats stats;
+} Database;
+
+Database *OpenDatabase(const char *path);
+void CloseDatabase(Database *db);
+sqlite3_stmt *BeginStatement(Database *db, StatementId id);
+int StepStatement(Database *db, sqlite3_stmt *stmt);
+void EndStatement(Database *db, sqlite3_stmt *stmt);
+void PrintDatabaseStats(const Database *db);
+bool RunStatement(Database *db, StatementId id);
+// The SQL a statement is prepared from
+const char *GetStatementQuery(StatementId id);
+
+#endif
@@ -0,0 +1,108 @@
+#include "dbworker.h"
+#include "profile.h"
+#include <sched.h>
+#include <stdlib.h>
+
+static bool PushJob(DbJobQueue *queue, const DbJob *job) {
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == DB_QUEUE_SIZE) {
+        return false;
+    }
+    queue->slots[tail % DB_QUEUE_SIZE] = *job;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static bool PopJob(DbJobQueue *queue, DbJob *job) {
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *job = queue->slots[head % DB_QUEUE_SIZE];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+static void *WorkerMain(void *arg) {
+    DbWorker *worker = arg;
+    DbJob job;
+
+    for (;;) {
+        sem_wait(&worker->pending);
+        if (!PopJob(&worker->submissions, &job)) {
+            // Only the shutdown post arrives with an empty queue
+            if (atomic_load(&worker->quit)) {
+                break;
+            }
+            continue;
+        }
+
+        long long start = ProfileNow();
+        worker->handler(worker->db, &job);
+        EndProfileZone("db", "job", start);
+
+        // Never drop a result; wait for the frame loop to make room
+        while (!PushJob(&worker->completions, &job)) {
+            if (atomic_load(&worker->quit)) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+DbWorker *CreateDbWorker(const char *path, DbJobHandler handler) {
+    DbWorker *worker = calloc(1, sizeof(DbWorker));
+    if (worker == NULL) {
+        return NULL;
+    }
+
+    worker->db = OpenDatabase(path);
+    if (worker->db == NULL) {
+        free(worker);
+        return NULL;
+    }
+    worker->handler = handler;
+    worker->nextJobId = 1;
+    sem_init(&worker->pending, 0, 0);
+    pthread_create(&worker->thread, NULL, WorkerMain, worker);
+    return worker;
+}
+
+// Finishes every queued job before closing the connection
+void DestroyDbWorker(DbWorker *worker) {
+    if (worker == NULL) {
+        return;
+    }
+    atomic_store(&worker->quit, true);
+    sem_post(&worker->pending);
+    pthread_join(worker->thread, NULL);
+
+    PrintDatabaseStats(worker->db);
+    CloseDatabase(worker->db);
+    sem_destroy(&worker->pending);
+    free(worker);
+}
+
+// Queue a job for the worker. Returns its id, or 0 if the queue is full,
+// in which case job->id is left 0 too.
+unsigned SubmitDbJob(DbWorker *worker, DbJob *job) {
+    job->id = worker->nextJobId;
+    if (!PushJob(&worker->submissions, job)) {
+        job->id = 0;
+        return 0;
+    }
+    worker->nextJobId++;
+    if (worker->nextJobId == 0) {
+        worker->nextJobId = 1;
+    }
+    sem_post(&worker->pending);
+    return job->id;
+}
+
+bool PollDbCompletion(DbWorker *worker, DbJob *job) {
+    return PopJob(&worker->completions, job);
+}
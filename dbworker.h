@@ -0,0 +1,98 @@
+#ifndef DBWORKER_H
+#define DBWORKER_H
+
+#include "db.h"
+#include "tasklist.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define DB_QUEUE_SIZE 256
+#define DB_JOB_TEXT_LEN 256
+
+// Account requests go through the AuthPool instead; the KDF would hold up
+// every task write queued behind it
+typedef enum {
+    JOB_ADD_TASK,
+    JOB_COMPLETE_TASK,
+    JOB_DELETE_TASK,
+    JOB_MOVE_TASK,
+    JOB_SET_DUE,
+    JOB_BULK_COMPLETE,
+    JOB_BULK_UNCOMPLETE,
+    JOB_BULK_DELETE,
+    JOB_APPLY_OPS
+} DbJobType;
+
+// One change from the undo journal. Op batches carry these in the order
+// they were made and run them as one transaction.
+typedef enum {
+    TASK_OP_ADD,
+    TASK_OP_COMPLETE,
+    TASK_OP_UNCOMPLETE,
+    TASK_OP_DELETE,
+    TASK_OP_RESTORE
+} TaskOpType;
+
+typedef struct {
+    long long seq;                   // Journal sequence number, from 1
+    TaskOpType type;
+    int taskId;                      // -seq of an add in the same batch until it has landed
+    double rank;                     // Restore: where the task was; add: filled in
+    bool completed;                  // Restore
+    long long dueAt;                 // Add and restore
+    int repeatEvery;
+    char *title;                     // Add and restore; owned by whoever holds the op
+    bool ok;                         // Filled in by the handler
+} TaskOp;
+
+typedef struct {
+    DbJobType type;
+    unsigned id;                     // Assigned by SubmitDbJob
+    int taskId;
+    int userId;
+    int afterId;                     // Move: the neighbours taskId goes between,
+    int beforeId;                    // 0 for either end of the list
+    char text[DB_JOB_TEXT_LEN];      // Task title
+    long long dueAt;                 // Add and set due: Unix seconds, 0 for none
+    int repeatEvery;                 // Seconds between occurrences, 0 for none
+    TaskSpan *spans;                 // Bulk jobs; owned by the submitter until completion
+    int spanCount;
+    TaskOp *ops;                     // Op batches; owned by the submitter until completion
+    int opCount;
+    long long appliedSeq;            // Op batches: recorded as applied in the same transaction, 0 for none
+    bool ok;                         // Filled in by the handler
+    long long rowId;                 // Inserted id, how many tasks a bulk job changed, or 1 if a move rebalanced
+    double rank;                     // Of the added or moved task
+} DbJob;
+
+// Single-producer single-consumer ring; one side only ever writes tail,
+// the other only ever writes head
+typedef struct {
+    DbJob slots[DB_QUEUE_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+} DbJobQueue;
+
+typedef void (*DbJobHandler)(Database *db, DbJob *job);
+
+// Owns the connection and runs every job on its own thread. The frame loop
+// submits jobs and drains finished ones with PollDbCompletion once per frame.
+typedef struct {
+    Database *db;
+    DbJobHandler handler;
+    pthread_t thread;
+    sem_t pending;
+    atomic_bool quit;
+    unsigned nextJobId;
+    DbJobQueue submissions;
+    DbJobQueue completions;
+} DbWorker;
+
+DbWorker *CreateDbWorker(const char *path, DbJobHandler handler);
+void DestroyDbWorker(DbWorker *worker);
+unsigned SubmitDbJob(DbWorker *worker, DbJob *job);
+bool PollDbCompletion(DbWorker *worker, DbJob *job);
+
+#endif
@@ -0,0 +1,93 @@
+#include "frame.h"
+#include "raylib.h"
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static double ProcessCpuSeconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static double WallSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Anything the last PollInputEvents picked up. GetKeyPressed drains raylib's
+// key queue, which nothing else reads; the char queue is left for text input.
+static bool HasInput(void) {
+    Vector2 delta = GetMouseDelta();
+    if (delta.x != 0 || delta.y != 0 || GetMouseWheelMove() != 0 || IsWindowResized()) {
+        return true;
+    }
+    for (int button = MOUSE_BUTTON_LEFT; button <= MOUSE_BUTTON_MIDDLE; button++) {
+        if (IsMouseButtonPressed(button) || IsMouseButtonReleased(button)) {
+            return true;
+        }
+    }
+    bool keyPressed = false;
+    while (GetKeyPressed() != 0) {
+        keyPressed = true;
+    }
+    return keyPressed;
+}
+
+void InitFrameScheduler(FrameScheduler *frames) {
+    *frames = (FrameScheduler){0};
+    frames->dirty = true;
+}
+
+bool ShouldDrawFrame(FrameScheduler *frames) {
+    bool input = HasInput();
+    if (!input && !frames->dirty && (frames->redrawAt == 0 || GetTime() < frames->redrawAt)) {
+        double cpuStart = ProcessCpuSeconds();
+        double wallStart = WallSeconds();
+        WaitTime(IDLE_POLL_SECONDS);
+        PollInputEvents();
+        frames->idleCpuSeconds += ProcessCpuSeconds() - cpuStart;
+        frames->idleWallSeconds += WallSeconds() - wallStart;
+
+        input = HasInput();
+        if (!input && (frames->redrawAt == 0 || GetTime() < frames->redrawAt)) {
+            frames->framesSkipped++;
+            return false;
+        }
+    }
+
+    // Input is handled while drawing, so give the resulting state change one
+    // more frame to show up
+    frames->dirty = input;
+    frames->redrawAt = 0;
+    frames->framesDrawn++;
+    return true;
+}
+
+void MarkFrameDirty(FrameScheduler *frames) {
+    frames->dirty = true;
+}
+
+// Ask for a frame after a delay, e.g. when a debounce timer will expire
+void RequestFrameIn(FrameScheduler *frames, double seconds) {
+    double at = GetTime() + seconds;
+    if (frames->redrawAt == 0 || at < frames->redrawAt) {
+        frames->redrawAt = at;
+    }
+}
+
+// Mark the scene dirty when a background producer's change counter moved
+void WatchFrameCounter(FrameScheduler *frames, unsigned *seen, unsigned current) {
+    if (*seen != current) {
+        *seen = current;
+        frames->dirty = true;
+    }
+}
+
+void PrintFrameStats(const FrameScheduler *frames) {
+    double idleCpu = frames->idleWallSeconds > 0 ? 100.0 * frames->idleCpuSeconds / frames->idleWallSeconds : 0;
+    printf("Frames: %ld drawn, %ld skipped; idle CPU %.2f%% over %.1f s\n",
+           frames->framesDrawn, frames->framesSkipped, idleCpu, frames->idleWallSeconds);
+}
@@ -0,0 +1,28 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+
+#define IDLE_POLL_SECONDS 0.05
+
+// Decides whether the next loop iteration needs to draw. A frame is drawn
+// when input arrives, when something marks the scene dirty (async results,
+// state changes) or when a requested timer comes due; otherwise the loop
+// just sleeps and polls input at IDLE_POLL_SECONDS.
+typedef struct {
+    bool dirty;
+    double redrawAt;        // Draw no later than this GetTime(); 0 for none
+    long framesDrawn;
+    long framesSkipped;
+    double idleCpuSeconds;  // Process CPU time spent while idle
+    double idleWallSeconds;
+} FrameScheduler;
+
+void InitFrameScheduler(FrameScheduler *frames);
+bool ShouldDrawFrame(FrameScheduler *frames);
+void MarkFrameDirty(FrameScheduler *frames);
+void RequestFrameIn(FrameScheduler *frames, double seconds);
+void WatchFrameCounter(FrameScheduler *frames, unsigned *seen, unsigned current);
+void PrintFrameStats(const FrameScheduler *frames);
+
+#endif
@@ -0,0 +1,360 @@
+#include "input.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_MAGIC "TMIR"
+#define INPUT_VERSION 1
+#define MOUSE_BUTTONS 3
+#define FIRST_KEY 32
+#define LAST_KEY 348
+
+// Per-frame record: a flags byte, the frame time, then only the fields the
+// flags say changed. Idle frames are never drawn, so never recorded.
+enum {
+    RECORD_MOUSE = 1,
+    RECORD_WHEEL = 2,
+    RECORD_BUTTONS = 4,
+    RECORD_MODIFIERS = 8,
+    RECORD_KEYS = 16,
+    RECORD_CHARS = 32,
+    RECORD_COMPLETIONS = 64
+};
+
+typedef enum {
+    INPUT_LIVE,
+    INPUT_RECORD,
+    INPUT_REPLAY
+} InputMode;
+
+typedef struct {
+    InputMode mode;
+    const char *path;
+    bool headless;
+    FILE *file;
+    bool finished;
+    double startTime;
+    unsigned completions;
+    InputFrame frame;
+    InputFrame previous;     // Last frame written or read, for delta encoding
+    InputFrame next;         // Replay lookahead
+    bool hasNext;
+} InputSource;
+
+static InputSource input = {0};
+
+static bool ReadFrame(FILE *file, InputFrame *frame, const InputFrame *previous);
+
+bool ParseInputOption(int argc, char **argv, int *index) {
+    const char *arg = argv[*index];
+    bool hasValue = *index + 1 < argc;
+    if (strcmp(arg, "--record") == 0 && hasValue) {
+        input.mode = INPUT_RECORD;
+        input.path = argv[++*index];
+    } else if (strcmp(arg, "--replay") == 0 && hasValue) {
+        input.mode = INPUT_REPLAY;
+        input.path = argv[++*index];
+    } else if (strcmp(arg, "--headless") == 0) {
+        input.headless = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Call before InitWindow. Mesa honours LIBGL_ALWAYS_SOFTWARE, so headless
+// replays render on llvmpipe and frame times don't depend on the host GPU.
+void PrepareInputWindow(void) {
+    if (input.mode == INPUT_REPLAY && input.headless) {
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+        SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    }
+}
+
+bool StartInput(void) {
+    input.startTime = GetTime();
+    if (input.mode == INPUT_LIVE) {
+        return true;
+    }
+
+    input.file = fopen(input.path, input.mode == INPUT_RECORD ? "wb" : "rb");
+    if (input.file == NULL) {
+        printf("Failed to open input file %s\n", input.path);
+        return false;
+    }
+    char magic[4];
+    uint16_t version = INPUT_VERSION;
+    if (input.mode == INPUT_RECORD) {
+        fwrite(INPUT_MAGIC, 1, 4, input.file);
+        fwrite(&version, sizeof(version), 1, input.file);
+        return true;
+    }
+    if (fread(magic, 1, 4, input.file) != 4 || memcmp(magic, INPUT_MAGIC, 4) != 0 ||
+        fread(&version, sizeof(version), 1, input.file) != 1 || version != INPUT_VERSION) {
+        printf("%s is not an input recording\n", input.path);
+        fclose(input.file);
+        input.file = NULL;
+        return false;
+    }
+    input.hasNext = ReadFrame(input.file, &input.next, &input.previous);
+    return true;
+}
+
+void StopInput(void) {
+    if (input.file != NULL) {
+        fclose(input.file);
+        input.file = NULL;
+    }
+}
+
+bool IsInputReplaying(void) {
+    return input.mode == INPUT_REPLAY;
+}
+
+bool IsInputReplayFinished(void) {
+    return input.finished;
+}
+
+void NoteInputCompletion(void) {
+    input.completions++;
+}
+
+bool CanApplyInputCompletion(void) {
+    return input.mode != INPUT_REPLAY || !input.hasNext || input.completions < input.next.completions;
+}
+
+bool IsInputFrameReady(void) {
+    return input.mode != INPUT_REPLAY || !input.hasNext || input.completions >= input.next.completions;
+}
+
+static void CaptureLiveFrame(InputFrame *frame) {
+    memset(frame, 0, sizeof(*frame));
+    frame->timeMs = (unsigned)((GetTime() - input.startTime) * 1000.0);
+    frame->completions = input.completions;
+    frame->mouseX = GetMouseX();
+    frame->mouseY = GetMouseY();
+    frame->wheel = GetMouseWheelMove();
+    for (int button = 0; button < MOUSE_BUTTONS; button++) {
+        if (IsMouseButtonDown(button)) frame->buttonsDown |= 1 << button;
+        if (IsMouseButtonPressed(button)) frame->buttonsPressed |= 1 << button;
+        if (IsMouseButtonReleased(button)) frame->buttonsReleased |= 1 << button;
+    }
+    if (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) frame->modifiers |= INPUT_SHIFT;
+    if (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) frame->modifiers |= INPUT_CONTROL;
+    if (IsKeyDown(KEY_LEFT_ALT) || IsKeyDown(KEY_RIGHT_ALT)) frame->modifiers |= INPUT_ALT;
+
+    // Scanned rather than drained from GetKeyPressed, which the frame
+    // scheduler already empties
+    for (int key = FIRST_KEY; key <= LAST_KEY && frame->keyCount < INPUT_MAX_KEYS; key++) {
+        if (IsKeyPressed(key)) {
+            frame->keys[frame->keyCount++] = key;
+        }
+    }
+    int c;
+    while (frame->charCount < INPUT_MAX_CHARS && (c = GetCharPressed()) > 0) {
+        frame->chars[frame->charCount++] = c;
+    }
+}
+
+static void WriteFrame(FILE *file, const InputFrame *frame, const InputFrame *previous) {
+    uint8_t flags = 0;
+    if (frame->mouseX != previous->mouseX || frame->mouseY != previous->mouseY) flags |= RECORD_MOUSE;
+    if (frame->wheel != 0) flags |= RECORD_WHEEL;
+    if (frame->buttonsDown != previous->buttonsDown || frame->buttonsPressed || frame->buttonsReleased) flags |= RECORD_BUTTONS;
+    if (frame->modifiers != previous->modifiers) flags |= RECORD_MODIFIERS;
+    if (frame->keyCount > 0) flags |= RECORD_KEYS;
+    if (frame->charCount > 0) flags |= RECORD_CHARS;
+    if (frame->completions != previous->completions) flags |= RECORD_COMPLETIONS;
+
+    uint32_t timeMs = frame->timeMs;
+    fwrite(&flags, 1, 1, file);
+    fwrite(&timeMs, sizeof(timeMs), 1, file);
+    if (flags & RECORD_MOUSE) {
+        int16_t position[2] = {(int16_t)frame->mouseX, (int16_t)frame->mouseY};
+        fwrite(position, sizeof(position), 1, file);
+    }
+    if (flags & RECORD_WHEEL) {
+        fwrite(&frame->wheel, sizeof(float), 1, file);
+    }
+    if (flags & RECORD_BUTTONS) {
+        uint8_t buttons[3] = {frame->buttonsDown, frame->buttonsPressed, frame->buttonsReleased};
+        fwrite(buttons, sizeof(buttons), 1, file);
+    }
+    if (flags & RECORD_MODIFIERS) {
+        fwrite(&frame->modifiers, 1, 1, file);
+    }
+    if (flags & RECORD_KEYS) {
+        uint8_t count = (uint8_t)frame->keyCount;
+        fwrite(&count, 1, 1, file);
+        for (int i = 0; i < frame->keyCount; i++) {
+            uint16_t key = (uint16_t)frame->keys[i];
+            fwrite(&key, sizeof(key), 1, file);
+        }
+    }
+    if (flags & RECORD_CHARS) {
+        uint8_t count = (uint8_t)frame->charCount;
+        fwrite(&count, 1, 1, file);
+        for (int i = 0; i < frame->charCount; i++) {
+            uint32_t c = (uint32_t)frame->chars[i];
+            fwrite(&c, sizeof(c), 1, file);
+        }
+    }
+    if (flags & RECORD_COMPLETIONS) {
+        uint32_t completions = frame->completions;
+        fwrite(&completions, sizeof(completions), 1, file);
+    }
+}
+
+// Fields a record leaves out keep their previous value, except the
+// per-frame events, which are cleared
+static bool ReadFrame(FILE *file, InputFrame *frame, const InputFrame *previous) {
+    uint8_t flags;
+    uint32_t timeMs;
+    if (fread(&flags, 1, 1, file) != 1 || fread(&timeMs, sizeof(timeMs), 1, file) != 1) {
+        return false;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    frame->timeMs = timeMs;
+    frame->mouseX = previous->mouseX;
+    frame->mouseY = previous->mouseY;
+    frame->buttonsDown = previous->buttonsDown;
+    frame->modifiers = previous->modifiers;
+    frame->completions = previous->completions;
+
+    bool ok = true;
+    if (flags & RECORD_MOUSE) {
+        int16_t position[2];
+        ok = ok && fread(position, sizeof(position), 1, file) == 1;
+        frame->mouseX = position[0];
+        frame->mouseY = position[1];
+    }
+    if (flags & RECORD_WHEEL) {
+        ok = ok && fread(&frame->wheel, sizeof(float), 1, file) == 1;
+    }
+    if (flags & RECORD_BUTTONS) {
+        uint8_t buttons[3];
+        ok = ok && fread(buttons, sizeof(buttons), 1, file) == 1;
+        frame->buttonsDown = buttons[0];
+        frame->buttonsPressed = buttons[1];
+        frame->buttonsReleased = buttons[2];
+    }
+    if (flags & RECORD_MODIFIERS) {
+        ok = ok && fread(&frame->modifiers, 1, 1, file) == 1;
+    }
+    if (flags & RECORD_KEYS) {
+        uint8_t count = 0;
+        ok = ok && fread(&count, 1, 1, file) == 1 && count <= INPUT_MAX_KEYS;
+        for (int i = 0; ok && i < count; i++) {
+            uint16_t key;
+            ok = fread(&key, sizeof(key), 1, file) == 1;
+            frame->keys[frame->keyCount++] = key;
+        }
+    }
+    if (flags & RECORD_CHARS) {
+        uint8_t count = 0;
+        ok = ok && fread(&count, 1, 1, file) == 1 && count <= INPUT_MAX_CHARS;
+        for (int i = 0; ok && i < count; i++) {
+            uint32_t c;
+            ok = fread(&c, sizeof(c), 1, file) == 1;
+            frame->chars[frame->charCount++] = (int)c;
+        }
+    }
+    if (flags & RECORD_COMPLETIONS) {
+        uint32_t completions;
+        ok = ok && fread(&completions, sizeof(completions), 1, file) == 1;
+        frame->completions = completions;
+    }
+    return ok;
+}
+
+void PollInputFrame(void) {
+    if (input.mode != INPUT_REPLAY) {
+        CaptureLiveFrame(&input.frame);
+        if (input.mode == INPUT_RECORD && input.file != NULL) {
+            WriteFrame(input.file, &input.frame, &input.previous);
+            input.previous = input.frame;
+        }
+        return;
+    }
+
+    if (!input.hasNext) {
+        // Past the end the replay just stops producing input
+        memset(&input.frame, 0, sizeof(input.frame));
+        input.frame.mouseX = input.previous.mouseX;
+        input.frame.mouseY = input.previous.mouseY;
+        input.frame.timeMs = input.previous.timeMs;
+        input.finished = true;
+        return;
+    }
+    input.frame = input.next;
+    input.previous = input.frame;
+    input.hasNext = ReadFrame(input.file, &input.next, &input.previous);
+}
+
+int InputMouseX(void) {
+    return input.frame.mouseX;
+}
+
+int InputMouseY(void) {
+    return input.frame.mouseY;
+}
+
+Vector2 InputMousePosition(void) {
+    return (Vector2){(float)input.frame.mouseX, (float)input.frame.mouseY};
+}
+
+bool InputMousePressed(int button) {
+    return button >= 0 && button < MOUSE_BUTTONS && (input.frame.buttonsPressed & (1 << button));
+}
+
+bool InputMouseDown(int button) {
+    return button >= 0 && button < MOUSE_BUTTONS && (input.frame.buttonsDown & (1 << button));
+}
+
+bool InputMouseReleased(int button) {
+    return button >= 0 && button < MOUSE_BUTTONS && (input.frame.buttonsReleased & (1 << button));
+}
+
+float InputMouseWheel(void) {
+    return input.frame.wheel;
+}
+
+bool InputKeyPressed(int key) {
+    for (int i = 0; i < input.frame.keyCount; i++) {
+        if (input.frame.keys[i] == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InputKeyDown(int key) {
+    switch (key) {
+        case KEY_LEFT_SHIFT:
+        case KEY_RIGHT_SHIFT:
+            return input.frame.modifiers & INPUT_SHIFT;
+        case KEY_LEFT_CONTROL:
+        case KEY_RIGHT_CONTROL:
+            return input.frame.modifiers & INPUT_CONTROL;
+        case KEY_LEFT_ALT:
+        case KEY_RIGHT_ALT:
+            return input.frame.modifiers & INPUT_ALT;
+        default:
+            return false;
+    }
+}
+
+// Next character typed this frame, or 0, like GetCharPressed
+int InputCharPressed(void) {
+    if (input.frame.nextChar >= input.frame.charCount) {
+        return 0;
+    }
+    return input.frame.chars[input.frame.nextChar++];
+}
+
+// Session time the current frame was latched at; recorded time while replaying
+double InputTime(void) {
+    return input.frame.timeMs / 1000.0;
+}
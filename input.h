@@ -0,0 +1,69 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "raylib.h"
+#include <stdbool.h>
+
+#define INPUT_MAX_KEYS 16    // Keys pressed in one frame
+#define INPUT_MAX_CHARS 32   // Characters typed in one frame
+
+// Everything the UI reads from the mouse and keyboard during one drawn frame.
+// Programs read input only through the Input* calls below, which serve the
+// latched frame; that frame comes from raylib (optionally recorded to a file)
+// or from a recording being replayed.
+typedef struct {
+    unsigned timeMs;         // Since the session started
+    unsigned completions;    // Async results applied before this frame
+    int mouseX;
+    int mouseY;
+    float wheel;
+    unsigned char buttonsDown;     // Bit per mouse button
+    unsigned char buttonsPressed;
+    unsigned char buttonsReleased;
+    unsigned char modifiers;       // INPUT_SHIFT | INPUT_CONTROL | INPUT_ALT
+    int keys[INPUT_MAX_KEYS];      // Pressed this frame
+    int keyCount;
+    int chars[INPUT_MAX_CHARS];    // Typed this frame, in order
+    int charCount;
+    int nextChar;                  // Read position for InputCharPressed
+} InputFrame;
+
+#define INPUT_SHIFT 1
+#define INPUT_CONTROL 2
+#define INPUT_ALT 4
+
+// Command-line options shared by the windowed programs:
+//     --record FILE   save this session's input
+//     --replay FILE   drive the session from a recording instead of the user
+//     --headless      with --replay: hidden window on the software GL renderer
+bool ParseInputOption(int argc, char **argv, int *index);
+void PrepareInputWindow(void);
+bool StartInput(void);
+void StopInput(void);
+bool IsInputReplaying(void);
+bool IsInputReplayFinished(void);
+
+// Async results (e.g. DB worker completions) change what a click lands on, so
+// recordings note how many had been applied before each frame, and a replay
+// applies exactly that many before each frame: it holds further results back
+// and holds the frame back until they have arrived
+void NoteInputCompletion(void);
+bool CanApplyInputCompletion(void);
+bool IsInputFrameReady(void);
+
+// Latch the next frame's input; call once per drawn frame before reading it
+void PollInputFrame(void);
+
+int InputMouseX(void);
+int InputMouseY(void);
+Vector2 InputMousePosition(void);
+bool InputMousePressed(int button);
+bool InputMouseDown(int button);
+bool InputMouseReleased(int button);
+float InputMouseWheel(void);
+bool InputKeyPressed(int key);
+bool InputKeyDown(int key);  // Shift, Control and Alt only
+int InputCharPressed(void);
+double InputTime(void);
+
+#endif
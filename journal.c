@@ -0,0 +1,504 @@
+#include "journal.h"
+#include "storage.h"
+#include "taskcore.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_HEADER_LEN 128 // Longest record header, up to the title
+#define LOG_TRAILER_LEN 10 // " %08x\n"
+
+static char *CopyText(const char *text) {
+    size_t size = strlen(text) + 1;
+    char *copy = malloc(size);
+    if (copy != NULL) {
+        memcpy(copy, text, size);
+    }
+    return copy;
+}
+
+// to becomes from with a title of its own
+static bool CopyOp(TaskOp *to, const TaskOp *from) {
+    *to = *from;
+    if (from->title == NULL) {
+        return true;
+    }
+    to->title = CopyText(from->title);
+    return to->title != NULL;
+}
+
+static void FreeOps(TaskOp *ops, int count) {
+    for (int i = 0; i < count; i++) {
+        free(ops[i].title);
+    }
+}
+
+// FNV-1a, enough to tell a whole record from one a crash cut short
+static unsigned HashRecord(const char *data, size_t size) {
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// A record is the op's fields as text, the title's length and bytes, and
+// the checksum of everything before it, written with one write()
+static void AppendLogRecord(TaskJournal *journal, const TaskOp *op) {
+    if (journal->logFd < 0) {
+        return;
+    }
+    const char *title = op->title != NULL ? op->title : "";
+    size_t titleLength = strlen(title);
+    char header[LOG_HEADER_LEN];
+    int headerLength = snprintf(header, sizeof(header), "%lld %d %d %.17g %d %lld %d %zu:", op->seq, (int)op->type,
+                                op->taskId, op->rank, op->completed, op->dueAt, op->repeatEvery, titleLength);
+    size_t bodyLength = (size_t)headerLength + titleLength;
+    char *record = malloc(bodyLength + LOG_TRAILER_LEN + 1);
+    if (record == NULL) {
+        printf("Failed to log a change to %s\n", journal->logPath);
+        return;
+    }
+    memcpy(record, header, (size_t)headerLength);
+    memcpy(record + headerLength, title, titleLength);
+    snprintf(record + bodyLength, LOG_TRAILER_LEN + 1, " %08x\n", HashRecord(record, bodyLength));
+
+    size_t size = bodyLength + LOG_TRAILER_LEN;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = write(journal->logFd, record + written, size - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += (size_t)n;
+    }
+    if (written < size || (journal->durable && fdatasync(journal->logFd) != 0)) {
+        printf("Failed to log a change to %s: %s\n", journal->logPath, strerror(errno));
+    }
+    free(record);
+}
+
+static void TruncateLog(TaskJournal *journal) {
+    if (journal->logFd >= 0 && ftruncate(journal->logFd, 0) != 0) {
+        printf("Failed to empty %s: %s\n", journal->logPath, strerror(errno));
+    }
+}
+
+// Every whole record in the log, in order, each op with a title of its own.
+// Reading stops at the first record that doesn't check out, which is the
+// tail of an append a crash cut short. -1 if the log couldn't be read.
+static int ReadLog(TaskJournal *journal, TaskOp **ops) {
+    *ops = NULL;
+    struct stat info;
+    if (fstat(journal->logFd, &info) != 0) {
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    char *data = malloc(size + 1);
+    if (data == NULL) {
+        return -1;
+    }
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = pread(journal->logFd, data + got, size - got, (off_t)got);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+
+    int count = 0;
+    int capacity = 0;
+    size_t offset = 0;
+    while (offset < got) {
+        // Parsed from a bounded copy, since sscanf would measure the whole log
+        char header[LOG_HEADER_LEN];
+        size_t headerBytes = got - offset < sizeof(header) - 1 ? got - offset : sizeof(header) - 1;
+        memcpy(header, data + offset, headerBytes);
+        header[headerBytes] = '\0';
+
+        TaskOp op = {0};
+        int type;
+        int completed;
+        size_t titleLength;
+        int headerLength = 0;
+        if (sscanf(header, "%lld %d %d %lf %d %lld %d %zu:%n", &op.seq, &type, &op.taskId, &op.rank, &completed,
+                   &op.dueAt, &op.repeatEvery, &titleLength, &headerLength) != 8 ||
+            headerLength == 0 || type < TASK_OP_ADD || type > TASK_OP_RESTORE || titleLength > got) {
+            break;
+        }
+        size_t bodyLength = (size_t)headerLength + titleLength;
+        if (got - offset < bodyLength + LOG_TRAILER_LEN) {
+            break;
+        }
+        char trailer[LOG_TRAILER_LEN + 1];
+        memcpy(trailer, data + offset + bodyLength, LOG_TRAILER_LEN);
+        trailer[LOG_TRAILER_LEN] = '\0';
+        unsigned checksum;
+        if (sscanf(trailer, " %8x", &checksum) != 1 || trailer[LOG_TRAILER_LEN - 1] != '\n' ||
+            checksum != HashRecord(data + offset, bodyLength)) {
+            break;
+        }
+
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            TaskOp *grown = realloc(*ops, capacity * sizeof(TaskOp));
+            if (grown == NULL) {
+                break;
+            }
+            *ops = grown;
+        }
+        op.type = (TaskOpType)type;
+        op.completed = completed != 0;
+        op.title = malloc(titleLength + 1);
+        if (op.title == NULL) {
+            break;
+        }
+        memcpy(op.title, data + offset + headerLength, titleLength);
+        op.title[titleLength] = '\0';
+        (*ops)[count++] = op;
+        offset += bodyLength + LOG_TRAILER_LEN;
+    }
+    if (offset < got) {
+        printf("Ignoring the last %zu bytes of %s, cut short\n", got - offset, journal->logPath);
+    }
+    free(data);
+    return count;
+}
+
+// Replays every logged op the database hasn't applied as one batch, then
+// empties the log. Later seqs continue from the highest one seen.
+static bool RecoverLog(TaskJournal *journal, long long applied, Database *db) {
+    TaskOp *ops;
+    int count = ReadLog(journal, &ops);
+    if (count < 0) {
+        printf("Failed to read %s: %s\n", journal->logPath, strerror(errno));
+        return false;
+    }
+    int tail = 0;
+    for (int i = 0; i < count; i++) {
+        if (ops[i].seq >= journal->nextSeq) {
+            journal->nextSeq = ops[i].seq + 1;
+        }
+        if (ops[i].seq > applied) {
+            TaskOp op = ops[i];
+            ops[i] = ops[tail];
+            ops[tail++] = op;
+        }
+    }
+    bool recovered = tail == 0 || ApplyTaskOps(journal->userId, ops, tail, journal->nextSeq - 1, db);
+    if (recovered && tail > 0) {
+        printf("Recovered %d unsaved change(s) from %s\n", tail, journal->logPath);
+        journal->stats.recovered = tail;
+    }
+    if (recovered) {
+        TruncateLog(journal);
+    }
+    FreeOps(ops, count);
+    free(ops);
+    return recovered;
+}
+
+TaskJournal *OpenTaskJournal(const char *dbPath, int userId, Database *db) {
+    TaskJournal *journal = calloc(1, sizeof(TaskJournal));
+    if (journal == NULL) {
+        return NULL;
+    }
+    journal->userId = userId;
+    journal->logFd = -1;
+    journal->durable = GetStorageConfig()->synchronous >= 2;
+    size_t pathSize = strlen(dbPath) + sizeof(JOURNAL_LOG_SUFFIX) + 16;
+    journal->logPath = malloc(pathSize);
+    long long applied = ReadAppliedJournalSeq(userId, db);
+    if (journal->logPath == NULL || applied < 0) {
+        CloseTaskJournal(journal);
+        return NULL;
+    }
+    snprintf(journal->logPath, pathSize, "%s" JOURNAL_LOG_SUFFIX "-%d", dbPath, userId);
+    journal->nextSeq = applied + 1;
+
+    int fd = open(journal->logPath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        printf("Failed to open %s: %s; unsaved changes won't survive a crash\n", journal->logPath, strerror(errno));
+        return journal;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        printf("%s is in use by another instance; unsaved changes won't survive a crash\n", journal->logPath);
+        close(fd);
+        return journal;
+    }
+    journal->logFd = fd;
+    if (!RecoverLog(journal, applied, db)) {
+        CloseTaskJournal(journal);
+        return NULL;
+    }
+    return journal;
+}
+
+void CloseTaskJournal(TaskJournal *journal) {
+    if (journal == NULL) {
+        return;
+    }
+    if (journal->logFd >= 0) {
+        close(journal->logFd);
+    }
+    FreeOps(journal->queue, journal->queued);
+    FreeOps(journal->flight, journal->flying);
+    FreeOps(journal->undo, journal->undoCount);
+    FreeOps(journal->redo, journal->redoCount);
+    free(journal->logPath);
+    free(journal);
+}
+
+// Logs op and queues it under the next seq; an add names itself -seq until
+// it lands. Returns the seq, or 0 if the queue is full.
+static long long QueueOp(TaskJournal *journal, TaskOp op, double now) {
+    if (journal->queued + journal->flying >= JOURNAL_QUEUE_MAX) {
+        return 0;
+    }
+    op.seq = journal->nextSeq;
+    if (op.type == TASK_OP_ADD) {
+        op.taskId = -(int)op.seq;
+    }
+    TaskOp *slot = &journal->queue[journal->queued];
+    if (!CopyOp(slot, &op)) {
+        return 0;
+    }
+    AppendLogRecord(journal, slot);
+    if (journal->queued == 0) {
+        journal->queuedAt = now;
+    }
+    journal->queued++;
+    journal->nextSeq++;
+    return op.seq;
+}
+
+// Whether op names a new task whose add is in the batch in flight. Its id
+// isn't known until that lands, and the next batch couldn't look it up.
+static bool WaitsOnFlight(const TaskJournal *journal, const TaskOp *op) {
+    for (int i = 0; op->taskId < 0 && i < journal->flying; i++) {
+        if (journal->flight[i].type == TASK_OP_ADD && journal->flight[i].seq == -(long long)op->taskId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Takes over entry; the oldest entry drops off a full stack
+static void PushEntry(TaskOp *stack, int *count, const TaskOp *entry) {
+    if (*count == JOURNAL_UNDO_DEPTH) {
+        free(stack[0].title);
+        memmove(stack, stack + 1, (JOURNAL_UNDO_DEPTH - 1) * sizeof(TaskOp));
+        (*count)--;
+    }
+    stack[(*count)++] = *entry;
+}
+
+// Queues a change made in the UI and remembers it for undo; whatever was
+// undone before it can't be redone any more
+static bool RecordChange(TaskJournal *journal, const TaskOp *op, double now) {
+    if (journal->held) {
+        return false;
+    }
+    TaskOp entry;
+    if (!CopyOp(&entry, op)) {
+        return false;
+    }
+    long long seq = QueueOp(journal, *op, now);
+    if (seq == 0) {
+        free(entry.title);
+        return false;
+    }
+    entry.seq = seq;
+    if (entry.type == TASK_OP_ADD) {
+        entry.taskId = -(int)seq;
+    }
+    FreeOps(journal->redo, journal->redoCount);
+    journal->redoCount = 0;
+    PushEntry(journal->undo, &journal->undoCount, &entry);
+    journal->stats.changes++;
+    return true;
+}
+
+bool RecordTaskAdded(TaskJournal *journal, const char *title, long long dueAt, int repeatEvery, double now) {
+    TaskOp op = {.type = TASK_OP_ADD, .title = (char *)title, .dueAt = dueAt, .repeatEvery = dueAt > 0 ? repeatEvery : 0};
+    return RecordChange(journal, &op, now);
+}
+
+bool RecordTaskCompleted(TaskJournal *journal, const Task *task, double now) {
+    if (task->completed) {
+        return false;
+    }
+    TaskOp op = {.type = TASK_OP_COMPLETE, .taskId = task->id};
+    return RecordChange(journal, &op, now);
+}
+
+// Everything it takes to put the task back goes with the delete
+bool RecordTaskDeleted(TaskJournal *journal, const Task *task, double now) {
+    TaskOp op = {.type = TASK_OP_DELETE, .taskId = task->id, .rank = task->rank, .completed = task->completed,
+                 .dueAt = task->dueAt, .repeatEvery = task->repeatEvery, .title = (char *)task->title};
+    return RecordChange(journal, &op, now);
+}
+
+bool UndoTaskChange(TaskJournal *journal, double now) {
+    if (journal->undoCount == 0 || journal->held) {
+        return false;
+    }
+    TaskOp *entry = &journal->undo[journal->undoCount - 1];
+    TaskOp inverse = *entry;
+    switch (entry->type) {
+        case TASK_OP_ADD:
+        case TASK_OP_RESTORE:
+            inverse.type = TASK_OP_DELETE;
+            break;
+        case TASK_OP_DELETE:
+            inverse.type = TASK_OP_RESTORE;
+            break;
+        case TASK_OP_COMPLETE:
+            inverse.type = TASK_OP_UNCOMPLETE;
+            break;
+        case TASK_OP_UNCOMPLETE:
+            inverse.type = TASK_OP_COMPLETE;
+            break;
+    }
+    if (WaitsOnFlight(journal, &inverse) || QueueOp(journal, inverse, now) == 0) {
+        return false;
+    }
+    PushEntry(journal->redo, &journal->redoCount, entry);
+    journal->undoCount--;
+    journal->stats.undos++;
+    return true;
+}
+
+// Redoing an add puts the same task back once it has an id; one undone
+// before its batch ran is simply added again
+bool RedoTaskChange(TaskJournal *journal, double now) {
+    if (journal->redoCount == 0 || journal->held) {
+        return false;
+    }
+    TaskOp *entry = &journal->redo[journal->redoCount - 1];
+    TaskOp op = *entry;
+    if (op.type == TASK_OP_ADD && op.taskId > 0) {
+        op.type = TASK_OP_RESTORE;
+    }
+    if (WaitsOnFlight(journal, &op)) {
+        return false;
+    }
+    long long seq = QueueOp(journal, op, now);
+    if (seq == 0) {
+        return false;
+    }
+    if (op.type == TASK_OP_ADD) {
+        entry->seq = seq;
+        entry->taskId = -(int)seq;
+    }
+    PushEntry(journal->undo, &journal->undoCount, entry);
+    journal->redoCount--;
+    journal->stats.redos++;
+    return true;
+}
+
+bool TakeJournalBatch(TaskJournal *journal, double now, bool force, DbJob *job) {
+    if (journal->flying > 0 || journal->queued == 0 || (!force && now - journal->queuedAt < JOURNAL_FLUSH_SECONDS)) {
+        return false;
+    }
+    // Titles stay the journal's; they're freed once the batch completes
+    TaskOp *ops = malloc(journal->queued * sizeof(TaskOp));
+    if (ops == NULL) {
+        return false;
+    }
+    memcpy(ops, journal->queue, journal->queued * sizeof(TaskOp));
+    memcpy(journal->flight, journal->queue, journal->queued * sizeof(TaskOp));
+    journal->flying = journal->queued;
+    journal->queued = 0;
+
+    *job = (DbJob){.type = JOB_APPLY_OPS, .userId = journal->userId, .ops = ops, .opCount = journal->flying};
+    // Without a log there is nothing to replay, and the seq could be
+    // another instance's
+    if (journal->logFd >= 0) {
+        job->appliedSeq = journal->flight[journal->flying - 1].seq;
+    }
+    return true;
+}
+
+// The id a task landed under replaces the one the entries knew it by: -seq
+// for an add, the old id for a restore that had to take a new one
+static void PatchTaskId(TaskOp *stack, int count, int wasId, const TaskOp *landed) {
+    for (int i = 0; i < count; i++) {
+        if (stack[i].taskId == wasId) {
+            stack[i].taskId = landed->taskId;
+            stack[i].rank = landed->rank;
+        }
+    }
+}
+
+void FinishJournalBatch(TaskJournal *journal, const DbJob *job, double now) {
+    if (!job->ok) {
+        // Back in front of anything queued since, to go again after the delay
+        memmove(journal->queue + journal->flying, journal->queue, journal->queued * sizeof(TaskOp));
+        memcpy(journal->queue, journal->flight, journal->flying * sizeof(TaskOp));
+        journal->queued += journal->flying;
+        journal->queuedAt = now;
+        journal->flying = 0;
+        journal->stats.failedBatches++;
+        return;
+    }
+    for (int i = 0; i < job->opCount; i++) {
+        const TaskOp *op = &job->ops[i];
+        int wasId = journal->flight[i].taskId;
+        if (op->ok && (op->type == TASK_OP_ADD || op->type == TASK_OP_RESTORE) && op->taskId != wasId) {
+            PatchTaskId(journal->undo, journal->undoCount, wasId, op);
+            PatchTaskId(journal->redo, journal->redoCount, wasId, op);
+        }
+    }
+    FreeOps(journal->flight, journal->flying);
+    journal->flying = 0;
+    journal->stats.batches++;
+    if (journal->queued == 0) {
+        TruncateLog(journal);
+    }
+}
+
+double GetJournalFlushDelay(const TaskJournal *journal, double now) {
+    // A batch in flight marks the frame dirty when it completes
+    if (journal->queued == 0 || journal->flying > 0) {
+        return -1;
+    }
+    double delay = journal->queuedAt + JOURNAL_FLUSH_SECONDS - now;
+    return delay > 0 ? delay : 0;
+}
+
+const TaskOp *FindJournalOp(const TaskJournal *journal, int taskId) {
+    for (int i = journal->queued - 1; i >= 0; i--) {
+        if (journal->queue[i].taskId == taskId) {
+            return &journal->queue[i];
+        }
+    }
+    for (int i = journal->flying - 1; i >= 0; i--) {
+        if (journal->flight[i].taskId == taskId) {
+            return &journal->flight[i];
+        }
+    }
+    return NULL;
+}
+
+int CountJournalOps(const TaskJournal *journal) {
+    return journal->queued + journal->flying;
+}
+
+void PrintTaskJournalStats(const TaskJournal *journal) {
+    printf("Journal: %ld changes, %ld undone, %ld redone, %ld batches, %ld failed, %ld recovered\n",
+           journal->stats.changes, journal->stats.undos, journal->stats.redos, journal->stats.batches,
+           journal->stats.failedBatches, journal->stats.recovered);
+}
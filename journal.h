@@ -0,0 +1,100 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "db.h"
+#include "dbworker.h"
+#include "tasklist.h"
+#include <stdbool.h>
+
+#define JOURNAL_FLUSH_SECONDS 0.25 // A change waits this long for others to share its batch
+#define JOURNAL_QUEUE_MAX 256      // Changes queued or in flight at once
+#define JOURNAL_UNDO_DEPTH 100
+#define JOURNAL_LOG_SUFFIX ".oplog"
+
+typedef struct {
+    long changes;
+    long undos;
+    long redos;
+    long batches;
+    long failedBatches;    // Rolled back and queued again
+    long recovered;        // Replayed from the log at open
+} JournalStats;
+
+// Adds, completes and deletes made in the UI, with undo and redo. Each
+// change is queued in memory and written behind: once the oldest has waited
+// JOURNAL_FLUSH_SECONDS, or on exit, everything queued goes to the worker as
+// one JOB_APPLY_OPS batch, one transaction. Only one batch is in flight at a
+// time.
+//
+// Every queued change is also appended to a log file next to the database
+// (e.g. users.db.oplog-3 for user 3) before it is acknowledged. Batches record
+// the last seq they apply in journal_applied in the same transaction, so
+// opening the journal replays exactly the logged changes that never landed.
+// The log is emptied whenever nothing is queued or in flight. A second
+// instance for the same user finds it locked and runs without one.
+//
+// Undo queues the inverse of the last change: a delete is undone by putting
+// the task back with its id, place and state; an add by deleting it again,
+// and redoing that puts the same task back. New tasks have no id until
+// their batch lands, so changes to them are held off until it has.
+//
+// Changes the journal doesn't carry (moves, due dates, bulk changes) go to
+// the worker once it is empty. Until they have, the caller sets held and
+// new changes are refused, so none can overtake them.
+typedef struct {
+    int userId;
+    char *logPath;
+    int logFd;             // -1 when running without a log
+    bool durable;          // fdatasync every append (synchronous = FULL)
+    long long nextSeq;
+
+    TaskOp queue[JOURNAL_QUEUE_MAX];
+    int queued;
+    double queuedAt;       // When the oldest queued change was made
+    TaskOp flight[JOURNAL_QUEUE_MAX];
+    int flying;
+    bool held;             // A change made outside the journal waits for it to empty
+
+    // Changes as made, latest last; each entry owns its title
+    TaskOp undo[JOURNAL_UNDO_DEPTH];
+    int undoCount;
+    TaskOp redo[JOURNAL_UNDO_DEPTH];
+    int redoCount;
+    JournalStats stats;
+} TaskJournal;
+
+// Opens the log for userId and replays its unapplied tail through db in one
+// transaction. NULL if that failed; the log is left for the next try.
+TaskJournal *OpenTaskJournal(const char *dbPath, int userId, Database *db);
+// Call once nothing is queued or in flight, or whatever is left stays in the
+// log for the next open
+void CloseTaskJournal(TaskJournal *journal);
+
+// Each returns false, changing nothing, when it isn't recorded: the queue
+// is full, there is nothing to undo or redo, the change waits on a batch
+// in flight, or the journal is held. now is in seconds on the caller's
+// clock.
+bool RecordTaskAdded(TaskJournal *journal, const char *title, long long dueAt, int repeatEvery, double now);
+// task as drawn; a task that is already complete is left alone
+bool RecordTaskCompleted(TaskJournal *journal, const Task *task, double now);
+bool RecordTaskDeleted(TaskJournal *journal, const Task *task, double now);
+bool UndoTaskChange(TaskJournal *journal, double now);
+bool RedoTaskChange(TaskJournal *journal, double now);
+
+// The next batch, once one is due (or anything is queued, with force) and
+// none is in flight. The job gets its own copy of the ops array, freed by
+// the submitter after FinishJournalBatch. If it can't be submitted, pass it
+// back to FinishJournalBatch with ok false.
+bool TakeJournalBatch(TaskJournal *journal, double now, bool force, DbJob *job);
+// A batch's completion: patches ids new tasks got into the undo history and
+// empties the log, or queues the batch again if it failed
+void FinishJournalBatch(TaskJournal *journal, const DbJob *job, double now);
+// Seconds until the next batch is due, or -1 if nothing is queued
+double GetJournalFlushDelay(const TaskJournal *journal, double now);
+
+// The latest queued or in-flight op on taskId, for drawing it as landed
+const TaskOp *FindJournalOp(const TaskJournal *journal, int taskId);
+int CountJournalOps(const TaskJournal *journal);
+void PrintTaskJournalStats(const TaskJournal *journal);
+
+#endif
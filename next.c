@@ -1,10 +1,16 @@
 #include "raylib.h"
+#include "db.h"
+#include "authpool.h"
+#include "frame.h"
+#include "input.h"
+#include "storage.h"
+#include "taskcore.h"
+#include <math.h>
 #include <string.h>
-#include <sqlite3.h>
 #include <stdio.h>
-#include <openssl/sha.h>
 
 #define MAX_INPUT_LEN 256
+#define SPINNER_FRAME_SECONDS (1.0 / 30.0)
 
 typedef enum {
     SCREEN_REGISTRATION,
@@ -19,49 +25,91 @@ typedef struct {
     bool passwordFocused;
 } UserData;
 
+// Screen state that auth pool results are reported into
+typedef struct {
+    unsigned pendingId; // Register/login request still on the pool, or 0
+    ScreenState currentScreen;
+    char loggedInUsername[MAX_INPUT_LEN];
+    bool showPopup;
+    char popupMessage[256];
+    Color popupColor;
+    FrameScheduler *frames;
+} AuthScreen;
+
 void DrawTextInput(int x, int y, int width, int height, char *buffer, bool focused, const char *placeholder);
 void ShowPopup(const char *message, Color bgColor);
-bool RegisterUser(const char *username, const char *password, sqlite3 *db);
-bool LoginUser(const char *username, const char *password, sqlite3 *db);
-void HashPassword(const char *password, char *hashedPassword);
+void DrawSpinner(int x, int y, double time);
+void OnAuthResult(const AuthRequest *result, void *context);
 void DrawDashboard(const char *username);
 
-int main(void) {
-    InitWindow(800, 600, "Task Manager");
-    SetTargetFPS(60);
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (!ParseInputOption(argc, argv, &i)) {
+            printf("usage: %s [--record FILE | --replay FILE [--headless]]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    sqlite3 *db;
-    if (sqlite3_open("users.db", &db)) {
-        printf("Failed to open database: %s\n", sqlite3_errmsg(db));
+    PrepareInputWindow();
+    InitWindow(800, 600, "Task Manager");
+    SetTargetFPS(IsInputReplaying() ? 0 : 60);
+    if (!StartInput()) {
+        CloseWindow();
         return 1;
     }
 
-    const char *createTableQuery = "CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY, username TEXT UNIQUE, password TEXT);";
-    if (sqlite3_exec(db, createTableQuery, NULL, NULL, NULL) != SQLITE_OK) {
-        printf("Failed to create table: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
+    StorageConfig storageConfig = DefaultStorageConfig();
+    LoadStorageConfig("storage.conf", &storageConfig);
+    SetStorageConfig(&storageConfig);
+
+    FrameScheduler frames;
+    InitFrameScheduler(&frames);
+    AuthScreen screen = {.currentScreen = SCREEN_REGISTRATION, .popupColor = RED, .frames = &frames};
+    AuthPool *pool = CreateAuthPool("users.db", storageConfig.authThreads, OnAuthResult, &screen);
+    if (pool == NULL) {
         return 1;
     }
+    Checkpointer *checkpointer = StartCheckpointer("users.db");
 
-    ScreenState currentScreen = SCREEN_REGISTRATION;
     UserData registration = {"", "", false, false};
     UserData login = {"", "", false, false};
-    char loggedInUsername[MAX_INPUT_LEN] = "";
-    char popupMessage[256] = "";
-    bool showPopup = false;
-    Color popupColor = RED;
 
     while (!WindowShouldClose()) {
-        Vector2 mouse = GetMousePosition();
+        // One at a time so a replay can stop at the recorded completion count
+        while (CanApplyInputCompletion() && DispatchAuthResults(pool, 1) > 0) {
+        }
 
-        if (showPopup && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            showPopup = false;
+        // Replays draw every recorded frame as soon as its completions are in
+        if (IsInputReplaying()) {
+            if (IsInputReplayFinished()) {
+                break;
+            }
+            if (!IsInputFrameReady()) {
+                WaitTime(0.001);
+                continue;
+            }
+            MarkFrameDirty(&frames);
+        }
+
+        if (!ShouldDrawFrame(&frames)) {
+            continue;
+        }
+        PollInputFrame();
+        Vector2 mouse = InputMousePosition();
+
+        if (screen.showPopup && screen.pendingId == 0 && InputMousePressed(MOUSE_LEFT_BUTTON)) {
+            screen.showPopup = false;
+        }
+
+        // Keep the spinner turning until the pool answers
+        if (screen.pendingId != 0) {
+            RequestFrameIn(&frames, SPINNER_FRAME_SECONDS);
         }
 
         BeginDrawing();
         ClearBackground(RAYWHITE);
 
-        switch (currentScreen) {
+        switch (screen.currentScreen) {
             case SCREEN_REGISTRATION: {
                 DrawText("Register", 350, 120, 40, DARKGRAY);
                 DrawTextInput(250, 200, 300, 40, registration.username, registration.usernameFocused, "Username");
@@ -71,30 +119,31 @@ int main(void) {
                 DrawRectangle(300, 350, 200, 50, registerColor);
                 DrawText("Register", 355, 365, 20, BLACK);
 
-                if (showPopup) {
-                    ShowPopup(popupMessage, popupColor);
+                if (screen.showPopup) {
+                    ShowPopup(screen.popupMessage, screen.popupColor);
+                    if (screen.pendingId != 0) {
+                        DrawSpinner(570, 300, InputTime());
+                    }
                 }
 
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                if (InputMousePressed(MOUSE_LEFT_BUTTON)) {
                     registration.usernameFocused = mouse.x > 250 && mouse.x < 550 && mouse.y > 200 && mouse.y < 240;
                     registration.passwordFocused = mouse.x > 250 && mouse.x < 550 && mouse.y > 270 && mouse.y < 310;
                 }
 
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && mouse.x > 300 && mouse.x < 500 && mouse.y > 350 && mouse.y < 400) {
+                if (screen.pendingId == 0 && InputMousePressed(MOUSE_LEFT_BUTTON) && mouse.x > 300 && mouse.x < 500 && mouse.y > 350 && mouse.y < 400) {
                     if (strlen(registration.username) > 0 && strlen(registration.password) > 0) {
-                        if (RegisterUser(registration.username, registration.password, db)) {
-                            strcpy(popupMessage, "Registration successful! Redirecting to login...");
-                            popupColor = GREEN;
-                            currentScreen = SCREEN_LOGIN;
-                        } else {
-                            strcpy(popupMessage, "Username already exists or invalid input!");
-                            popupColor = RED;
-                        }
+                        AuthRequest request = {.type = AUTH_REGISTER};
+                        snprintf(request.username, sizeof(request.username), "%s", registration.username);
+                        snprintf(request.password, sizeof(request.password), "%s", registration.password);
+                        screen.pendingId = SubmitAuthRequest(pool, &request);
+                        strcpy(screen.popupMessage, "Registering...");
+                        screen.popupColor = GRAY;
                     } else {
-                        strcpy(popupMessage, "Please fill in all fields!");
-                        popupColor = RED;
+                        strcpy(screen.popupMessage, "Please fill in all fields!");
+                        screen.popupColor = RED;
                     }
-                    showPopup = true;
+                    screen.showPopup = true;
                 }
                 break;
             }
@@ -107,31 +156,31 @@ int main(void) {
                 DrawRectangle(300, 350, 200, 50, loginColor);
                 DrawText("Login", 355, 365, 20, BLACK);
 
-                if (showPopup) {
-                    ShowPopup(popupMessage, popupColor);
+                if (screen.showPopup) {
+                    ShowPopup(screen.popupMessage, screen.popupColor);
+                    if (screen.pendingId != 0) {
+                        DrawSpinner(570, 300, InputTime());
+                    }
                 }
 
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                if (InputMousePressed(MOUSE_LEFT_BUTTON)) {
                     login.usernameFocused = mouse.x > 250 && mouse.x < 550 && mouse.y > 200 && mouse.y < 240;
                     login.passwordFocused = mouse.x > 250 && mouse.x < 550 && mouse.y > 270 && mouse.y < 310;
                 }
 
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && mouse.x > 300 && mouse.x < 500 && mouse.y > 350 && mouse.y < 400) {
-                    if (LoginUser(login.username, login.password, db)) {
-                        strcpy(popupMessage, "Login successful! Redirecting to dashboard...");
-                        popupColor = GREEN;
-                        strcpy(loggedInUsername, login.username);
-                        currentScreen = SCREEN_DASHBOARD;
-                    } else {
-                        strcpy(popupMessage, "Invalid username or password!");
-                        popupColor = RED;
-                    }
-                    showPopup = true;
+                if (screen.pendingId == 0 && InputMousePressed(MOUSE_LEFT_BUTTON) && mouse.x > 300 && mouse.x < 500 && mouse.y > 350 && mouse.y < 400) {
+                    AuthRequest request = {.type = AUTH_LOGIN};
+                    snprintf(request.username, sizeof(request.username), "%s", login.username);
+                    snprintf(request.password, sizeof(request.password), "%s", login.password);
+                    screen.pendingId = SubmitAuthRequest(pool, &request);
+                    strcpy(screen.popupMessage, "Signing in...");
+                    screen.popupColor = GRAY;
+                    screen.showPopup = true;
                 }
                 break;
             }
             case SCREEN_DASHBOARD: {
-                DrawDashboard(loggedInUsername);
+                DrawDashboard(screen.loggedInUsername);
                 break;
             }
         }
@@ -139,7 +188,10 @@ int main(void) {
         EndDrawing();
     }
 
-    sqlite3_close(db);
+    PrintFrameStats(&frames);
+    StopInput();
+    StopCheckpointer(checkpointer);
+    DestroyAuthPool(pool);
     CloseWindow();
     return 0;
 }
@@ -159,57 +211,38 @@ void ShowPopup(const char *message, Color bgColor) {
     DrawText(message, 220, 290, 20, WHITE);
 }
 
-bool RegisterUser(const char *username, const char *password, sqlite3 *db) {
-    char hashedPassword[SHA256_DIGEST_LENGTH * 2 + 1];
-    HashPassword(password, hashedPassword);
-
-    const char *insertQuery = "INSERT INTO users (username, password) VALUES (?, ?);";
-    sqlite3_stmt *stmt;
-
-    if (sqlite3_prepare_v2(db, insertQuery, -1, &stmt, NULL) != SQLITE_OK) {
-        return false;
-    }
-
-    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, hashedPassword, -1, SQLITE_STATIC);
-
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        sqlite3_finalize(stmt);
-        return false;
-    }
-
-    sqlite3_finalize(stmt);
-    return true;
+// A ring with a gap that turns once a second while the pool is working
+void DrawSpinner(int x, int y, double time) {
+    float angle = (float)fmod(time * 360.0, 360.0);
+    DrawRing((Vector2){(float)x, (float)y}, 8, 12, angle, angle + 270, 24, WHITE);
 }
 
-bool LoginUser(const char *username, const char *password, sqlite3 *db) {
-    char hashedPassword[SHA256_DIGEST_LENGTH * 2 + 1];
-    HashPassword(password, hashedPassword);
-
-    const char *selectQuery = "SELECT 1 FROM users WHERE username = ? AND password = ?;";
-    sqlite3_stmt *stmt;
-
-    if (sqlite3_prepare_v2(db, selectQuery, -1, &stmt, NULL) != SQLITE_OK) {
-        return false;
+void OnAuthResult(const AuthRequest *result, void *context) {
+    AuthScreen *screen = context;
+    if (result->id != screen->pendingId) {
+        return;
     }
-
-    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, hashedPassword, -1, SQLITE_STATIC);
-
-    bool authenticated = sqlite3_step(stmt) == SQLITE_ROW;
-
-    sqlite3_finalize(stmt);
-    return authenticated;
-}
-
-void HashPassword(const char *password, char *hashedPassword) {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256((unsigned char *)password, strlen(password), hash);
-
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        sprintf(hashedPassword + (i * 2), "%02x", hash[i]);
+    screen->pendingId = 0;
+    NoteInputCompletion();
+    MarkFrameDirty(screen->frames);
+    if (result->type == AUTH_REGISTER) {
+        if (result->ok) {
+            strcpy(screen->popupMessage, "Registration successful! Redirecting to login...");
+            screen->popupColor = GREEN;
+            screen->currentScreen = SCREEN_LOGIN;
+        } else {
+            strcpy(screen->popupMessage, "Username already exists or invalid input!");
+            screen->popupColor = RED;
+        }
+    } else if (result->ok) {
+        strcpy(screen->popupMessage, "Login successful! Redirecting to dashboard...");
+        screen->popupColor = GREEN;
+        strcpy(screen->loggedInUsername, result->username);
+        screen->currentScreen = SCREEN_DASHBOARD;
+    } else {
+        strcpy(screen->popupMessage, "Invalid username or password!");
+        screen->popupColor = RED;
     }
-    hashedPassword[SHA256_DIGEST_LENGTH * 2] = '\0';
 }
 
 void DrawDashboard(const char *username) {
@@ -0,0 +1,235 @@
+#include "profile.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    ProfileEvent *events;
+    long eventCount;               // Total recorded; the ring holds the last PROFILE_EVENT_CAPACITY
+    double frameMs[PROFILE_SAMPLE_COUNT];
+    long frames;
+    double statementMs[PROFILE_SAMPLE_COUNT];
+    long statements;
+    long long originNs;
+    pthread_mutex_t lock;
+} Profiler;
+
+static Profiler profiler = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static atomic_bool running;
+static atomic_int nextThread = 1;
+static _Thread_local int profileThread;
+
+static long long NowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int CurrentThread(void) {
+    if (profileThread == 0) {
+        profileThread = atomic_fetch_add(&nextThread, 1);
+    }
+    return profileThread;
+}
+
+// Caller holds the lock
+static void RecordEvent(const char *category, const char *name, long long startUs, long long durationUs) {
+    ProfileEvent *event = &profiler.events[profiler.eventCount % PROFILE_EVENT_CAPACITY];
+    snprintf(event->name, sizeof(event->name), "%s", name);
+    event->category = category;
+    event->startUs = startUs;
+    event->durationUs = durationUs;
+    event->thread = CurrentThread();
+    profiler.eventCount++;
+}
+
+void StartProfiler(void) {
+    pthread_mutex_lock(&profiler.lock);
+    if (profiler.events == NULL) {
+        profiler.events = calloc(PROFILE_EVENT_CAPACITY, sizeof(ProfileEvent));
+        profiler.originNs = NowNs();
+    }
+    if (profiler.events != NULL) {
+        atomic_store(&running, true);
+    }
+    pthread_mutex_unlock(&profiler.lock);
+}
+
+void StopProfiler(void) {
+    atomic_store(&running, false);
+    pthread_mutex_lock(&profiler.lock);
+    free(profiler.events);
+    profiler.events = NULL;
+    profiler.eventCount = 0;
+    profiler.frames = 0;
+    profiler.statements = 0;
+    pthread_mutex_unlock(&profiler.lock);
+}
+
+bool IsProfilerRunning(void) {
+    return atomic_load(&running);
+}
+
+long long ProfileNow(void) {
+    return (NowNs() - profiler.originNs) / 1000;
+}
+
+void EndProfileZone(const char *category, const char *name, long long startUs) {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    long long end = ProfileNow();
+    pthread_mutex_lock(&profiler.lock);
+    if (profiler.events != NULL) {
+        RecordEvent(category, name, startUs, end - startUs);
+    }
+    pthread_mutex_unlock(&profiler.lock);
+}
+
+// Close a frame zone and feed the frame-time percentiles
+void EndProfileFrame(long long startUs) {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    long long end = ProfileNow();
+    pthread_mutex_lock(&profiler.lock);
+    if (profiler.events != NULL) {
+        RecordEvent("frame", "frame", startUs, end - startUs);
+        profiler.frameMs[profiler.frames++ % PROFILE_SAMPLE_COUNT] = (end - startUs) / 1000.0;
+    }
+    pthread_mutex_unlock(&profiler.lock);
+}
+
+#define TRACE_STACK_SIZE 16
+
+// Statements running on this thread, outermost first. SQLite's own profile
+// time is only millisecond-accurate, so statements are timed here instead.
+typedef struct {
+    void *statement;
+    long long startUs;
+} RunningStatement;
+
+static _Thread_local RunningStatement traceStack[TRACE_STACK_SIZE];
+static _Thread_local int traceDepth;
+
+// Only top-level statements are recorded; the ones FTS5 and triggers run
+// underneath them are already part of their time
+static int TraceStatement(unsigned type, void *context, void *statement, void *detail) {
+    (void)context;
+    if (!atomic_load(&running)) {
+        return 0;
+    }
+    if (type == SQLITE_TRACE_STMT) {
+        // Trigger bodies report again on the same statement as "-- TRIGGER name"
+        const char *text = detail;
+        if (strncmp(text, "--", 2) != 0 && traceDepth < TRACE_STACK_SIZE) {
+            traceStack[traceDepth++] = (RunningStatement){statement, ProfileNow()};
+        }
+        return 0;
+    }
+
+    int index = traceDepth - 1;
+    while (index >= 0 && traceStack[index].statement != statement) {
+        index--;
+    }
+    if (index < 0) {
+        return 0;
+    }
+    long long start = traceStack[index].startUs;
+    memmove(&traceStack[index], &traceStack[index + 1], (traceDepth - index - 1) * sizeof(RunningStatement));
+    traceDepth--;
+    if (index > 0) {
+        return 0;
+    }
+
+    long long end = ProfileNow();
+    pthread_mutex_lock(&profiler.lock);
+    if (profiler.events != NULL) {
+        RecordEvent("sql", sqlite3_sql(statement), start, end - start);
+        profiler.statementMs[profiler.statements++ % PROFILE_SAMPLE_COUNT] = (end - start) / 1000.0;
+    }
+    pthread_mutex_unlock(&profiler.lock);
+    return 0;
+}
+
+void TraceStatements(sqlite3 *db) {
+    sqlite3_trace_v2(db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, TraceStatement, NULL);
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of the most recent samples
+static double Percentile(const double *samples, long total, double fraction) {
+    int count = total < PROFILE_SAMPLE_COUNT ? (int)total : PROFILE_SAMPLE_COUNT;
+    if (count == 0) {
+        return 0;
+    }
+    double sorted[PROFILE_SAMPLE_COUNT];
+    memcpy(sorted, samples, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), CompareDoubles);
+    int rank = (int)(fraction * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+ProfileSummary GetProfileSummary(void) {
+    ProfileSummary summary;
+    pthread_mutex_lock(&profiler.lock);
+    summary.frameP50Ms = Percentile(profiler.frameMs, profiler.frames, 0.50);
+    summary.frameP99Ms = Percentile(profiler.frameMs, profiler.frames, 0.99);
+    summary.statementP50Ms = Percentile(profiler.statementMs, profiler.statements, 0.50);
+    summary.statementP99Ms = Percentile(profiler.statementMs, profiler.statements, 0.99);
+    summary.frames = profiler.frames;
+    summary.statements = profiler.statements;
+    pthread_mutex_unlock(&profiler.lock);
+    return summary;
+}
+
+static void WriteJsonString(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// Write the retained events as Chrome trace-event JSON (chrome://tracing, Perfetto)
+bool ExportProfileTrace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    pthread_mutex_lock(&profiler.lock);
+    long first = profiler.eventCount > PROFILE_EVENT_CAPACITY ? profiler.eventCount - PROFILE_EVENT_CAPACITY : 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (long i = first; i < profiler.eventCount && profiler.events != NULL; i++) {
+        const ProfileEvent *event = &profiler.events[i % PROFILE_EVENT_CAPACITY];
+        fprintf(file, "%s{\"name\":", i == first ? "" : ",\n");
+        WriteJsonString(file, event->name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d}",
+                event->category, event->startUs, event->durationUs, event->thread);
+    }
+    fprintf(file, "\n]}\n");
+    long written = profiler.eventCount - first;
+    pthread_mutex_unlock(&profiler.lock);
+
+    bool ok = fclose(file) == 0;
+    printf("Wrote %ld trace events to %s\n", written, path);
+    return ok;
+}
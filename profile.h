@@ -0,0 +1,44 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+
+#define PROFILE_EVENT_CAPACITY 65536  // Oldest events are overwritten
+#define PROFILE_SAMPLE_COUNT 240      // Frames/statements the percentiles cover
+#define PROFILE_NAME_LEN 64
+
+// One timed span, in microseconds since StartProfiler
+typedef struct {
+    char name[PROFILE_NAME_LEN];
+    const char *category;
+    long long startUs;
+    long long durationUs;
+    int thread;
+} ProfileEvent;
+
+typedef struct {
+    double frameP50Ms;
+    double frameP99Ms;
+    double statementP50Ms;
+    double statementP99Ms;
+    long frames;
+    long statements;
+} ProfileSummary;
+
+// Zones are timed by hand:
+//     long long start = ProfileNow();
+//     ...
+//     EndProfileZone("frame", "draw", start);
+// Everything is a no-op until StartProfiler is called.
+void StartProfiler(void);
+void StopProfiler(void);
+bool IsProfilerRunning(void);
+long long ProfileNow(void);
+void EndProfileZone(const char *category, const char *name, long long startUs);
+void EndProfileFrame(long long startUs);
+void TraceStatements(sqlite3 *db);
+ProfileSummary GetProfileSummary(void);
+bool ExportProfileTrace(const char *path);
+
+#endif
@@ -0,0 +1,217 @@
+#include "reminder.h"
+#include "taskcore.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int ReadDataVersion(ReminderScheduler *scheduler) {
+    sqlite3_stmt *stmt = BeginStatement(scheduler->db, STMT_DATA_VERSION);
+    int version = StepStatement(scheduler->db, stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    EndStatement(scheduler->db, stmt);
+    return version;
+}
+
+// Everything after the last processed tick is loaded again from scratch
+static void ResetWheel(ReminderScheduler *scheduler) {
+    ClearTimerWheel(&scheduler->wheel);
+    scheduler->cursorDue = scheduler->wheel.now;
+    scheduler->cursorId = INT_MAX;
+}
+
+// Top the wheel up once the loaded stretch gets within half a window of now,
+// or half the pool has fired. Rows come in due order, so a batch cut short
+// by the pool still leaves the cursor exactly where loading stopped.
+static void LoadDueTasks(ReminderScheduler *scheduler, long long now) {
+    TimerWheel *wheel = &scheduler->wheel;
+    int room = wheel->capacity - wheel->count;
+    if (scheduler->cursorDue >= now + REMINDER_WINDOW_SECONDS / 2 || room < wheel->capacity / 2) {
+        return;
+    }
+
+    long long until = now + REMINDER_WINDOW_SECONDS;
+    sqlite3_stmt *stmt = BeginStatement(scheduler->db, STMT_SELECT_DUE_TASKS);
+    sqlite3_bind_int(stmt, 1, scheduler->userId);
+    sqlite3_bind_int64(stmt, 2, scheduler->cursorDue);
+    sqlite3_bind_int(stmt, 3, scheduler->cursorId);
+    sqlite3_bind_int64(stmt, 4, until);
+    sqlite3_bind_int(stmt, 5, room);
+    int loaded = 0;
+    int rc;
+    while ((rc = StepStatement(scheduler->db, stmt)) == SQLITE_ROW) {
+        int taskId = sqlite3_column_int(stmt, 0);
+        long long dueAt = sqlite3_column_int64(stmt, 1);
+        AddTimer(wheel, taskId, dueAt);
+        scheduler->cursorDue = dueAt;
+        scheduler->cursorId = taskId;
+        loaded++;
+    }
+    EndStatement(scheduler->db, stmt);
+    if (rc == SQLITE_DONE && loaded < room) {
+        scheduler->cursorDue = until - 1;
+        scheduler->cursorId = INT_MAX;
+    }
+    scheduler->stats.loads++;
+}
+
+static void QueueReminder(ReminderScheduler *scheduler, const Reminder *reminder) {
+    pthread_mutex_lock(&scheduler->lock);
+    if (scheduler->queued == REMINDER_QUEUE_SIZE) {
+        memmove(&scheduler->queue[0], &scheduler->queue[1], (REMINDER_QUEUE_SIZE - 1) * sizeof(Reminder));
+        scheduler->queued--;
+        scheduler->stats.dropped++;
+    }
+    scheduler->queue[scheduler->queued++] = *reminder;
+    scheduler->stats.fired++;
+    atomic_fetch_add(&scheduler->changeCount, 1);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+// TimerExpired callback. The task may have been completed, deleted or given
+// another due time since it was loaded; then the timer is simply dropped.
+static void FireReminder(int taskId, long long dueAt, void *context) {
+    ReminderScheduler *scheduler = context;
+    Database *db = scheduler->db;
+    Reminder reminder = {.taskId = taskId, .dueAt = dueAt};
+
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_DUE_REMINDER);
+    sqlite3_bind_int(stmt, 1, taskId);
+    sqlite3_bind_int(stmt, 2, scheduler->userId);
+    sqlite3_bind_int64(stmt, 3, dueAt);
+    bool current = StepStatement(db, stmt) == SQLITE_ROW;
+    if (current) {
+        snprintf(reminder.title, sizeof(reminder.title), "%s", (const char *)sqlite3_column_text(stmt, 0));
+        reminder.repeatEvery = sqlite3_column_int(stmt, 1);
+    }
+    EndStatement(db, stmt);
+    if (!current) {
+        scheduler->stats.stale++;
+        return;
+    }
+    QueueReminder(scheduler, &reminder);
+    if (reminder.repeatEvery <= 0) {
+        return;
+    }
+
+    // Our own commit doesn't move our data_version, so the next occurrence
+    // goes on the wheel here if it falls inside what is already loaded
+    long long next = NextDueAt(dueAt, reminder.repeatEvery, scheduler->wheel.now);
+    stmt = BeginStatement(db, STMT_ADVANCE_DUE);
+    sqlite3_bind_int64(stmt, 1, next);
+    sqlite3_bind_int(stmt, 2, taskId);
+    sqlite3_bind_int(stmt, 3, scheduler->userId);
+    sqlite3_bind_int64(stmt, 4, dueAt);
+    bool advanced = StepStatement(db, stmt) == SQLITE_DONE && sqlite3_changes(db->handle) > 0;
+    EndStatement(db, stmt);
+    bool loaded = next < scheduler->cursorDue || (next == scheduler->cursorDue && taskId <= scheduler->cursorId);
+    if (advanced && loaded && !AddTimer(&scheduler->wheel, taskId, next)) {
+        // No room; rebuild the wheel after this pass rather than lose it
+        pthread_mutex_lock(&scheduler->lock);
+        scheduler->reload = true;
+        pthread_mutex_unlock(&scheduler->lock);
+    }
+}
+
+static void *SchedulerMain(void *arg) {
+    ReminderScheduler *scheduler = arg;
+
+    pthread_mutex_lock(&scheduler->lock);
+    while (!scheduler->quit) {
+        bool reload = scheduler->reload;
+        scheduler->reload = false;
+        pthread_mutex_unlock(&scheduler->lock);
+
+        long long now = time(NULL);
+        int version = ReadDataVersion(scheduler);
+        if (reload || version != scheduler->dataVersion) {
+            scheduler->dataVersion = version;
+            ResetWheel(scheduler);
+            scheduler->stats.reloads++;
+        }
+        LoadDueTasks(scheduler, now);
+        AdvanceTimerWheel(&scheduler->wheel, now, FireReminder, scheduler);
+
+        // Sleep to the start of the next second
+        pthread_mutex_lock(&scheduler->lock);
+        struct timespec deadline = {.tv_sec = (time_t)now + 1};
+        while (!scheduler->quit && !scheduler->reload &&
+               pthread_cond_timedwait(&scheduler->wake, &scheduler->lock, &deadline) != ETIMEDOUT) {
+        }
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+    return NULL;
+}
+
+ReminderScheduler *CreateReminderScheduler(const char *path, int userId) {
+    ReminderScheduler *scheduler = calloc(1, sizeof(ReminderScheduler));
+    if (scheduler == NULL) {
+        return NULL;
+    }
+    scheduler->db = OpenDatabase(path);
+    if (scheduler->db == NULL || !InitTimerWheel(&scheduler->wheel, REMINDER_CAPACITY, time(NULL))) {
+        CloseDatabase(scheduler->db);
+        free(scheduler);
+        return NULL;
+    }
+    scheduler->userId = userId;
+    scheduler->dataVersion = ReadDataVersion(scheduler);
+    ResetWheel(scheduler);
+
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->wake, NULL);
+    pthread_create(&scheduler->thread, NULL, SchedulerMain, scheduler);
+    return scheduler;
+}
+
+void DestroyReminderScheduler(ReminderScheduler *scheduler) {
+    if (scheduler == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->quit = true;
+    pthread_cond_signal(&scheduler->wake);
+    pthread_mutex_unlock(&scheduler->lock);
+    pthread_join(scheduler->thread, NULL);
+
+    ReminderStats stats = scheduler->stats;
+    printf("Reminders: %ld fired, %ld stale, %ld dropped; %ld window loads, %ld reloads\n",
+           stats.fired, stats.stale, stats.dropped, stats.loads, stats.reloads);
+    FreeTimerWheel(&scheduler->wheel);
+    CloseDatabase(scheduler->db);
+    pthread_cond_destroy(&scheduler->wake);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler);
+}
+
+void RefreshReminders(ReminderScheduler *scheduler) {
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->reload = true;
+    pthread_cond_signal(&scheduler->wake);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+unsigned GetReminderChangeCount(ReminderScheduler *scheduler) {
+    return atomic_load(&scheduler->changeCount);
+}
+
+int PeekReminder(ReminderScheduler *scheduler, Reminder *reminder) {
+    pthread_mutex_lock(&scheduler->lock);
+    int queued = scheduler->queued;
+    if (queued > 0) {
+        *reminder = scheduler->queue[0];
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+    return queued;
+}
+
+void DismissReminder(ReminderScheduler *scheduler) {
+    pthread_mutex_lock(&scheduler->lock);
+    if (scheduler->queued > 0) {
+        memmove(&scheduler->queue[0], &scheduler->queue[1], (scheduler->queued - 1) * sizeof(Reminder));
+        scheduler->queued--;
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
@@ -0,0 +1,74 @@
+#ifndef REMINDER_H
+#define REMINDER_H
+
+#include "db.h"
+#include "timerwheel.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define REMINDER_CAPACITY 4096          // Timers on the wheel at once
+#define REMINDER_WINDOW_SECONDS 86400   // How far ahead due times are loaded
+#define REMINDER_QUEUE_SIZE 16          // Fired reminders waiting to be dismissed
+#define REMINDER_TITLE_LEN 256
+
+typedef struct {
+    int taskId;
+    long long dueAt;   // The occurrence that fired
+    int repeatEvery;
+    char title[REMINDER_TITLE_LEN];
+} Reminder;
+
+typedef struct {
+    long loads;    // Window queries against tasks_due
+    long reloads;  // Wheel rebuilt after another connection committed
+    long fired;
+    long stale;    // Timers whose task was done, deleted or rescheduled by then
+    long dropped;  // Fired while the queue was full
+} ReminderStats;
+
+// Fires reminders for one user's open tasks as they come due, on its own
+// thread and connection. Due times are loaded lazily off tasks_due, at most
+// REMINDER_WINDOW_SECONDS ahead and REMINDER_CAPACITY at a time, onto a
+// timer wheel ticking once a second, so the cost of a tick doesn't grow with
+// the number of tasks that have due dates. A timer is checked against its
+// row when it fires; a recurring task's due time then moves on to its next
+// occurrence. Commits by other connections (PRAGMA data_version) rebuild
+// the wheel from the last tick processed, so nothing fires twice.
+//
+// Only due times reached while the scheduler runs fire; anything already
+// overdue when it starts is left to the list to show.
+typedef struct {
+    Database *db;
+    int userId;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool quit;
+    bool reload;        // Set by RefreshReminders
+
+    // Scheduler thread only. Every open task due after the wheel's start and
+    // up to (cursorDue, cursorId) is on the wheel; later ones aren't loaded.
+    TimerWheel wheel;
+    long long cursorDue;
+    int cursorId;
+    int dataVersion;
+
+    Reminder queue[REMINDER_QUEUE_SIZE]; // Oldest first
+    int queued;
+    atomic_uint changeCount;             // Bumped whenever a reminder is queued
+    ReminderStats stats;
+} ReminderScheduler;
+
+ReminderScheduler *CreateReminderScheduler(const char *path, int userId);
+void DestroyReminderScheduler(ReminderScheduler *scheduler);
+// Re-read due times now rather than at the next data_version check, e.g.
+// after this process set one
+void RefreshReminders(ReminderScheduler *scheduler);
+unsigned GetReminderChangeCount(ReminderScheduler *scheduler);
+// The oldest undismissed reminder, and how many are waiting in all
+int PeekReminder(ReminderScheduler *scheduler, Reminder *reminder);
+void DismissReminder(ReminderScheduler *scheduler);
+
+#endif
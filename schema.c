@@ -0,0 +1,224 @@
+#include "schema.h"
+#include "db.h"
+#include <stdio.h>
+#include <string.h>
+
+// migrations[i] takes the database from user_version i to i + 1. Append new
+// steps at the end; never edit one that has shipped.
+static const char *migrations[] = {
+    // 1: the original tables
+    "CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY, username TEXT UNIQUE, password TEXT);"
+    "CREATE TABLE IF NOT EXISTS tasks ("
+    "id INTEGER PRIMARY KEY, "
+    "username TEXT, "
+    "title TEXT, "
+    "completed INTEGER);",
+
+    // 2: tasks reference users by id, indexed per user
+    "INSERT OR IGNORE INTO users (username) SELECT DISTINCT username FROM tasks WHERE username IS NOT NULL;"
+    "CREATE TABLE tasks_new ("
+    "id INTEGER PRIMARY KEY, "
+    "user_id INTEGER NOT NULL REFERENCES users (id) ON DELETE CASCADE, "
+    "title TEXT NOT NULL, "
+    "completed INTEGER NOT NULL DEFAULT 0);"
+    "INSERT INTO tasks_new (id, user_id, title, completed) "
+    "SELECT t.id, u.id, COALESCE(t.title, ''), COALESCE(t.completed, 0) "
+    "FROM tasks t JOIN users u ON u.username = t.username;"
+    "DROP TABLE tasks;"
+    "ALTER TABLE tasks_new RENAME TO tasks;"
+    // Keyset paging walks (user_id, id); counts and status filters are
+    // answered from the covering (user_id, completed, id) index alone
+    "CREATE INDEX tasks_user ON tasks (user_id, id);"
+    "CREATE INDEX tasks_user_status ON tasks (user_id, completed, id);",
+
+    // 3: full-text index over titles, kept in sync by triggers
+    "CREATE VIRTUAL TABLE tasks_fts USING fts5 (title, content = 'tasks', content_rowid = 'id');"
+    "INSERT INTO tasks_fts (tasks_fts) VALUES ('rebuild');"
+    "CREATE TRIGGER tasks_fts_insert AFTER INSERT ON tasks BEGIN "
+    "INSERT INTO tasks_fts (rowid, title) VALUES (new.id, new.title); END;"
+    "CREATE TRIGGER tasks_fts_delete AFTER DELETE ON tasks BEGIN "
+    "INSERT INTO tasks_fts (tasks_fts, rowid, title) VALUES ('delete', old.id, old.title); END;"
+    "CREATE TRIGGER tasks_fts_update AFTER UPDATE OF title ON tasks BEGIN "
+    "INSERT INTO tasks_fts (tasks_fts, rowid, title) VALUES ('delete', old.id, old.title);"
+    "INSERT INTO tasks_fts (rowid, title) VALUES (new.id, new.title); END;",
+
+    // 4: manual ordering. Lists are paged by (rank, id), so the old id
+    // index is replaced; existing tasks keep their id order
+    "ALTER TABLE tasks ADD COLUMN rank REAL NOT NULL DEFAULT 0;"
+    "UPDATE tasks SET rank = id * 1024.0;"
+    "DROP INDEX tasks_user;"
+    "CREATE INDEX tasks_rank ON tasks (user_id, rank, id);",
+
+    // 5: due dates and recurrence. Most tasks have neither, so the index
+    // the reminder scheduler walks only holds the ones that do
+    "ALTER TABLE tasks ADD COLUMN due_at INTEGER;"
+    "ALTER TABLE tasks ADD COLUMN recur_every INTEGER NOT NULL DEFAULT 0;"
+    "CREATE INDEX tasks_due ON tasks (user_id, due_at) WHERE due_at IS NOT NULL;",
+
+    // 6: change feed other connections tail instead of reloading. kind is
+    // a TaskChangeKind; rank is where the row was (its new rank for an
+    // insert). Only about the last 8192 changes are kept, trimmed in
+    // batches of 1024.
+    "CREATE TABLE task_changes ("
+    "seq INTEGER PRIMARY KEY, "
+    "user_id INTEGER NOT NULL, "
+    "task_id INTEGER NOT NULL, "
+    "kind INTEGER NOT NULL, "
+    "rank REAL NOT NULL);"
+    "CREATE INDEX task_changes_user ON task_changes (user_id, seq);"
+    "CREATE TRIGGER task_changes_insert AFTER INSERT ON tasks BEGIN "
+    "INSERT INTO task_changes (user_id, task_id, kind, rank) VALUES (new.user_id, new.id, 0, new.rank); END;"
+    "CREATE TRIGGER task_changes_update AFTER UPDATE ON tasks BEGIN "
+    "INSERT INTO task_changes (user_id, task_id, kind, rank) "
+    "VALUES (new.user_id, new.id, CASE WHEN new.rank = old.rank THEN 1 ELSE 2 END, old.rank); END;"
+    "CREATE TRIGGER task_changes_delete AFTER DELETE ON tasks BEGIN "
+    "INSERT INTO task_changes (user_id, task_id, kind, rank) VALUES (old.user_id, old.id, 3, old.rank); END;"
+    "CREATE TRIGGER task_changes_trim AFTER INSERT ON task_changes WHEN new.seq % 1024 = 0 BEGIN "
+    "DELETE FROM task_changes WHERE seq <= new.seq - 8192; END;",
+
+    // 7: per-user counts kept exact by triggers. overdue counts open tasks
+    // due at or before overdue_as_of; every write also adds the ones that
+    // fell due since and moves overdue_as_of up to now.
+    "CREATE TABLE task_counts ("
+    "user_id INTEGER PRIMARY KEY REFERENCES users (id) ON DELETE CASCADE, "
+    "total INTEGER NOT NULL DEFAULT 0, "
+    "completed INTEGER NOT NULL DEFAULT 0, "
+    "overdue INTEGER NOT NULL DEFAULT 0, "
+    "overdue_as_of INTEGER NOT NULL DEFAULT 0);"
+    "INSERT INTO task_counts (user_id, total, completed, overdue, overdue_as_of) "
+    "SELECT u.id, COUNT(t.id), IFNULL(SUM(t.completed <> 0), 0), "
+    "IFNULL(SUM(t.completed = 0 AND t.due_at <= CAST(strftime('%s', 'now') AS INTEGER)), 0), "
+    "CAST(strftime('%s', 'now') AS INTEGER) "
+    "FROM users u LEFT JOIN tasks t ON t.user_id = u.id GROUP BY u.id;"
+    "CREATE TRIGGER task_counts_user AFTER INSERT ON users BEGIN "
+    "INSERT INTO task_counts (user_id, overdue_as_of) VALUES (new.id, CAST(strftime('%s', 'now') AS INTEGER)); END;"
+    "CREATE TRIGGER task_counts_insert AFTER INSERT ON tasks BEGIN "
+    "UPDATE task_counts SET total = total + 1, completed = completed + (new.completed <> 0), "
+    "overdue = overdue + (new.completed = 0 AND IFNULL(new.due_at <= overdue_as_of, 0)) + "
+    "(SELECT COUNT(*) FROM tasks t WHERE t.user_id = new.user_id AND t.due_at > task_counts.overdue_as_of "
+    "AND t.due_at <= CAST(strftime('%s', 'now') AS INTEGER) AND t.completed = 0), "
+    "overdue_as_of = MAX(overdue_as_of, CAST(strftime('%s', 'now') AS INTEGER)) "
+    "WHERE user_id = new.user_id; END;"
+    "CREATE TRIGGER task_counts_update AFTER UPDATE OF completed, due_at ON tasks BEGIN "
+    "UPDATE task_counts SET completed = completed + (new.completed <> 0) - (old.completed <> 0), "
+    "overdue = overdue + (new.completed = 0 AND IFNULL(new.due_at <= overdue_as_of, 0)) "
+    "- (old.completed = 0 AND IFNULL(old.due_at <= overdue_as_of, 0)) + "
+    "(SELECT COUNT(*) FROM tasks t WHERE t.user_id = new.user_id AND t.due_at > task_counts.overdue_as_of "
+    "AND t.due_at <= CAST(strftime('%s', 'now') AS INTEGER) AND t.completed = 0), "
+    "overdue_as_of = MAX(overdue_as_of, CAST(strftime('%s', 'now') AS INTEGER)) "
+    "WHERE user_id = new.user_id; END;"
+    "CREATE TRIGGER task_counts_delete AFTER DELETE ON tasks BEGIN "
+    "UPDATE task_counts SET total = total - 1, completed = completed - (old.completed <> 0), "
+    "overdue = overdue - (old.completed = 0 AND IFNULL(old.due_at <= overdue_as_of, 0)) + "
+    "(SELECT COUNT(*) FROM tasks t WHERE t.user_id = old.user_id AND t.due_at > task_counts.overdue_as_of "
+    "AND t.due_at <= CAST(strftime('%s', 'now') AS INTEGER) AND t.completed = 0), "
+    "overdue_as_of = MAX(overdue_as_of, CAST(strftime('%s', 'now') AS INTEGER)) "
+    "WHERE user_id = old.user_id; END;",
+
+    // 8: the last undo journal op each user's batches have applied, written
+    // in the same transaction as the batch, so replaying the journal's log
+    // after a crash skips whatever already landed
+    "CREATE TABLE journal_applied ("
+    "user_id INTEGER PRIMARY KEY REFERENCES users (id) ON DELETE CASCADE, "
+    "seq INTEGER NOT NULL);",
+};
+
+#define MIGRATION_COUNT ((int)(sizeof(migrations) / sizeof(migrations[0])))
+
+int GetSchemaVersion(sqlite3 *db) {
+    sqlite3_stmt *stmt;
+    int version = -1;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            version = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return version;
+}
+
+// Bring the schema up to date. Each step runs in its own IMMEDIATE
+// transaction together with its user_version bump, so a crash or a second
+// process opening the file at the same time can't apply a step twice.
+bool MigrateSchema(sqlite3 *db) {
+    for (;;) {
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK) {
+            printf("Failed to start migration: %s\n", sqlite3_errmsg(db));
+            return false;
+        }
+
+        int version = GetSchemaVersion(db);
+        if (version < 0 || version > MIGRATION_COUNT) {
+            printf("Unsupported schema version %d\n", version);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return false;
+        }
+        if (version == MIGRATION_COUNT) {
+            sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+            return true;
+        }
+
+        char bump[64];
+        snprintf(bump, sizeof(bump), "PRAGMA user_version = %d;", version + 1);
+        if (sqlite3_exec(db, migrations[version], NULL, NULL, NULL) != SQLITE_OK ||
+            sqlite3_exec(db, bump, NULL, NULL, NULL) != SQLITE_OK) {
+            printf("Migration to version %d failed: %s\n", version + 1, sqlite3_errmsg(db));
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return false;
+        }
+        if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+            printf("Failed to commit migration: %s\n", sqlite3_errmsg(db));
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return false;
+        }
+    }
+}
+
+// Per-user task queries must be index searches, never a scan of every user's
+// rows. Returns false and prints the offending plan line otherwise.
+bool CheckTaskQueryPlans(sqlite3 *db) {
+    // The prepared statements themselves, so a change to one is checked as
+    // shipped. Search goes through the FTS table and the bulk updates walk the
+    // temp span list, so those are left out.
+    static const StatementId checked[] = {
+        STMT_INSERT_TASK,
+        STMT_SELECT_TASK_PAGE,
+        STMT_SELECT_PAGE_START,
+        STMT_COUNT_TASKS,
+        STMT_TASK_RANK,
+        STMT_MOVE_TASK,
+        STMT_SET_TASK_DUE,
+        STMT_SELECT_DUE_TASKS,
+        STMT_DUE_REMINDER,
+        STMT_ADVANCE_DUE,
+        STMT_SELECT_CHANGES,
+        STMT_SELECT_TASK_COUNTS,
+        STMT_COMPLETE_TASK,
+        STMT_DELETE_TASK,
+        STMT_UNCOMPLETE_TASK,
+        STMT_EXPORT_TASKS,
+    };
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(checked) / sizeof(checked[0]); i++) {
+        const char *query = GetStatementQuery(checked[i]);
+        char *explain = sqlite3_mprintf("EXPLAIN QUERY PLAN %s", query);
+
+        sqlite3_stmt *stmt;
+        int rc = sqlite3_prepare_v2(db, explain, -1, &stmt, NULL);
+        sqlite3_free(explain);
+        if (rc != SQLITE_OK) {
+            printf("Failed to explain query: %s\n", sqlite3_errmsg(db));
+            return false;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+            if (strncmp(detail, "SCAN", 4) == 0 || strstr(detail, "TEMP B-TREE") != NULL) {
+                printf("Slow plan for \"%s\": %s\n", query, detail);
+                ok = false;
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    return ok;
+}
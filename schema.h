@@ -0,0 +1,11 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+
+bool MigrateSchema(sqlite3 *db);
+int GetSchemaVersion(sqlite3 *db);
+bool CheckTaskQueryPlans(sqlite3 *db);
+
+#endif
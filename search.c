@@ -0,0 +1,137 @@
+#include "search.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Called by SQLite every few thousand VM steps; a newer submit aborts the query
+static int AbortStaleSearch(void *arg) {
+    TaskSearch *search = arg;
+    return atomic_load(&search->generation) != search->searchedGeneration;
+}
+
+static void *SearchMain(void *arg) {
+    TaskSearch *search = arg;
+    // Filled unlocked, then swapped with the published results
+    TaskList found;
+    InitTaskList(&found);
+    char text[SEARCH_QUERY_LEN];
+
+    pthread_mutex_lock(&search->lock);
+    while (!search->quit) {
+        int generation = atomic_load(&search->generation);
+        if (generation == search->resultGeneration) {
+            pthread_cond_wait(&search->wake, &search->lock);
+            continue;
+        }
+        memcpy(text, search->query, sizeof(text));
+        search->searchedGeneration = generation;
+        pthread_mutex_unlock(&search->lock);
+
+        TruncateTaskList(&found, 0);
+        bool completed = SearchTasks(search->userId, text, &found, SEARCH_RESULT_LIMIT, search->db) >= 0;
+
+        pthread_mutex_lock(&search->lock);
+        if (!completed || generation != atomic_load(&search->generation)) {
+            // Superseded while running; drop it and pick up the newer query
+            search->cancelled++;
+            continue;
+        }
+        TaskList previous = search->results;
+        search->results = found;
+        found = previous;
+        search->resultGeneration = generation;
+        atomic_fetch_add(&search->changeCount, 1);
+    }
+    pthread_mutex_unlock(&search->lock);
+    FreeTaskList(&found);
+    return NULL;
+}
+
+TaskSearch *CreateTaskSearch(const char *path, int userId) {
+    TaskSearch *search = calloc(1, sizeof(TaskSearch));
+    if (search == NULL) {
+        return NULL;
+    }
+    search->db = OpenDatabase(path);
+    if (search->db == NULL) {
+        free(search);
+        return NULL;
+    }
+    search->userId = userId;
+    InitTaskList(&search->results);
+    sqlite3_progress_handler(search->db->handle, 1000, AbortStaleSearch, search);
+
+    pthread_mutex_init(&search->lock, NULL);
+    pthread_cond_init(&search->wake, NULL);
+    pthread_create(&search->thread, NULL, SearchMain, search);
+    return search;
+}
+
+void DestroyTaskSearch(TaskSearch *search) {
+    if (search == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&search->lock);
+    search->quit = true;
+    atomic_fetch_add(&search->generation, 1);
+    pthread_cond_signal(&search->wake);
+    pthread_mutex_unlock(&search->lock);
+    pthread_join(search->thread, NULL);
+
+    printf("Search: %ld stale queries cancelled\n", search->cancelled);
+    FreeTaskList(&search->results);
+    CloseDatabase(search->db);
+    pthread_cond_destroy(&search->wake);
+    pthread_mutex_destroy(&search->lock);
+    free(search);
+}
+
+void SubmitTaskSearch(TaskSearch *search, const char *text) {
+    pthread_mutex_lock(&search->lock);
+    snprintf(search->query, sizeof(search->query), "%s", text);
+    atomic_fetch_add(&search->generation, 1);
+    pthread_cond_signal(&search->wake);
+    pthread_mutex_unlock(&search->lock);
+}
+
+// Re-run the current query, e.g. after a mutation changed the matches
+void RefreshTaskSearch(TaskSearch *search) {
+    pthread_mutex_lock(&search->lock);
+    if (search->query[0] != '\0') {
+        atomic_fetch_add(&search->generation, 1);
+        pthread_cond_signal(&search->wake);
+    }
+    pthread_mutex_unlock(&search->lock);
+}
+
+// True once the results match the latest submitted query
+bool IsTaskSearchSettled(TaskSearch *search) {
+    pthread_mutex_lock(&search->lock);
+    bool settled = search->resultGeneration == atomic_load(&search->generation);
+    pthread_mutex_unlock(&search->lock);
+    return settled;
+}
+
+unsigned GetTaskSearchChangeCount(TaskSearch *search) {
+    return atomic_load(&search->changeCount);
+}
+
+void LockTaskSearch(TaskSearch *search) {
+    pthread_mutex_lock(&search->lock);
+}
+
+void UnlockTaskSearch(TaskSearch *search) {
+    pthread_mutex_unlock(&search->lock);
+}
+
+bool GetSearchResult(TaskSearch *search, int index, Task *task) {
+    if (index < 0 || index >= search->results.count) {
+        return false;
+    }
+    *task = GetTaskAt(&search->results, index);
+    return true;
+}
+
+int GetSearchResultCount(TaskSearch *search) {
+    return search->results.count;
+}
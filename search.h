@@ -0,0 +1,50 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "db.h"
+#include "taskstore.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define SEARCH_QUERY_LEN 256
+#define SEARCH_RESULT_LIMIT 500
+#define SEARCH_DEBOUNCE_SECONDS 0.15
+
+// Runs full-text searches over one user's task titles on its own thread and
+// connection. Only the newest query matters: submitting another one aborts a
+// search that is still running, and its results are never published.
+typedef struct {
+    Database *db;
+    int userId;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool quit;
+
+    char query[SEARCH_QUERY_LEN];   // Latest submitted query
+    atomic_int generation;          // Bumped on every submit
+    int searchedGeneration;
+
+    TaskList results;
+    int resultGeneration;           // Generation the results belong to
+    long cancelled;
+    atomic_uint changeCount;        // Bumped whenever new results are installed
+} TaskSearch;
+
+TaskSearch *CreateTaskSearch(const char *path, int userId);
+void DestroyTaskSearch(TaskSearch *search);
+void SubmitTaskSearch(TaskSearch *search, const char *text);
+void RefreshTaskSearch(TaskSearch *search);
+bool IsTaskSearchSettled(TaskSearch *search);
+unsigned GetTaskSearchChangeCount(TaskSearch *search);
+
+// GetSearchResult and GetSearchResultCount must be called between
+// LockTaskSearch/UnlockTaskSearch; titles are only valid until the unlock
+void LockTaskSearch(TaskSearch *search);
+void UnlockTaskSearch(TaskSearch *search);
+bool GetSearchResult(TaskSearch *search, int index, Task *task);
+int GetSearchResultCount(TaskSearch *search);
+
+#endif
@@ -0,0 +1,489 @@
+#include "server.h"
+#include "profile.h"
+#include "storage.h"
+#include "taskcore.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <openssl/crypto.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stopRequested;
+
+static void RequestStop(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+static void PutStatus(Connection *connection, WireStatus status) {
+    size_t start = BeginWireFrame(&connection->out);
+    PutWireU8(&connection->out, status);
+    EndWireFrame(&connection->out, start);
+}
+
+// Whatever is left over from a server that died is removed, but not a
+// socket someone still answers on, and never a file that isn't a socket
+static bool ListenOnSocket(TaskServer *server) {
+    const char *path = server->config.socketPath;
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+
+    struct stat info;
+    if (lstat(path, &info) == 0) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool answered = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (answered || !S_ISSOCK(info.st_mode)) {
+            printf("%s is %s\n", path, answered ? "already being served" : "not a socket");
+            return false;
+        }
+        unlink(path);
+    }
+
+    server->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listenFd < 0) {
+        printf("Failed to create socket: %s\n", strerror(errno));
+        return false;
+    }
+    // Only this user may connect
+    mode_t mask = umask(0077);
+    bool bound = bind(server->listenFd, (struct sockaddr *)&address, sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || listen(server->listenFd, SOMAXCONN) != 0) {
+        printf("Failed to listen on %s: %s\n", path, strerror(errno));
+        close(server->listenFd);
+        server->listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+static void CloseConnection(TaskServer *server, Connection *connection) {
+    if (connection->events != 0) {
+        epoll_ctl(server->epollFd, EPOLL_CTL_DEL, connection->fd, NULL);
+    }
+    close(connection->fd);
+    FreeWireBuffer(&connection->in);
+    FreeWireBuffer(&connection->out);
+    connection->fd = -1;
+    connection->events = 0;
+    connection->authId = 0;
+}
+
+static void AcceptConnections(TaskServer *server) {
+    for (;;) {
+        int fd = accept(server->listenFd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        Connection *connection = NULL;
+        for (int i = 0; i < SERVER_MAX_CONNECTIONS && connection == NULL; i++) {
+            if (server->connections[i].fd < 0) {
+                connection = &server->connections[i];
+            }
+        }
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+        if (connection == NULL || epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            server->stats.refused++;
+            continue;
+        }
+        *connection = (Connection){.fd = fd, .events = EPOLLIN, .userId = -1};
+        InitWireBuffer(&connection->in);
+        InitWireBuffer(&connection->out);
+        server->stats.connections++;
+    }
+}
+
+static void ReadConnection(Connection *connection) {
+    while (connection->in.length < SERVER_INPUT_LIMIT) {
+        if (!ReserveWireBuffer(&connection->in, SERVER_READ_CHUNK)) {
+            connection->dead = true;
+            return;
+        }
+        ssize_t received = recv(connection->fd, connection->in.data + connection->in.length, SERVER_READ_CHUNK, 0);
+        if (received > 0) {
+            connection->in.length += received;
+        } else if (received == 0) {
+            connection->readClosed = true;
+            return;
+        } else if (errno != EINTR) {
+            connection->dead = errno != EAGAIN && errno != EWOULDBLOCK;
+            return;
+        }
+    }
+}
+
+static void FlushConnection(Connection *connection) {
+    size_t sent = 0;
+    while (sent < connection->out.length) {
+        ssize_t count = send(connection->fd, connection->out.data + sent, connection->out.length - sent, MSG_NOSIGNAL);
+        if (count > 0) {
+            sent += count;
+        } else if (errno != EINTR) {
+            connection->dead = errno != EAGAIN && errno != EWOULDBLOCK;
+            break;
+        }
+    }
+    ConsumeWireBuffer(&connection->out, sent);
+}
+
+// Reads while there is room on both sides and writes while there is output.
+// A connection with neither is taken out of epoll altogether, or a peer that
+// hung up would wake every wait while its login finishes.
+static void UpdateInterest(TaskServer *server, Connection *connection) {
+    unsigned events = 0;
+    if (!connection->readClosed && connection->in.length < SERVER_INPUT_LIMIT &&
+        connection->out.length < SERVER_OUTPUT_LIMIT) {
+        events |= EPOLLIN;
+    }
+    if (connection->out.length > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events == connection->events) {
+        return;
+    }
+    struct epoll_event event = {.events = events, .data.ptr = connection};
+    int op = events == 0 ? EPOLL_CTL_DEL : connection->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(server->epollFd, op, connection->fd, &event) != 0) {
+        connection->dead = true;
+        return;
+    }
+    connection->events = events;
+}
+
+static void OnAuthResult(const AuthRequest *result, void *context) {
+    TaskServer *server = context;
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+        Connection *connection = &server->connections[i];
+        if (connection->fd < 0 || connection->authId != result->id) {
+            continue;
+        }
+        // A failed login leaves whoever was logged in before
+        int userId = result->ok ? FindUser(result->username, server->db) : -1;
+        if (userId >= 0) {
+            connection->userId = userId;
+        }
+        connection->authId = 0;
+        PutStatus(connection, userId >= 0 ? WIRE_OK : WIRE_FAILED);
+        return;
+    }
+}
+
+// A well-formed add, complete or delete, ready for the batch
+static bool ParseWrite(WireOp op, WireReader *reader, ServerWrite *write) {
+    write->op = op;
+    if (op == WIRE_ADD) {
+        GetWireString(reader, write->title, sizeof(write->title));
+        write->dueAt = 0;
+        write->repeatEvery = 0;
+        SplitTaskDue(write->title, time(NULL), &write->dueAt, &write->repeatEvery);
+        return IsWireReaderDone(reader) && write->title[0] != '\0';
+    }
+    if (op == WIRE_COMPLETE || op == WIRE_DELETE) {
+        unsigned id = GetWireU32(reader);
+        write->taskId = (int)id;
+        return IsWireReaderDone(reader) && id > 0 && id <= INT_MAX;
+    }
+    return false;
+}
+
+// Pages by the key itself rather than looking the task up, which another
+// connection may have deleted since
+static void ListPage(TaskServer *server, Connection *connection, WireReader *reader) {
+    double afterRank = GetWireF64(reader);
+    unsigned afterId = GetWireU32(reader);
+    unsigned limit = GetWireU16(reader);
+    if (!IsWireReaderDone(reader) || afterId > INT_MAX || isnan(afterRank)) {
+        PutStatus(connection, WIRE_BAD_REQUEST);
+        return;
+    }
+    if (limit == 0 || limit > SERVER_LIST_MAX) {
+        limit = SERVER_LIST_MAX;
+    }
+    TaskKey after = afterId == 0 ? TASK_KEY_FIRST : (TaskKey){afterRank, (int)afterId};
+
+    TaskList *tasks = &server->page;
+    int count = ListTasks(connection->userId, after, tasks, (int)limit, server->db);
+    size_t start = BeginWireFrame(&connection->out);
+    PutWireU8(&connection->out, WIRE_OK);
+    PutWireU16(&connection->out, (unsigned)count);
+    for (int i = 0; i < count; i++) {
+        Task task = GetTaskAt(tasks, i);
+        PutWireU32(&connection->out, (unsigned)task.id);
+        PutWireU8(&connection->out, task.completed);
+        PutWireI64(&connection->out, task.dueAt);
+        PutWireU32(&connection->out, (unsigned)task.repeatEvery);
+        PutWireString(&connection->out, task.title);
+    }
+    TaskKey next = count > 0 ? GetTaskKey(tasks, count - 1) : after;
+    PutWireF64(&connection->out, next.rank);
+    PutWireU32(&connection->out, (unsigned)next.id);
+    EndWireFrame(&connection->out, start);
+    TruncateTaskList(tasks, 0);
+}
+
+// Everything but a logged-in connection's well-formed writes, which wait
+// for the batch instead
+static void AnswerRequest(TaskServer *server, Connection *connection, const unsigned char *payload, size_t length) {
+    WireReader reader;
+    InitWireReader(&reader, payload, length);
+    WireOp op = GetWireU8(&reader);
+    if (op == WIRE_REGISTER || op == WIRE_LOGIN) {
+        AuthRequest request = {.type = op == WIRE_REGISTER ? AUTH_REGISTER : AUTH_LOGIN};
+        GetWireString(&reader, request.username, sizeof(request.username));
+        GetWireString(&reader, request.password, sizeof(request.password));
+        if (!IsWireReaderDone(&reader) || request.username[0] == '\0' || request.password[0] == '\0') {
+            PutStatus(connection, WIRE_BAD_REQUEST);
+        } else if ((connection->authId = SubmitAuthRequest(server->auth, &request)) == 0) {
+            PutStatus(connection, WIRE_BUSY);
+        }
+        OPENSSL_cleanse(request.password, sizeof(request.password));
+    } else if (op < WIRE_REGISTER || op > WIRE_DELETE) {
+        PutStatus(connection, WIRE_BAD_REQUEST);
+    } else if (connection->userId < 0) {
+        PutStatus(connection, WIRE_NOT_LOGGED_IN);
+    } else if (op == WIRE_LIST) {
+        ListPage(server, connection, &reader);
+    } else {
+        PutStatus(connection, WIRE_BAD_REQUEST);
+    }
+}
+
+// Takes a connection's complete requests in order. Writes join the open
+// batch; anything answered on the spot waits until the writes before it
+// have been answered, and nothing moves past a login on the pool. Returns
+// how many requests were taken.
+static int ServeConnection(TaskServer *server, Connection *connection) {
+    int served = 0;
+    while (!connection->dead && connection->authId == 0 && connection->out.length < SERVER_OUTPUT_LIMIT) {
+        long frame = PeekWireFrame(connection->in.data, connection->in.length, WIRE_MAX_REQUEST);
+        if (frame < 0) {
+            connection->dead = true;
+            break;
+        }
+        if (frame == 0) {
+            break;
+        }
+        const unsigned char *payload = connection->in.data + WIRE_HEADER_LEN;
+        size_t length = frame - WIRE_HEADER_LEN;
+
+        WireReader reader;
+        InitWireReader(&reader, payload, length);
+        ServerWrite write;
+        WireOp op = GetWireU8(&reader);
+        if (connection->userId >= 0 && ParseWrite(op, &reader, &write)) {
+            if (server->batchCount == server->config.maxBatch) {
+                break;
+            }
+            write.connection = connection;
+            server->batch[server->batchCount++] = write;
+            connection->queuedWrites++;
+        } else if (connection->queuedWrites > 0) {
+            break;
+        } else {
+            AnswerRequest(server, connection, payload, length);
+        }
+        ConsumeWireBuffer(&connection->in, frame);
+        server->stats.requests++;
+        served++;
+    }
+    return served;
+}
+
+// One transaction for every write in the batch, then their responses. A
+// write that finds no task fails on its own; when the commit fails, every
+// write in it does.
+static void CommitWrites(TaskServer *server) {
+    if (server->batchCount == 0) {
+        return;
+    }
+    long long start = ProfileNow();
+    bool committed = RunStatement(server->db, STMT_BEGIN);
+    if (committed) {
+        for (int i = 0; i < server->batchCount; i++) {
+            ServerWrite *write = &server->batch[i];
+            int userId = write->connection->userId;
+            if (write->op == WIRE_ADD) {
+                TaskKey key;
+                write->ok = AddTask(userId, write->title, write->dueAt, write->repeatEvery, &key, server->db);
+                write->taskId = write->ok ? key.id : 0;
+            } else if (write->op == WIRE_COMPLETE) {
+                write->ok = MarkTaskComplete(userId, write->taskId, server->db);
+            } else {
+                write->ok = DeleteTask(userId, write->taskId, server->db);
+            }
+        }
+        committed = RunStatement(server->db, STMT_COMMIT);
+        if (!committed) {
+            RunStatement(server->db, STMT_ROLLBACK);
+        }
+    }
+    EndProfileZone("server", "commit", start);
+
+    server->stats.commits++;
+    server->stats.writes += server->batchCount;
+    if (server->batchCount > server->stats.largestBatch) {
+        server->stats.largestBatch = server->batchCount;
+    }
+    if (!committed) {
+        server->stats.failedCommits++;
+    }
+    for (int i = 0; i < server->batchCount; i++) {
+        ServerWrite *write = &server->batch[i];
+        Connection *connection = write->connection;
+        connection->queuedWrites--;
+        size_t frame = BeginWireFrame(&connection->out);
+        PutWireU8(&connection->out, !committed ? WIRE_BUSY : write->ok ? WIRE_OK : WIRE_FAILED);
+        if (committed && write->ok && write->op == WIRE_ADD) {
+            PutWireU32(&connection->out, (unsigned)write->taskId);
+        }
+        EndWireFrame(&connection->out, frame);
+    }
+    server->batchCount = 0;
+}
+
+// Serves and commits until no connection has a request it can take
+static void ServeConnections(TaskServer *server) {
+    int served;
+    do {
+        served = 0;
+        for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+            if (server->connections[i].fd >= 0) {
+                served += ServeConnection(server, &server->connections[i]);
+            }
+        }
+        CommitWrites(server);
+    } while (served > 0);
+}
+
+static void FinishRound(TaskServer *server) {
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+        Connection *connection = &server->connections[i];
+        if (connection->fd < 0) {
+            continue;
+        }
+        if (!connection->dead && connection->out.length > 0) {
+            FlushConnection(connection);
+        }
+        bool finished = connection->readClosed && connection->authId == 0 && connection->out.length == 0 &&
+                        PeekWireFrame(connection->in.data, connection->in.length, WIRE_MAX_REQUEST) == 0;
+        if (!connection->dead && !finished) {
+            UpdateInterest(server, connection);
+        }
+        if (connection->dead || finished || connection->in.failed || connection->out.failed) {
+            CloseConnection(server, connection);
+        }
+    }
+}
+
+static void PrintServerStats(const TaskServer *server) {
+    const ServerStats *stats = &server->stats;
+    printf("Server: %ld connections (%ld refused), %ld requests\n", stats->connections, stats->refused, stats->requests);
+    printf("Server: %ld writes in %ld commits (%.1f per commit, at most %d), %ld failed commits\n", stats->writes,
+           stats->commits, stats->commits > 0 ? (double)stats->writes / stats->commits : 0.0, stats->largestBatch,
+           stats->failedCommits);
+}
+
+bool RunTaskServer(const ServerConfig *config) {
+    TaskServer *server = calloc(1, sizeof(TaskServer));
+    if (server == NULL) {
+        return false;
+    }
+    server->config = *config;
+    server->listenFd = -1;
+    server->epollFd = -1;
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+        server->connections[i].fd = -1;
+    }
+    InitTaskList(&server->page);
+
+    // Signals are left to this thread, since the pools' threads inherit the
+    // mask; there is no SA_RESTART, so they wake epoll_wait
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    struct sigaction stop = {.sa_handler = RequestStop};
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+    server->db = OpenDatabase(config->dbPath);
+    server->auth = server->db != NULL ? CreateAuthPool(config->dbPath, GetStorageConfig()->authThreads, OnAuthResult, server) : NULL;
+    server->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event listenEvent = {.events = EPOLLIN, .data.ptr = NULL};
+    bool started = server->auth != NULL && server->epollFd >= 0 && ListenOnSocket(server) &&
+                   epoll_ctl(server->epollFd, EPOLL_CTL_ADD, server->listenFd, &listenEvent) == 0;
+    Checkpointer *checkpointer = started ? StartCheckpointer(config->dbPath) : NULL;
+    pthread_sigmask(SIG_UNBLOCK, &stopSignals, NULL);
+    if (started) {
+        printf("Serving %s on %s\n", config->dbPath, config->socketPath);
+        fflush(stdout);
+    }
+
+    struct epoll_event events[SERVER_EPOLL_EVENTS];
+    while (started && !stopRequested) {
+        int timeout = IsAuthPoolBusy(server->auth) ? SERVER_AUTH_POLL_MS : -1;
+        int count = epoll_wait(server->epollFd, events, SERVER_EPOLL_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) {
+            printf("epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            Connection *connection = events[i].data.ptr;
+            if (connection == NULL) {
+                AcceptConnections(server);
+            } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                // A hangup reads as end of stream, after anything still buffered
+                ReadConnection(connection);
+            }
+        }
+        DispatchAuthResults(server->auth, AUTH_QUEUE_SIZE);
+        ServeConnections(server);
+        FinishRound(server);
+    }
+
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+        if (server->connections[i].fd >= 0) {
+            CloseConnection(server, &server->connections[i]);
+        }
+    }
+    if (server->listenFd >= 0) {
+        close(server->listenFd);
+        unlink(config->socketPath);
+    }
+    if (server->epollFd >= 0) {
+        close(server->epollFd);
+    }
+    StopCheckpointer(checkpointer);
+    DestroyAuthPool(server->auth);
+    if (started) {
+        PrintServerStats(server);
+        PrintDatabaseStats(server->db);
+    }
+    if (server->db != NULL) {
+        CloseDatabase(server->db);
+    }
+    FreeTaskList(&server->page);
+    free(server);
+    return started;
+}
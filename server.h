@@ -0,0 +1,80 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "authpool.h"
+#include "db.h"
+#include "dbworker.h"
+#include "tasklist.h"
+#include "taskwire.h"
+#include <stdbool.h>
+
+#define SERVER_MAX_CONNECTIONS 256
+#define SERVER_BATCH_MAX 256             // Writes per group commit
+#define SERVER_LIST_MAX 512              // Tasks per LIST response
+#define SERVER_READ_CHUNK 16384
+#define SERVER_INPUT_LIMIT (64 * 1024)   // A connection isn't read past this much unparsed input...
+#define SERVER_OUTPUT_LIMIT (256 * 1024) // ...or this much unsent output
+#define SERVER_EPOLL_EVENTS 64
+#define SERVER_AUTH_POLL_MS 1            // epoll timeout while logins are on the pool
+
+typedef struct {
+    const char *dbPath;
+    const char *socketPath;
+    int maxBatch;          // Writes per transaction; 1 commits each on its own
+} ServerConfig;
+
+typedef struct {
+    long connections;
+    long refused;          // Past SERVER_MAX_CONNECTIONS
+    long requests;
+    long commits;
+    long writes;           // Committed, or failed with their commit
+    int largestBatch;
+    long failedCommits;
+} ServerStats;
+
+typedef struct {
+    int fd;                // -1 for a free slot
+    unsigned events;       // Registered with epoll; 0 while not registered
+    WireBuffer in;
+    WireBuffer out;
+    int userId;            // -1 until logged in
+    unsigned authId;       // Register/login still on the pool, or 0
+    int queuedWrites;      // In the open batch
+    bool readClosed;       // Peer shut its side; answer what it sent, then close
+    bool dead;             // Closed at the end of the round
+} Connection;
+
+typedef struct {
+    Connection *connection;
+    WireOp op;
+    int taskId;            // Complete/delete, or the id an add got
+    char title[DB_JOB_TEXT_LEN];
+    long long dueAt;
+    int repeatEvery;
+    bool ok;
+} ServerWrite;
+
+// The task operations over a Unix socket, speaking the taskwire protocol.
+// One thread runs an epoll loop; each round it reads whatever arrived,
+// answers every complete request, and runs all the writes those requests
+// made as one transaction before sending their responses, so concurrent
+// clients share a commit. Logins and registrations go to an AuthPool, and
+// a connection's later requests wait until its KDF is done.
+typedef struct {
+    ServerConfig config;
+    Database *db;
+    AuthPool *auth;
+    int listenFd;
+    int epollFd;
+    Connection connections[SERVER_MAX_CONNECTIONS];
+    ServerWrite batch[SERVER_BATCH_MAX];
+    int batchCount;
+    TaskList page;         // Reused by every LIST
+    ServerStats stats;
+} TaskServer;
+
+// Serves until SIGINT or SIGTERM. Returns false if it couldn't start.
+bool RunTaskServer(const ServerConfig *config);
+
+#endif
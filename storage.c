@@ -0,0 +1,207 @@
+#include "storage.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define CHECKPOINT_POLL_MS 250
+
+static StorageConfig activeConfig;
+static bool activeConfigSet = false;
+
+StorageConfig DefaultStorageConfig(void) {
+    StorageConfig config = {
+        .walMode = true,
+        .synchronous = 1,
+        .cacheSizeKb = 8192,
+        .mmapSizeBytes = 64LL * 1024 * 1024,
+        .checkpointPages = 1000,
+        .checkpointIntervalMs = 5000,
+        .busyTimeoutMs = 5000,
+        .passwordIterations = 600000,
+        .authThreads = 0,
+    };
+    return config;
+}
+
+// Read "key = value" lines over the defaults in *config. A missing file is
+// not an error; unknown keys are reported and skipped.
+bool LoadStorageConfig(const char *path, StorageConfig *config) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return errno == ENOENT;
+    }
+
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        char key[64];
+        long long value;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, " %63[a-z_] = %lld", key, &value) != 2) {
+            printf("%s:%d: expected key = value\n", path, lineNumber);
+            continue;
+        }
+
+        if (strcmp(key, "wal") == 0) config->walMode = value != 0;
+        else if (strcmp(key, "synchronous") == 0) config->synchronous = (int)value;
+        else if (strcmp(key, "cache_size_kb") == 0) config->cacheSizeKb = (int)value;
+        else if (strcmp(key, "mmap_size") == 0) config->mmapSizeBytes = value;
+        else if (strcmp(key, "checkpoint_pages") == 0) config->checkpointPages = (int)value;
+        else if (strcmp(key, "checkpoint_interval_ms") == 0) config->checkpointIntervalMs = (int)value;
+        else if (strcmp(key, "busy_timeout_ms") == 0) config->busyTimeoutMs = (int)value;
+        else if (strcmp(key, "password_iterations") == 0) config->passwordIterations = (int)value;
+        else if (strcmp(key, "auth_threads") == 0) config->authThreads = (int)value;
+        else printf("%s:%d: unknown setting '%s'\n", path, lineNumber, key);
+    }
+    fclose(file);
+    return true;
+}
+
+void SetStorageConfig(const StorageConfig *config) {
+    activeConfig = *config;
+    activeConfigSet = true;
+}
+
+const StorageConfig *GetStorageConfig(void) {
+    if (!activeConfigSet) {
+        activeConfig = DefaultStorageConfig();
+        activeConfigSet = true;
+    }
+    return &activeConfig;
+}
+
+bool ApplyStorageConfig(sqlite3 *db, const StorageConfig *config) {
+    // SQLite still checkpoints on commit past this size, as a backstop for
+    // processes that don't run a Checkpointer
+    int autoCheckpoint = config->checkpointPages * 4;
+    char pragmas[512];
+    snprintf(pragmas, sizeof(pragmas),
+             "PRAGMA journal_mode = %s;"
+             "PRAGMA synchronous = %d;"
+             "PRAGMA cache_size = -%d;"
+             "PRAGMA mmap_size = %lld;"
+             "PRAGMA wal_autocheckpoint = %d;",
+             config->walMode ? "WAL" : "DELETE", config->synchronous,
+             config->cacheSizeKb, config->mmapSizeBytes, autoCheckpoint);
+
+    sqlite3_busy_timeout(db, config->busyTimeoutMs);
+    if (sqlite3_exec(db, pragmas, NULL, NULL, NULL) != SQLITE_OK) {
+        printf("Failed to apply storage settings: %s\n", sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+static long long WalSize(const Checkpointer *checkpointer) {
+    struct stat info;
+    return stat(checkpointer->walPath, &info) == 0 ? (long long)info.st_size : 0;
+}
+
+static void *CheckpointerMain(void *arg) {
+    Checkpointer *checkpointer = arg;
+    long long pageSize = 4096;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(checkpointer->handle, "PRAGMA page_size;", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            pageSize = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    long long threshold = checkpointer->config.checkpointPages * pageSize;
+    double lastCheckpoint = 0;
+
+    pthread_mutex_lock(&checkpointer->lock);
+    while (!checkpointer->quit) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += CHECKPOINT_POLL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&checkpointer->wake, &checkpointer->lock, &deadline);
+        if (checkpointer->quit) {
+            break;
+        }
+        pthread_mutex_unlock(&checkpointer->lock);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double nowMs = now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+        long long walSize = WalSize(checkpointer);
+        bool due = walSize >= threshold ||
+                   (walSize > 0 && nowMs - lastCheckpoint >= checkpointer->config.checkpointIntervalMs);
+
+        int frames = 0;
+        int checkpointed = 0;
+        if (due) {
+            // PASSIVE never waits on readers or writers; if the WAL has grown
+            // far past the threshold, RESTART so it starts over from the top
+            int mode = walSize >= threshold * 4 ? SQLITE_CHECKPOINT_RESTART : SQLITE_CHECKPOINT_PASSIVE;
+            sqlite3_wal_checkpoint_v2(checkpointer->handle, NULL, mode, &frames, &checkpointed);
+            lastCheckpoint = nowMs;
+        }
+
+        pthread_mutex_lock(&checkpointer->lock);
+        if (due) {
+            checkpointer->stats.checkpoints++;
+            checkpointer->stats.framesCheckpointed += checkpointed;
+        }
+    }
+    pthread_mutex_unlock(&checkpointer->lock);
+    return NULL;
+}
+
+// Returns NULL when the database isn't in WAL mode; there is nothing to do
+Checkpointer *StartCheckpointer(const char *path) {
+    const StorageConfig *config = GetStorageConfig();
+    if (!config->walMode) {
+        return NULL;
+    }
+
+    Checkpointer *checkpointer = calloc(1, sizeof(Checkpointer));
+    if (checkpointer == NULL) {
+        return NULL;
+    }
+    if (sqlite3_open(path, &checkpointer->handle) != SQLITE_OK) {
+        printf("Failed to open database: %s\n", sqlite3_errmsg(checkpointer->handle));
+        sqlite3_close(checkpointer->handle);
+        free(checkpointer);
+        return NULL;
+    }
+    sqlite3_busy_timeout(checkpointer->handle, 1000);
+    // A connection only notices WAL mode once it has read the database;
+    // until then every checkpoint is a no-op that reports -1 frames
+    sqlite3_exec(checkpointer->handle, "SELECT 1 FROM sqlite_master LIMIT 1;", NULL, NULL, NULL);
+
+    snprintf(checkpointer->walPath, sizeof(checkpointer->walPath), "%s-wal", path);
+    checkpointer->config = *config;
+    pthread_mutex_init(&checkpointer->lock, NULL);
+    pthread_cond_init(&checkpointer->wake, NULL);
+    pthread_create(&checkpointer->thread, NULL, CheckpointerMain, checkpointer);
+    return checkpointer;
+}
+
+void StopCheckpointer(Checkpointer *checkpointer) {
+    if (checkpointer == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&checkpointer->lock);
+    checkpointer->quit = true;
+    pthread_cond_signal(&checkpointer->wake);
+    pthread_mutex_unlock(&checkpointer->lock);
+    pthread_join(checkpointer->thread, NULL);
+
+    printf("Checkpoints: %ld run, %ld frames written back\n",
+           checkpointer->stats.checkpoints, checkpointer->stats.framesCheckpointed);
+    sqlite3_close(checkpointer->handle);
+    pthread_cond_destroy(&checkpointer->wake);
+    pthread_mutex_destroy(&checkpointer->lock);
+    free(checkpointer);
+}
@@ -0,0 +1,49 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <sqlite3.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+// Connection-level storage settings, applied by OpenDatabase to every
+// connection the process opens, plus the account-hashing cost that is
+// deployed alongside them. Override them with a key = value file.
+typedef struct {
+    bool walMode;
+    int synchronous;            // 0 OFF, 1 NORMAL, 2 FULL
+    int cacheSizeKb;
+    long long mmapSizeBytes;
+    int checkpointPages;        // Background checkpoint once the WAL is this big
+    int checkpointIntervalMs;   // ...or this long after the last one
+    int busyTimeoutMs;          // How long a statement waits on another connection's lock
+    int passwordIterations;     // PBKDF2-HMAC-SHA256 rounds for new hashes
+    int authThreads;            // Auth pool size; 0 for one per core
+} StorageConfig;
+
+typedef struct {
+    long checkpoints;
+    long framesCheckpointed;
+} CheckpointStats;
+
+// Checkpoints the WAL from its own connection so writers never stall on it
+typedef struct {
+    char walPath[1024];
+    sqlite3 *handle;
+    StorageConfig config;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool quit;
+    CheckpointStats stats;
+} Checkpointer;
+
+StorageConfig DefaultStorageConfig(void);
+bool LoadStorageConfig(const char *path, StorageConfig *config);
+void SetStorageConfig(const StorageConfig *config);
+const StorageConfig *GetStorageConfig(void);
+bool ApplyStorageConfig(sqlite3 *db, const StorageConfig *config);
+
+Checkpointer *StartCheckpointer(const char *path);
+void StopCheckpointer(Checkpointer *checkpointer);
+
+#endif
@@ -0,0 +1,313 @@
+#include "db.h"
+#include "schema.h"
+#include "storage.h"
+#include "taskcore.h"
+#include "taskio.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_DB_PATH "users.db"
+#define LIST_BATCH_SIZE 512
+
+void PrintUsage(const char *program);
+int AddCommand(Database *db, const char *username, char *title);
+int ListCommand(Database *db, const char *username);
+int ChangeCommand(Database *db, const char *command, const char *username, const char *taskId);
+int DueCommand(Database *db, const char *username, const char *taskId, const char *spec);
+int StatsCommand(Database *db, const char *username);
+int ImportCommand(Database *db, const char *username, const char *path, TaskFormat format);
+int ExportCommand(Database *db, const char *username, const char *path, TaskFormat format);
+
+int main(int argc, char **argv) {
+    const char *dbPath = DEFAULT_DB_PATH;
+    const char *formatName = NULL;
+    char *args[4] = {NULL, NULL, NULL, NULL};
+    int argCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            dbPath = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            formatName = argv[++i];
+        } else if (argCount < 4) {
+            args[argCount++] = argv[i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    // verify and verify-plans take nothing, list and stats USERNAME, due
+    // USERNAME TASK_ID SPEC, every other command USERNAME and one more argument
+    const char *command = args[0];
+    bool isVerifyPlans = command != NULL && strcmp(command, "verify-plans") == 0;
+    bool isVerify = isVerifyPlans || (command != NULL && strcmp(command, "verify") == 0);
+    bool isList = command != NULL && strcmp(command, "list") == 0;
+    bool isStats = command != NULL && strcmp(command, "stats") == 0;
+    bool isDue = command != NULL && strcmp(command, "due") == 0;
+    if (argCount != (isVerify ? 1 : isList || isStats ? 2 : isDue ? 4 : 3)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const char *username = args[1];
+    const char *path = args[2];
+    TaskFormat format = path == NULL ? TASK_FORMAT_CSV : GuessTaskFormat(path);
+    if (formatName != NULL) {
+        if (strcmp(formatName, "csv") == 0) {
+            format = TASK_FORMAT_CSV;
+        } else if (strcmp(formatName, "jsonl") == 0) {
+            format = TASK_FORMAT_JSONL;
+        } else {
+            printf("Unknown format '%s'\n", formatName);
+            return 1;
+        }
+    }
+
+    StorageConfig storageConfig = DefaultStorageConfig();
+    LoadStorageConfig("storage.conf", &storageConfig);
+    SetStorageConfig(&storageConfig);
+
+    Database *db = OpenDatabase(dbPath);
+    if (db == NULL) {
+        return 1;
+    }
+
+    int status;
+    if (strcmp(command, "add") == 0) {
+        status = AddCommand(db, username, args[2]);
+    } else if (isList) {
+        status = ListCommand(db, username);
+    } else if (strcmp(command, "complete") == 0 || strcmp(command, "uncomplete") == 0 || strcmp(command, "delete") == 0) {
+        status = ChangeCommand(db, command, username, args[2]);
+    } else if (isStats) {
+        status = StatsCommand(db, username);
+    } else if (isVerifyPlans) {
+        // Exits 1 when a per-user query would scan or sort every user's rows
+        status = CheckTaskQueryPlans(db->handle) ? 0 : 1;
+    } else if (isVerify) {
+        // Exits 1 when a stored count has drifted from the rows
+        status = VerifyTaskCounts(db) == 0 ? 0 : 1;
+    } else if (isDue) {
+        status = DueCommand(db, username, args[2], args[3]);
+    } else if (strcmp(command, "import") == 0) {
+        status = ImportCommand(db, username, path, format);
+    } else if (strcmp(command, "export") == 0) {
+        status = ExportCommand(db, username, path, format);
+    } else {
+        PrintUsage(argv[0]);
+        status = 1;
+    }
+
+    CloseDatabase(db);
+    return status;
+}
+
+void PrintUsage(const char *program) {
+    printf("usage: %s [--db PATH] add USERNAME TITLE[ @DUE]\n", program);
+    printf("       %s [--db PATH] list|stats USERNAME\n", program);
+    printf("       %s [--db PATH] complete|uncomplete|delete USERNAME TASK_ID[-LAST_ID]\n", program);
+    printf("       %s [--db PATH] due USERNAME TASK_ID DUE|none\n", program);
+    printf("       %s [--db PATH] [--format csv|jsonl] import USERNAME FILE\n", program);
+    printf("       %s [--db PATH] [--format csv|jsonl] export USERNAME FILE\n", program);
+    printf("       %s [--db PATH] verify|verify-plans\n", program);
+    printf("LAST_ID makes a range, from TASK_ID through LAST_ID as listed, changed in one transaction.\n");
+    printf("DUE is +N[mhdw], YYYY-MM-DD or YYYY-MM-DDTHH:MM, optionally /N[mhdw] to repeat.\n");
+    printf("FILE may be - for stdin/stdout; the format defaults from its extension.\n");
+    printf("verify checks the stored task counts, verify-plans that task queries use an index.\n");
+}
+
+int AddCommand(Database *db, const char *username, char *title) {
+    int userId = FindOrCreateUser(username, db);
+    if (userId < 0) {
+        printf("Failed to find user '%s'\n", username);
+        return 1;
+    }
+    long long dueAt = 0;
+    int repeatEvery = 0;
+    SplitTaskDue(title, time(NULL), &dueAt, &repeatEvery);
+    TaskKey key;
+    if (title[0] == '\0' || !AddTask(userId, title, dueAt, repeatEvery, &key, db)) {
+        printf("Failed to add task\n");
+        return 1;
+    }
+    printf("%d\n", key.id);
+    return 0;
+}
+
+// One task per line: id, [x] or [ ], title, then the due date if it has one
+int ListCommand(Database *db, const char *username) {
+    int userId = FindUser(username, db);
+    if (userId < 0) {
+        printf("No such user '%s'\n", username);
+        return 1;
+    }
+
+    static char buffer[IMPORT_CHUNK_SIZE];
+    setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+
+    TaskList tasks;
+    InitTaskList(&tasks);
+    TaskKey last = TASK_KEY_FIRST;
+    int count;
+    while ((count = ListTasks(userId, last, &tasks, LIST_BATCH_SIZE, db)) > 0) {
+        for (int i = 0; i < count; i++) {
+            Task task = GetTaskAt(&tasks, i);
+            printf("%d\t[%c]\t%s", task.id, task.completed ? 'x' : ' ', task.title);
+            if (task.dueAt > 0) {
+                char due[TASK_DUE_LEN];
+                FormatTaskDue(task.dueAt, task.repeatEvery, due, sizeof(due));
+                printf("\tdue %s", due);
+            }
+            putchar('\n');
+        }
+        last = GetTaskKey(&tasks, count - 1);
+        TruncateTaskList(&tasks, 0);
+    }
+    FreeTaskList(&tasks);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
+
+// A single id goes through the one-row statements; a range, and uncomplete,
+// through the bulk ones. FIRST-LAST covers the tasks listed from FIRST
+// through LAST.
+int ChangeCommand(Database *db, const char *command, const char *username, const char *taskId) {
+    char *end;
+    long id = strtol(taskId, &end, 10);
+    long lastId = id;
+    if (*end == '-' && end[1] != '\0') {
+        lastId = strtol(end + 1, &end, 10);
+    }
+    if (*taskId == '\0' || *end != '\0' || id <= 0 || id > INT_MAX || lastId <= 0 || lastId > INT_MAX) {
+        printf("Invalid task id '%s'\n", taskId);
+        return 1;
+    }
+    int userId = FindUser(username, db);
+    if (userId < 0) {
+        printf("No such user '%s'\n", username);
+        return 1;
+    }
+
+    bool uncomplete = strcmp(command, "uncomplete") == 0;
+    if (lastId != id || uncomplete) {
+        TaskSpan span;
+        long missing = !FindTaskKey(userId, (int)id, &span.first, db) ? id
+                     : !FindTaskKey(userId, (int)lastId, &span.last, db) ? lastId : 0;
+        if (missing != 0) {
+            printf("No task %ld for '%s'\n", missing, username);
+            return 1;
+        }
+        if (CompareTaskKeys(span.first, span.last) > 0) {
+            TaskKey swap = span.first;
+            span.first = span.last;
+            span.last = swap;
+        }
+        int changed = strcmp(command, "delete") == 0 ? DeleteTasks(userId, &span, 1, db)
+                                                     : SetTasksCompleted(userId, &span, 1, !uncomplete, db);
+        if (changed < 0) {
+            return 1;
+        }
+        printf("%d\n", changed);
+        return 0;
+    }
+
+    bool changed = strcmp(command, "complete") == 0 ? MarkTaskComplete(userId, (int)id, db)
+                                                    : DeleteTask(userId, (int)id, db);
+    if (!changed) {
+        printf("No task %ld for '%s'\n", id, username);
+        return 1;
+    }
+    return 0;
+}
+
+int DueCommand(Database *db, const char *username, const char *taskId, const char *spec) {
+    char *end;
+    long id = strtol(taskId, &end, 10);
+    if (*taskId == '\0' || *end != '\0' || id <= 0 || id > INT_MAX) {
+        printf("Invalid task id '%s'\n", taskId);
+        return 1;
+    }
+    long long dueAt;
+    int repeatEvery;
+    if (!ParseTaskDue(spec, time(NULL), &dueAt, &repeatEvery)) {
+        printf("Invalid due date '%s'\n", spec);
+        return 1;
+    }
+    int userId = FindUser(username, db);
+    if (userId < 0) {
+        printf("No such user '%s'\n", username);
+        return 1;
+    }
+    if (!SetTaskDue(userId, (int)id, dueAt, repeatEvery, db)) {
+        printf("No task %ld for '%s'\n", id, username);
+        return 1;
+    }
+    return 0;
+}
+
+int StatsCommand(Database *db, const char *username) {
+    int userId = FindUser(username, db);
+    if (userId < 0) {
+        printf("No such user '%s'\n", username);
+        return 1;
+    }
+    TaskCounts counts;
+    if (!ReadTaskCounts(userId, time(NULL), &counts, db)) {
+        printf("No task counts for '%s'\n", username);
+        return 1;
+    }
+    printf("total\t%d\nopen\t%d\ncompleted\t%d\noverdue\t%d\n", counts.total,
+           counts.total - counts.completed, counts.completed, counts.overdue);
+    return 0;
+}
+
+int ImportCommand(Database *db, const char *username, const char *path, TaskFormat format) {
+    int userId = FindOrCreateUser(username, db);
+    if (userId < 0) {
+        printf("Failed to find user '%s'\n", username);
+        return 1;
+    }
+
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (in == NULL) {
+        printf("Failed to open %s\n", path);
+        return 1;
+    }
+
+    TransferStats stats;
+    bool ok = ImportTasks(db, userId, in, format, &stats);
+    if (in != stdin) {
+        fclose(in);
+    }
+    PrintTransferStats("Imported", &stats);
+    return ok ? 0 : 1;
+}
+
+int ExportCommand(Database *db, const char *username, const char *path, TaskFormat format) {
+    int userId = FindUser(username, db);
+    if (userId < 0) {
+        printf("No such user '%s'\n", username);
+        return 1;
+    }
+
+    bool toStdout = strcmp(path, "-") == 0;
+    FILE *out = toStdout ? stdout : fopen(path, "wb");
+    if (out == NULL) {
+        printf("Failed to open %s\n", path);
+        return 1;
+    }
+    static char buffer[IMPORT_CHUNK_SIZE];
+    setvbuf(out, buffer, _IOFBF, sizeof(buffer));
+
+    TransferStats stats;
+    bool ok = ExportTasks(db, userId, out, format, &stats);
+    if (!toStdout) {
+        ok = fclose(out) == 0 && ok;
+        PrintTransferStats("Exported", &stats);
+    } else {
+        fprintf(stderr, "Exported %ld tasks\n", stats.rows);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,765 @@
+#include "taskcore.h"
+#include "storage.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+static void HexEncode(const unsigned char *bytes, size_t size, char *hex) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; i++) {
+        hex[i * 2] = digits[bytes[i] >> 4];
+        hex[i * 2 + 1] = digits[bytes[i] & 15];
+    }
+    hex[size * 2] = '\0';
+}
+
+// Decodes exactly size bytes of lowercase hex; anything else is rejected
+static bool HexDecode(const char *hex, unsigned char *bytes, size_t size) {
+    for (size_t i = 0; i < size * 2; i++) {
+        char c = hex[i];
+        int nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (nibble < 0) {
+            return false;
+        }
+        bytes[i / 2] = (unsigned char)(i % 2 == 0 ? nibble << 4 : bytes[i / 2] | nibble);
+    }
+    return true;
+}
+
+static bool DeriveKey(const char *password, int iterations, const unsigned char *salt, unsigned char *key) {
+    return PKCS5_PBKDF2_HMAC(password, (int)strlen(password), salt, PASSWORD_SALT_LEN, iterations,
+                             EVP_sha256(), PASSWORD_KEY_LEN, key) == 1;
+}
+
+bool HashPassword(const char *password, int iterations, char *encoded) {
+    unsigned char salt[PASSWORD_SALT_LEN];
+    unsigned char key[PASSWORD_KEY_LEN];
+    if (iterations < 1 || RAND_bytes(salt, sizeof(salt)) != 1 || !DeriveKey(password, iterations, salt, key)) {
+        return false;
+    }
+
+    char saltHex[PASSWORD_SALT_LEN * 2 + 1];
+    char keyHex[PASSWORD_KEY_LEN * 2 + 1];
+    HexEncode(salt, sizeof(salt), saltHex);
+    HexEncode(key, sizeof(key), keyHex);
+    snprintf(encoded, PASSWORD_HASH_LEN, PASSWORD_SCHEME "$%d$%s$%s", iterations, saltHex, keyHex);
+    OPENSSL_cleanse(key, sizeof(key));
+    return true;
+}
+
+bool VerifyPassword(const char *password, const char *encoded, int iterations, bool *stale) {
+    unsigned char expected[PASSWORD_KEY_LEN];
+    unsigned char actual[PASSWORD_KEY_LEN];
+    *stale = false;
+
+    // Rows written before the KDF hold a bare unsalted SHA-256
+    if (strlen(encoded) == SHA256_DIGEST_LENGTH * 2) {
+        if (!HexDecode(encoded, expected, SHA256_DIGEST_LENGTH)) {
+            return false;
+        }
+        SHA256((const unsigned char *)password, strlen(password), actual);
+        *stale = true;
+        return CRYPTO_memcmp(expected, actual, SHA256_DIGEST_LENGTH) == 0;
+    }
+
+    // scheme$iterations$salt$key
+    const char *scheme = PASSWORD_SCHEME "$";
+    if (strncmp(encoded, scheme, strlen(scheme)) != 0) {
+        return false;
+    }
+    char *end;
+    long rounds = strtol(encoded + strlen(scheme), &end, 10);
+    unsigned char salt[PASSWORD_SALT_LEN];
+    if (rounds < 1 || rounds > INT_MAX || *end != '$' || !HexDecode(end + 1, salt, sizeof(salt))) {
+        return false;
+    }
+    const char *keyHex = end + 1 + PASSWORD_SALT_LEN * 2;
+    if (*keyHex != '$' || strlen(keyHex + 1) != PASSWORD_KEY_LEN * 2 || !HexDecode(keyHex + 1, expected, sizeof(expected))) {
+        return false;
+    }
+
+    if (!DeriveKey(password, (int)rounds, salt, actual)) {
+        return false;
+    }
+    bool match = CRYPTO_memcmp(expected, actual, sizeof(actual)) == 0;
+    OPENSSL_cleanse(actual, sizeof(actual));
+    *stale = rounds < iterations;
+    return match;
+}
+
+bool RegisterUser(const char *username, const char *password, Database *db) {
+    char hashedPassword[PASSWORD_HASH_LEN];
+    if (!HashPassword(password, GetStorageConfig()->passwordIterations, hashedPassword)) {
+        return false;
+    }
+
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_INSERT_USER);
+    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, hashedPassword, -1, SQLITE_STATIC);
+
+    bool registered = StepStatement(db, stmt) == SQLITE_DONE;
+
+    EndStatement(db, stmt);
+    return registered;
+}
+
+// Swap a legacy or cheaper hash for one at the current cost. A failure
+// only means the next login tries again.
+static void RehashPassword(int userId, const char *password, const char *stored, int iterations, Database *db) {
+    char hashedPassword[PASSWORD_HASH_LEN];
+    if (!HashPassword(password, iterations, hashedPassword)) {
+        return;
+    }
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_UPDATE_PASSWORD);
+    sqlite3_bind_text(stmt, 1, hashedPassword, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, userId);
+    sqlite3_bind_text(stmt, 3, stored, -1, SQLITE_STATIC);
+    StepStatement(db, stmt);
+    EndStatement(db, stmt);
+}
+
+bool LoginUser(const char *username, const char *password, Database *db) {
+    int iterations = GetStorageConfig()->passwordIterations;
+    char stored[PASSWORD_HASH_LEN] = "";
+    int userId = -1;
+
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_LOGIN_USER);
+    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+    if (StepStatement(db, stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 1) == SQLITE_TEXT) {
+        userId = sqlite3_column_int(stmt, 0);
+        snprintf(stored, sizeof(stored), "%s", (const char *)sqlite3_column_text(stmt, 1));
+    }
+    // The KDF runs with no statement open so it never holds a read transaction
+    EndStatement(db, stmt);
+
+    if (userId < 0) {
+        // Unknown names cost a full derivation too, so timing doesn't reveal
+        // which accounts exist
+        unsigned char salt[PASSWORD_SALT_LEN] = {0};
+        unsigned char key[PASSWORD_KEY_LEN];
+        DeriveKey(password, iterations, salt, key);
+        return false;
+    }
+
+    bool stale;
+    if (!VerifyPassword(password, stored, iterations, &stale)) {
+        return false;
+    }
+    if (stale) {
+        RehashPassword(userId, password, stored, iterations, db);
+    }
+    return true;
+}
+
+// Returns the user's id, or -1 if there is no such user
+int FindUser(const char *username, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_FIND_USER);
+    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+    int userId = StepStatement(db, stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+    EndStatement(db, stmt);
+    return userId;
+}
+
+// Look up a user's id, creating a password-less user if there is none yet
+int FindOrCreateUser(const char *username, Database *db) {
+    int userId = FindUser(username, db);
+    if (userId >= 0) {
+        return userId;
+    }
+
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_INSERT_USER);
+    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+    sqlite3_bind_null(stmt, 2);
+    if (StepStatement(db, stmt) == SQLITE_DONE) {
+        userId = (int)sqlite3_last_insert_rowid(db->handle);
+    }
+    EndStatement(db, stmt);
+    return userId;
+}
+
+// No due date is stored as NULL so the row stays out of tasks_due
+static void BindDueAt(sqlite3_stmt *stmt, int index, long long dueAt) {
+    if (dueAt > 0) {
+        sqlite3_bind_int64(stmt, index, dueAt);
+    } else {
+        sqlite3_bind_null(stmt, index);
+    }
+}
+
+bool AddTask(int userId, const char *title, long long dueAt, int repeatEvery, TaskKey *key, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_INSERT_TASK);
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_text(stmt, 2, title, -1, SQLITE_STATIC);
+    BindDueAt(stmt, 3, dueAt);
+    sqlite3_bind_int(stmt, 4, dueAt > 0 ? repeatEvery : 0);
+    bool added = StepStatement(db, stmt) == SQLITE_ROW;
+    if (added && key != NULL) {
+        key->rank = sqlite3_column_double(stmt, 0);
+        key->id = (int)sqlite3_last_insert_rowid(db->handle);
+    }
+    EndStatement(db, stmt);
+    return added;
+}
+
+// Runs a single-task update or delete bound to (taskId, userId)
+static bool ChangeTask(StatementId id, int userId, int taskId, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, id);
+    sqlite3_bind_int(stmt, 1, taskId);
+    sqlite3_bind_int(stmt, 2, userId);
+    bool changed = StepStatement(db, stmt) == SQLITE_DONE && sqlite3_changes(db->handle) > 0;
+    EndStatement(db, stmt);
+    return changed;
+}
+
+bool MarkTaskComplete(int userId, int taskId, Database *db) {
+    return ChangeTask(STMT_COMPLETE_TASK, userId, taskId, db);
+}
+
+bool DeleteTask(int userId, int taskId, Database *db) {
+    return ChangeTask(STMT_DELETE_TASK, userId, taskId, db);
+}
+
+bool SetTaskDue(int userId, int taskId, long long dueAt, int repeatEvery, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_SET_TASK_DUE);
+    BindDueAt(stmt, 1, dueAt);
+    sqlite3_bind_int(stmt, 2, dueAt > 0 ? repeatEvery : 0);
+    sqlite3_bind_int(stmt, 3, taskId);
+    sqlite3_bind_int(stmt, 4, userId);
+    bool changed = StepStatement(db, stmt) == SQLITE_DONE && sqlite3_changes(db->handle) > 0;
+    EndStatement(db, stmt);
+    return changed;
+}
+
+// "N" plus a unit, m/h/d/w, in seconds; end receives the first byte after it
+static bool ParseDuration(const char *text, const char **end, long long *seconds) {
+    char *unit;
+    long count = strtol(text, &unit, 10);
+    if (unit == text || count <= 0) {
+        return false;
+    }
+    long long scale = *unit == 'm' ? 60 : *unit == 'h' ? 3600 : *unit == 'd' ? 86400 : *unit == 'w' ? 604800 : 0;
+    if (scale == 0 || count > INT_MAX / scale) {
+        return false;
+    }
+    *seconds = count * scale;
+    *end = unit + 1;
+    return true;
+}
+
+bool ParseTaskDue(const char *spec, long long now, long long *dueAt, int *repeatEvery) {
+    if (strcmp(spec, "none") == 0) {
+        *dueAt = 0;
+        *repeatEvery = 0;
+        return true;
+    }
+
+    const char *end;
+    long long when;
+    if (spec[0] == '+') {
+        long long delta;
+        if (!ParseDuration(spec + 1, &end, &delta)) {
+            return false;
+        }
+        when = now + delta;
+    } else {
+        struct tm local = {0};
+        int length = 0;
+        if (sscanf(spec, "%4d-%2d-%2d%n", &local.tm_year, &local.tm_mon, &local.tm_mday, &length) != 3) {
+            return false;
+        }
+        end = spec + length;
+        local.tm_hour = TASK_DUE_DEFAULT_HOUR;
+        if (*end == 'T') {
+            if (sscanf(end + 1, "%2d:%2d%n", &local.tm_hour, &local.tm_min, &length) != 2) {
+                return false;
+            }
+            end += 1 + length;
+        }
+        if (local.tm_mon < 1 || local.tm_mon > 12 || local.tm_mday < 1 || local.tm_mday > 31 ||
+            local.tm_hour > 23 || local.tm_min > 59) {
+            return false;
+        }
+        local.tm_year -= 1900;
+        local.tm_mon--;
+        local.tm_isdst = -1;
+        time_t stamp = mktime(&local);
+        if (stamp == (time_t)-1) {
+            return false;
+        }
+        when = stamp;
+    }
+
+    long long every = 0;
+    if (*end == '/' && !ParseDuration(end + 1, &end, &every)) {
+        return false;
+    }
+    if (*end != '\0' || when <= 0) {
+        return false;
+    }
+    *dueAt = when;
+    *repeatEvery = (int)every;
+    return true;
+}
+
+bool SplitTaskDue(char *title, long long now, long long *dueAt, int *repeatEvery) {
+    char *at = strrchr(title, '@');
+    if (at == NULL || at == title || at[-1] != ' ' || !ParseTaskDue(at + 1, now, dueAt, repeatEvery) || *dueAt == 0) {
+        return false;
+    }
+    while (at > title && at[-1] == ' ') {
+        at--;
+    }
+    *at = '\0';
+    return true;
+}
+
+void FormatTaskDue(long long dueAt, int repeatEvery, char *text, size_t capacity) {
+    time_t when = (time_t)dueAt;
+    struct tm local;
+    size_t length = localtime_r(&when, &local) != NULL ? strftime(text, capacity, "%Y-%m-%d %H:%M", &local) : 0;
+    text[length] = '\0';
+    if (repeatEvery <= 0) {
+        return;
+    }
+    // In the largest unit that divides it evenly
+    static const struct { int seconds; char unit; } units[] = {{604800, 'w'}, {86400, 'd'}, {3600, 'h'}, {60, 'm'}};
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        if (repeatEvery % units[i].seconds == 0 || i + 1 == sizeof(units) / sizeof(units[0])) {
+            snprintf(text + length, capacity - length, " every %d%c", repeatEvery / units[i].seconds, units[i].unit);
+            return;
+        }
+    }
+}
+
+long long NextDueAt(long long dueAt, int repeatEvery, long long now) {
+    if (repeatEvery <= 0 || dueAt > now) {
+        return dueAt;
+    }
+    return dueAt + ((now - dueAt) / repeatEvery + 1) * repeatEvery;
+}
+
+static bool ReadTaskRank(int userId, int taskId, double *rank, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_TASK_RANK);
+    sqlite3_bind_int(stmt, 1, taskId);
+    sqlite3_bind_int(stmt, 2, userId);
+    bool found = StepStatement(db, stmt) == SQLITE_ROW;
+    if (found) {
+        *rank = sqlite3_column_double(stmt, 0);
+    }
+    EndStatement(db, stmt);
+    return found;
+}
+
+bool FindTaskKey(int userId, int taskId, TaskKey *key, Database *db) {
+    key->id = taskId;
+    return ReadTaskRank(userId, taskId, &key->rank, db);
+}
+
+// Midway between the neighbours, or a step past the only one. Sets fits
+// to false when the gap has been halved down to nothing.
+static double RankBetween(int afterId, double low, int beforeId, double high, bool *fits) {
+    double rank = afterId == 0 ? high - TASK_RANK_STEP
+                : beforeId == 0 ? low + TASK_RANK_STEP
+                : low + (high - low) / 2;
+    *fits = afterId == 0 || beforeId == 0 || (high - low >= 2 * TASK_RANK_MIN_GAP && low < rank && rank < high);
+    return rank;
+}
+
+static bool ReadNeighbourRanks(int userId, int afterId, int beforeId, double *low, double *high, Database *db) {
+    return (afterId == 0 || ReadTaskRank(userId, afterId, low, db)) &&
+           (beforeId == 0 || ReadTaskRank(userId, beforeId, high, db));
+}
+
+bool MoveTask(int userId, int taskId, int afterId, int beforeId, double *rank, bool *rebalanced, Database *db) {
+    *rebalanced = false;
+    if ((afterId == 0 && beforeId == 0) || !RunStatement(db, STMT_BEGIN)) {
+        return false;
+    }
+
+    double low = 0;
+    double high = 0;
+    bool fits = false;
+    bool ok = ReadNeighbourRanks(userId, afterId, beforeId, &low, &high, db);
+    if (ok) {
+        *rank = RankBetween(afterId, low, beforeId, high, &fits);
+    }
+    if (ok && !fits) {
+        // Only here does a move touch more than its own row
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_REBALANCE_RANKS);
+        sqlite3_bind_int(stmt, 1, userId);
+        ok = StepStatement(db, stmt) == SQLITE_DONE;
+        EndStatement(db, stmt);
+        ok = ok && ReadNeighbourRanks(userId, afterId, beforeId, &low, &high, db);
+        if (ok) {
+            *rank = RankBetween(afterId, low, beforeId, high, &fits);
+            *rebalanced = true;
+        }
+        ok = ok && fits;
+    }
+    if (ok) {
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_MOVE_TASK);
+        sqlite3_bind_double(stmt, 1, *rank);
+        sqlite3_bind_int(stmt, 2, taskId);
+        sqlite3_bind_int(stmt, 3, userId);
+        ok = StepStatement(db, stmt) == SQLITE_DONE && sqlite3_changes(db->handle) > 0;
+        EndStatement(db, stmt);
+    }
+    if (ok && RunStatement(db, STMT_COMMIT)) {
+        return true;
+    }
+    RunStatement(db, STMT_ROLLBACK);
+    *rebalanced = false;
+    return false;
+}
+
+// Runs a bulk statement, already bound, over spans inside one transaction
+static int ChangeTaskSpans(sqlite3_stmt *bulk, const TaskSpan *spans, int spanCount, Database *db) {
+    if (!RunStatement(db, STMT_BEGIN)) {
+        EndStatement(db, bulk);
+        return -1;
+    }
+    bool ok = RunStatement(db, STMT_CLEAR_BULK_SPANS);
+    for (int i = 0; ok && i < spanCount; i++) {
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_INSERT_BULK_SPAN);
+        sqlite3_bind_double(stmt, 1, spans[i].first.rank);
+        sqlite3_bind_int(stmt, 2, spans[i].first.id);
+        sqlite3_bind_double(stmt, 3, spans[i].last.rank);
+        sqlite3_bind_int(stmt, 4, spans[i].last.id);
+        ok = StepStatement(db, stmt) == SQLITE_DONE;
+        EndStatement(db, stmt);
+    }
+    int changed = -1;
+    if (ok && StepStatement(db, bulk) == SQLITE_DONE) {
+        changed = sqlite3_changes(db->handle);
+    }
+    EndStatement(db, bulk);
+    if (changed >= 0 && RunStatement(db, STMT_COMMIT)) {
+        return changed;
+    }
+    printf("Bulk change failed: %s\n", sqlite3_errmsg(db->handle));
+    RunStatement(db, STMT_ROLLBACK);
+    return -1;
+}
+
+int SetTasksCompleted(int userId, const TaskSpan *spans, int spanCount, bool completed, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_BULK_SET_COMPLETED);
+    sqlite3_bind_int(stmt, 1, completed);
+    sqlite3_bind_int(stmt, 2, userId);
+    return ChangeTaskSpans(stmt, spans, spanCount, db);
+}
+
+int DeleteTasks(int userId, const TaskSpan *spans, int spanCount, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_BULK_DELETE);
+    sqlite3_bind_int(stmt, 1, userId);
+    return ChangeTaskSpans(stmt, spans, spanCount, db);
+}
+
+// Puts a deleted task back with its old place in the list and state, and
+// its old id unless that has been taken (op->taskId receives the new one)
+static bool RestoreTask(int userId, TaskOp *op, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_RESTORE_TASK);
+    sqlite3_bind_int(stmt, 1, op->taskId);
+    sqlite3_bind_int(stmt, 2, userId);
+    sqlite3_bind_text(stmt, 3, op->title, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, op->completed);
+    sqlite3_bind_double(stmt, 5, op->rank);
+    BindDueAt(stmt, 6, op->dueAt);
+    sqlite3_bind_int(stmt, 7, op->dueAt > 0 ? op->repeatEvery : 0);
+    bool restored = StepStatement(db, stmt) == SQLITE_ROW;
+    if (restored) {
+        op->taskId = sqlite3_column_int(stmt, 0);
+    }
+    EndStatement(db, stmt);
+    return restored;
+}
+
+// The task ops[index] acts on: its own id, or the one the add it names got
+// earlier in the batch (0 if that add failed)
+static int ResolveOpTask(const TaskOp *ops, int index) {
+    int taskId = ops[index].taskId;
+    for (int i = 0; taskId < 0 && i < index; i++) {
+        if (ops[i].type == TASK_OP_ADD && ops[i].seq == -(long long)taskId) {
+            return ops[i].ok ? ops[i].taskId : 0;
+        }
+    }
+    return taskId;
+}
+
+bool ApplyTaskOps(int userId, TaskOp *ops, int opCount, long long appliedSeq, Database *db) {
+    if (!RunStatement(db, STMT_BEGIN)) {
+        return false;
+    }
+    for (int i = 0; i < opCount; i++) {
+        TaskOp *op = &ops[i];
+        if (op->type == TASK_OP_ADD) {
+            TaskKey key;
+            op->ok = AddTask(userId, op->title, op->dueAt, op->repeatEvery, &key, db);
+            if (op->ok) {
+                op->taskId = key.id;
+                op->rank = key.rank;
+            }
+            continue;
+        }
+        op->taskId = ResolveOpTask(ops, i);
+        switch (op->type) {
+            case TASK_OP_COMPLETE:
+                op->ok = ChangeTask(STMT_COMPLETE_TASK, userId, op->taskId, db);
+                break;
+            case TASK_OP_UNCOMPLETE:
+                op->ok = ChangeTask(STMT_UNCOMPLETE_TASK, userId, op->taskId, db);
+                break;
+            case TASK_OP_DELETE:
+                op->ok = ChangeTask(STMT_DELETE_TASK, userId, op->taskId, db);
+                break;
+            case TASK_OP_RESTORE:
+                op->ok = op->taskId > 0 && RestoreTask(userId, op, db);
+                break;
+            default:
+                op->ok = false;
+                break;
+        }
+    }
+    bool recorded = true;
+    if (appliedSeq > 0) {
+        sqlite3_stmt *stmt = BeginStatement(db, STMT_SET_JOURNAL_SEQ);
+        sqlite3_bind_int(stmt, 1, userId);
+        sqlite3_bind_int64(stmt, 2, appliedSeq);
+        recorded = StepStatement(db, stmt) == SQLITE_DONE;
+        EndStatement(db, stmt);
+    }
+    if (recorded && RunStatement(db, STMT_COMMIT)) {
+        return true;
+    }
+    printf("Journal batch failed: %s\n", sqlite3_errmsg(db->handle));
+    RunStatement(db, STMT_ROLLBACK);
+    return false;
+}
+
+long long ReadAppliedJournalSeq(int userId, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_JOURNAL_SEQ);
+    sqlite3_bind_int(stmt, 1, userId);
+    int rc = StepStatement(db, stmt);
+    long long seq = rc == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : rc == SQLITE_DONE ? 0 : -1;
+    EndStatement(db, stmt);
+    return seq;
+}
+
+// Appends rows of a (id, title, completed, rank, due_at, recur_every) query
+// until it runs dry or max is reached. Returns the last step result, or SQLITE_NOMEM if the list
+// couldn't grow.
+static int AppendTaskRows(sqlite3_stmt *stmt, TaskList *tasks, int max, int *count, Database *db) {
+    int rc = SQLITE_DONE;
+    while (*count < max && (rc = StepStatement(db, stmt)) == SQLITE_ROW) {
+        if (!AppendTask(tasks, sqlite3_column_int(stmt, 0), sqlite3_column_double(stmt, 3),
+                        (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_int(stmt, 2) != 0)) {
+            return SQLITE_NOMEM;
+        }
+        SetTaskDueAt(tasks, tasks->count - 1, sqlite3_column_int64(stmt, 4), sqlite3_column_int(stmt, 5));
+        (*count)++;
+    }
+    return rc;
+}
+
+int ListTasks(int userId, TaskKey after, TaskList *tasks, int maxTasks, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_SELECT_TASK_PAGE);
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_double(stmt, 2, after.rank);
+    sqlite3_bind_int(stmt, 3, after.id);
+    sqlite3_bind_int(stmt, 4, maxTasks);
+
+    int count = 0;
+    AppendTaskRows(stmt, tasks, maxTasks, &count, db);
+    EndStatement(db, stmt);
+    return count;
+}
+
+static unsigned long long HashBytes(unsigned long long hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+unsigned long long DigestTasks(int userId, Database *db, int *count) {
+    TaskList tasks;
+    InitTaskList(&tasks);
+    unsigned long long hash = 14695981039346656037ULL;
+    int total = 0;
+    TaskKey last = TASK_KEY_FIRST;
+    int fetched;
+    while ((fetched = ListTasks(userId, last, &tasks, TASK_DIGEST_BATCH, db)) > 0) {
+        for (int i = 0; i < fetched; i++) {
+            Task task = GetTaskAt(&tasks, i);
+            unsigned char completed = task.completed;
+            hash = HashBytes(hash, &task.id, sizeof(task.id));
+            hash = HashBytes(hash, &completed, 1);
+            hash = HashBytes(hash, task.title, strlen(task.title) + 1);
+        }
+        total += fetched;
+        last = GetTaskKey(&tasks, fetched - 1);
+        TruncateTaskList(&tasks, 0);
+    }
+    FreeTaskList(&tasks);
+    if (count != NULL) {
+        *count = total;
+    }
+    return hash;
+}
+
+// The stored row, with tasks that fell due by now moved into overdue
+bool ReadTaskCounts(int userId, long long now, TaskCounts *counts, Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_SELECT_TASK_COUNTS);
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_int64(stmt, 2, now);
+    bool found = StepStatement(db, stmt) == SQLITE_ROW;
+    if (found) {
+        counts->total = sqlite3_column_int(stmt, 0);
+        counts->completed = sqlite3_column_int(stmt, 1);
+        counts->overdue = sqlite3_column_int(stmt, 2);
+    }
+    EndStatement(db, stmt);
+    return found;
+}
+
+// Overdue is checked as of each user's overdue_as_of, the time the stored
+// count was last brought up to
+int VerifyTaskCounts(Database *db) {
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_VERIFY_TASK_COUNTS);
+    int drifted = 0;
+    int rc;
+    while ((rc = StepStatement(db, stmt)) == SQLITE_ROW) {
+        const char *username = (const char *)sqlite3_column_text(stmt, 1);
+        if (sqlite3_column_type(stmt, 2) == SQLITE_NULL) {
+            printf("%s: no counts row\n", username != NULL ? username : "?");
+            drifted++;
+            continue;
+        }
+        TaskCounts stored = {sqlite3_column_int(stmt, 2), sqlite3_column_int(stmt, 3), sqlite3_column_int(stmt, 4)};
+        TaskCounts actual = {sqlite3_column_int(stmt, 5), sqlite3_column_int(stmt, 6), sqlite3_column_int(stmt, 7)};
+        if (stored.total != actual.total || stored.completed != actual.completed || stored.overdue != actual.overdue) {
+            printf("%s: stored %d total, %d completed, %d overdue; actual %d, %d, %d\n",
+                   username != NULL ? username : "?", stored.total, stored.completed, stored.overdue,
+                   actual.total, actual.completed, actual.overdue);
+            drifted++;
+        }
+    }
+    EndStatement(db, stmt);
+    return rc == SQLITE_DONE ? drifted : -1;
+}
+
+// Turn free text into an FTS5 query where every word is a quoted prefix
+// term, e.g. 'buy mil' -> '"buy"* "mil"*'. Returns false if there are no words.
+bool BuildMatchQuery(const char *text, char *match, size_t capacity) {
+    size_t length = 0;
+    bool inWord = false;
+    bool any = false;
+
+    // An open word always leaves room for its closing "* and the NUL, so
+    // cutting the text short anywhere still ends in a well-formed query
+    for (const char *p = text;; p++) {
+        bool wordChar = *p != '\0' && (isalnum((unsigned char)*p) || (unsigned char)*p >= 0x80);
+        if (wordChar && !inWord) {
+            // Separator, quote, one character, closer and NUL
+            if (length + 6 > capacity) {
+                break;
+            }
+            if (any) {
+                match[length++] = ' ';
+            }
+            match[length++] = '"';
+            inWord = true;
+            any = true;
+        }
+        if (!wordChar && inWord) {
+            match[length++] = '"';
+            match[length++] = '*';
+            inWord = false;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (wordChar) {
+            if (length + 4 > capacity) {
+                break;
+            }
+            match[length++] = *p;
+        }
+    }
+    if (inWord) {
+        match[length++] = '"';
+        match[length++] = '*';
+    }
+    match[length] = '\0';
+    return any;
+}
+
+int SearchTasks(int userId, const char *text, TaskList *tasks, int maxTasks, Database *db) {
+    char match[SEARCH_MATCH_LEN];
+    if (!BuildMatchQuery(text, match, sizeof(match))) {
+        return 0;
+    }
+
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_SEARCH_TASKS);
+    sqlite3_bind_text(stmt, 1, match, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, userId);
+    sqlite3_bind_int(stmt, 3, maxTasks);
+    int start = tasks->count;
+    int count = 0;
+    int rc = AppendTaskRows(stmt, tasks, maxTasks, &count, db);
+    EndStatement(db, stmt);
+    if (count < maxTasks && rc != SQLITE_DONE) {
+        TruncateTaskList(tasks, start);
+        return -1;
+    }
+    return count;
+}
+
+void RunDbJob(Database *db, DbJob *job) {
+    switch (job->type) {
+        case JOB_ADD_TASK: {
+            TaskKey key = {0};
+            job->ok = AddTask(job->userId, job->text, job->dueAt, job->repeatEvery, &key, db);
+            job->rowId = key.id;
+            job->rank = key.rank;
+            break;
+        }
+        case JOB_MOVE_TASK: {
+            bool rebalanced;
+            job->ok = MoveTask(job->userId, job->taskId, job->afterId, job->beforeId, &job->rank, &rebalanced, db);
+            job->rowId = rebalanced;
+            break;
+        }
+        case JOB_SET_DUE:
+            job->ok = SetTaskDue(job->userId, job->taskId, job->dueAt, job->repeatEvery, db);
+            break;
+        case JOB_COMPLETE_TASK:
+            job->ok = MarkTaskComplete(job->userId, job->taskId, db);
+            break;
+        case JOB_DELETE_TASK:
+            job->ok = DeleteTask(job->userId, job->taskId, db);
+            break;
+        case JOB_BULK_COMPLETE:
+        case JOB_BULK_UNCOMPLETE:
+            job->rowId = SetTasksCompleted(job->userId, job->spans, job->spanCount, job->type == JOB_BULK_COMPLETE, db);
+            job->ok = job->rowId >= 0;
+            break;
+        case JOB_BULK_DELETE:
+            job->rowId = DeleteTasks(job->userId, job->spans, job->spanCount, db);
+            job->ok = job->rowId >= 0;
+            break;
+        case JOB_APPLY_OPS:
+            job->ok = ApplyTaskOps(job->userId, job->ops, job->opCount, job->appliedSeq, db);
+            break;
+        default:
+            job->ok = false;
+            break;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef TASKCORE_H
+#define TASKCORE_H
+
+#include "db.h"
+#include "dbworker.h"
+#include "tasklist.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PASSWORD_SCHEME "pbkdf2-sha256"
+#define PASSWORD_SALT_LEN 16
+#define PASSWORD_KEY_LEN 32
+#define PASSWORD_HASH_LEN 160 // scheme$iterations$salt$key in hex, plus the terminator
+#define SEARCH_MATCH_LEN 512
+#define TASK_DIGEST_BATCH 512
+#define TASK_RANK_MIN_GAP 1e-6 // Closer neighbours than this trigger a rebalance
+#define TASK_DUE_LEN 48 // Longest FormatTaskDue text, plus the terminator
+#define TASK_DUE_DEFAULT_HOUR 9 // Due dates given without a time
+
+// Accounts and tasks without any UI. Together with db, schema, storage,
+// dbworker, taskstore, search and taskio this is everything the windowed
+// programs and taskcli share; none of it links against raylib.
+// Passwords are stored as salted PBKDF2-HMAC-SHA256 at the configured
+// passwordIterations. Logins also accept the legacy bare SHA-256 rows and
+// rehash them, and any cheaper PBKDF2 row, at the current cost. The KDF is
+// deliberately slow: call these from an AuthPool thread, never a frame loop.
+bool HashPassword(const char *password, int iterations, char *encoded);
+// stale is set when the row should be rehashed at iterations
+bool VerifyPassword(const char *password, const char *encoded, int iterations, bool *stale);
+bool RegisterUser(const char *username, const char *password, Database *db);
+bool LoginUser(const char *username, const char *password, Database *db);
+int FindUser(const char *username, Database *db);
+int FindOrCreateUser(const char *username, Database *db);
+
+// Task ids are only touched when they belong to userId; complete, delete
+// and SetTaskDue return false when no such task exists. New tasks go to the
+// end of the list; key, if not NULL, receives where. Due times are Unix
+// seconds and repeatEvery the seconds between occurrences, 0 for none.
+bool AddTask(int userId, const char *title, long long dueAt, int repeatEvery, TaskKey *key, Database *db);
+bool MarkTaskComplete(int userId, int taskId, Database *db);
+bool DeleteTask(int userId, int taskId, Database *db);
+bool SetTaskDue(int userId, int taskId, long long dueAt, int repeatEvery, Database *db);
+
+// Due specs are WHEN or WHEN/EVERY, where WHEN is +N followed by m, h, d or
+// w (from now), YYYY-MM-DD (at TASK_DUE_DEFAULT_HOUR) or YYYY-MM-DDTHH:MM in
+// local time, and EVERY is N with one of the same units; "none" clears it.
+// e.g. "+2h", "2026-11-01T18:30", "+1d/1w".
+bool ParseTaskDue(const char *spec, long long now, long long *dueAt, int *repeatEvery);
+// Strips a trailing " @SPEC" off title when SPEC parses, so "Pay rent
+// @2026-11-01/4w" adds "Pay rent" with a due date. False, leaving title
+// alone, when there is none.
+bool SplitTaskDue(char *title, long long now, long long *dueAt, int *repeatEvery);
+// "2026-11-01 09:00", plus " every 4w" for a recurring task
+void FormatTaskDue(long long dueAt, int repeatEvery, char *text, size_t capacity);
+// The first occurrence of a recurring due time after now
+long long NextDueAt(long long dueAt, int repeatEvery, long long now);
+
+// Bulk versions over every task of userId inside spans (sorted, disjoint).
+// Each is one transaction: the spans go into a temp table and a single
+// set-based statement does the rest. Return how many tasks changed, or -1
+// if nothing was.
+int SetTasksCompleted(int userId, const TaskSpan *spans, int spanCount, bool completed, Database *db);
+int DeleteTasks(int userId, const TaskSpan *spans, int spanCount, Database *db);
+
+// Runs a batch of undo journal ops, in order, as one transaction. An op
+// naming -seq acts on the task the add with that seq created earlier in the
+// batch. Each op is left with its taskId resolved (an add's, and its rank,
+// filled in) and ok saying whether it changed anything. Unless appliedSeq
+// is 0 it is recorded as userId's applied journal seq in the same
+// transaction. False, with nothing applied, if the transaction failed.
+bool ApplyTaskOps(int userId, TaskOp *ops, int opCount, long long appliedSeq, Database *db);
+// The applied journal seq recorded for userId, 0 for none; -1 on error
+long long ReadAppliedJournalSeq(int userId, Database *db);
+
+// Where taskId sits in userId's list; false if there is no such task
+bool FindTaskKey(int userId, int taskId, TaskKey *key, Database *db);
+// Give taskId a rank between afterId's and beforeId's (0 for the start or
+// end of the list), updating just that row. Ranks are doubles halved down
+// by repeated moves into one gap; once neighbours are closer than
+// TASK_RANK_MIN_GAP the user's list is respaced first, in the same
+// transaction, and rebalanced is set.
+bool MoveTask(int userId, int taskId, int afterId, int beforeId, double *rank, bool *rebalanced, Database *db);
+
+// Appends up to maxTasks tasks that come after the given key, in list
+// order, to tasks. Returns how many were appended.
+int ListTasks(int userId, TaskKey after, TaskList *tasks, int maxTasks, Database *db);
+
+// FNV-1a over every (id, completed, title) in list order, for comparing the
+// state two runs left behind; count receives the number of tasks
+unsigned long long DigestTasks(int userId, Database *db, int *count);
+
+typedef struct {
+    int total;
+    int completed;
+    int overdue;   // Open tasks due at or before the time they were read for
+} TaskCounts;
+
+// A user's counts from task_counts, which triggers keep exact: one primary
+// key lookup plus the tasks that fell due since the last write
+bool ReadTaskCounts(int userId, long long now, TaskCounts *counts, Database *db);
+// Recomputes every user's counts from tasks and prints the ones the stored
+// counts drifted from. Returns how many drifted, or -1 on error.
+int VerifyTaskCounts(Database *db);
+
+// Quotes each word of text as an FTS5 prefix term; false if there are none
+bool BuildMatchQuery(const char *text, char *match, size_t capacity);
+// Full-text prefix search over a user's titles, appended in id order
+// rather than list order, so the match can drive the query.
+// Returns -1, appending nothing, if the query was interrupted (e.g. by a
+// progress handler).
+int SearchTasks(int userId, const char *text, TaskList *tasks, int maxTasks, Database *db);
+
+// DbJobHandler covering every DbJobType
+void RunDbJob(Database *db, DbJob *job);
+
+#endif
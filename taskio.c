@@ -0,0 +1,485 @@
+#include "taskio.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+// Parsed rows go through one reused insert statement and are committed every
+// IMPORT_BATCH_SIZE rows, so the whole import costs a handful of fsyncs
+typedef struct {
+    Database *db;
+    int userId;
+    int batchRows;
+    bool failed;
+    TransferStats *stats;
+} ImportSink;
+
+// CSV is parsed one byte at a time so quoted fields may span chunk
+// boundaries and lines without ever buffering more than one field
+typedef enum {
+    CSV_FIELD_START,
+    CSV_UNQUOTED,
+    CSV_QUOTED,
+    CSV_QUOTE_IN_QUOTED
+} CsvState;
+
+typedef struct {
+    CsvState state;
+    char field[IMPORT_TITLE_MAX];
+    int fieldLength;
+    int fieldIndex;
+    bool firstRecord;
+    int titleColumn;
+    int completedColumn;
+    char title[IMPORT_TITLE_MAX];
+    bool completed;
+    bool hasTitle;
+} CsvParser;
+
+static double NowSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+TaskFormat GuessTaskFormat(const char *path) {
+    const char *dot = strrchr(path, '.');
+    if (dot != NULL && (strcasecmp(dot, ".jsonl") == 0 || strcasecmp(dot, ".json") == 0 || strcasecmp(dot, ".ndjson") == 0)) {
+        return TASK_FORMAT_JSONL;
+    }
+    return TASK_FORMAT_CSV;
+}
+
+static bool ParseCompleted(const char *value) {
+    return strcmp(value, "1") == 0 || strcasecmp(value, "true") == 0 || strcasecmp(value, "yes") == 0;
+}
+
+static void SinkRow(ImportSink *sink, const char *title, bool completed) {
+    if (sink->failed) {
+        return;
+    }
+    if (sink->batchRows == 0 && !RunStatement(sink->db, STMT_BEGIN)) {
+        sink->failed = true;
+        return;
+    }
+
+    sqlite3_stmt *stmt = BeginStatement(sink->db, STMT_IMPORT_TASK);
+    sqlite3_bind_int(stmt, 1, sink->userId);
+    sqlite3_bind_text(stmt, 2, title, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, completed);
+    bool inserted = StepStatement(sink->db, stmt) == SQLITE_DONE;
+    EndStatement(sink->db, stmt);
+    if (!inserted) {
+        printf("Import failed: %s\n", sqlite3_errmsg(sink->db->handle));
+        RunStatement(sink->db, STMT_ROLLBACK);
+        sink->failed = true;
+        return;
+    }
+
+    sink->stats->rows++;
+    if (++sink->batchRows == IMPORT_BATCH_SIZE) {
+        sink->failed = !RunStatement(sink->db, STMT_COMMIT);
+        sink->batchRows = 0;
+    }
+}
+
+static void FinishSink(ImportSink *sink) {
+    if (!sink->failed && sink->batchRows > 0) {
+        sink->failed = !RunStatement(sink->db, STMT_COMMIT);
+    }
+    sink->batchRows = 0;
+}
+
+static void EndCsvField(CsvParser *csv) {
+    csv->field[csv->fieldLength] = '\0';
+    if (csv->firstRecord) {
+        // A header row names the columns; otherwise title,completed is assumed
+        if (strcasecmp(csv->field, "title") == 0) {
+            csv->titleColumn = csv->fieldIndex;
+        } else if (strcasecmp(csv->field, "completed") == 0) {
+            csv->completedColumn = csv->fieldIndex;
+        }
+    }
+    if (csv->fieldIndex == csv->titleColumn) {
+        memcpy(csv->title, csv->field, csv->fieldLength + 1);
+        csv->hasTitle = true;
+    } else if (csv->fieldIndex == csv->completedColumn) {
+        csv->completed = ParseCompleted(csv->field);
+    }
+    csv->fieldIndex++;
+    csv->fieldLength = 0;
+    csv->state = CSV_FIELD_START;
+}
+
+static void EndCsvRecord(CsvParser *csv, ImportSink *sink) {
+    bool isHeader = csv->firstRecord && strcasecmp(csv->title, "title") == 0;
+    if (csv->fieldIndex == 1 && csv->title[0] == '\0') {
+        // Blank line
+    } else if (isHeader) {
+        // Column positions were taken from it in EndCsvField
+    } else if (csv->hasTitle) {
+        SinkRow(sink, csv->title, csv->completed);
+    } else {
+        sink->stats->skipped++;
+    }
+    csv->firstRecord = false;
+    csv->fieldIndex = 0;
+    csv->hasTitle = false;
+    csv->completed = false;
+    csv->title[0] = '\0';
+}
+
+static void AppendCsvChar(CsvParser *csv, char c) {
+    // Over-long titles are truncated rather than rejected
+    if (csv->fieldLength < IMPORT_TITLE_MAX - 1) {
+        csv->field[csv->fieldLength++] = c;
+    }
+}
+
+static void FeedCsv(CsvParser *csv, ImportSink *sink, const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        switch (csv->state) {
+            case CSV_FIELD_START:
+                if (c == '"') {
+                    csv->state = CSV_QUOTED;
+                    break;
+                }
+                csv->state = CSV_UNQUOTED;
+                // fall through
+            case CSV_UNQUOTED:
+                if (c == ',') {
+                    EndCsvField(csv);
+                } else if (c == '\n') {
+                    EndCsvField(csv);
+                    EndCsvRecord(csv, sink);
+                } else if (c != '\r') {
+                    AppendCsvChar(csv, c);
+                }
+                break;
+            case CSV_QUOTED:
+                if (c == '"') {
+                    csv->state = CSV_QUOTE_IN_QUOTED;
+                } else {
+                    AppendCsvChar(csv, c);
+                }
+                break;
+            case CSV_QUOTE_IN_QUOTED:
+                if (c == '"') {
+                    AppendCsvChar(csv, '"');
+                    csv->state = CSV_QUOTED;
+                } else if (c == ',') {
+                    EndCsvField(csv);
+                } else if (c == '\n') {
+                    EndCsvField(csv);
+                    EndCsvRecord(csv, sink);
+                } else if (c != '\r') {
+                    // Stray text after a closing quote; keep it
+                    AppendCsvChar(csv, c);
+                    csv->state = CSV_UNQUOTED;
+                }
+                break;
+        }
+    }
+}
+
+static void FinishCsv(CsvParser *csv, ImportSink *sink) {
+    if (csv->state != CSV_FIELD_START || csv->fieldIndex > 0) {
+        EndCsvField(csv);
+        EndCsvRecord(csv, sink);
+    }
+}
+
+// Append a code point to out as UTF-8
+static int EncodeUtf8(unsigned codepoint, char *out) {
+    if (codepoint < 0x80) {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = (char)(0xE0 | (codepoint >> 12));
+        out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codepoint >> 18));
+    out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+static bool ParseHex4(const char *p, unsigned *value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!isxdigit((unsigned char)p[i])) {
+            return false;
+        }
+        *value = *value * 16 + (isdigit((unsigned char)p[i]) ? p[i] - '0' : (tolower((unsigned char)p[i]) - 'a' + 10));
+    }
+    return true;
+}
+
+// Decode the JSON string starting after its opening quote into out. Returns
+// a pointer just past the closing quote, or NULL if it is malformed.
+static const char *ParseJsonString(const char *p, char *out, int capacity) {
+    int length = 0;
+    while (*p != '"') {
+        char decoded[4];
+        int size = 1;
+        if (*p == '\0') {
+            return NULL;
+        }
+        if (*p == '\\') {
+            p++;
+            switch (*p) {
+                case '"': decoded[0] = '"'; break;
+                case '\\': decoded[0] = '\\'; break;
+                case '/': decoded[0] = '/'; break;
+                case 'b': decoded[0] = '\b'; break;
+                case 'f': decoded[0] = '\f'; break;
+                case 'n': decoded[0] = '\n'; break;
+                case 'r': decoded[0] = '\r'; break;
+                case 't': decoded[0] = '\t'; break;
+                case 'u': {
+                    unsigned codepoint;
+                    if (!ParseHex4(p + 1, &codepoint)) {
+                        return NULL;
+                    }
+                    p += 4;
+                    unsigned low;
+                    if (codepoint >= 0xD800 && codepoint < 0xDC00 && p[1] == '\\' && p[2] == 'u' &&
+                        ParseHex4(p + 3, &low) && low >= 0xDC00 && low < 0xE000) {
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                    size = EncodeUtf8(codepoint, decoded);
+                    break;
+                }
+                default:
+                    return NULL;
+            }
+        } else {
+            decoded[0] = *p;
+        }
+        if (length + size < capacity) {
+            memcpy(out + length, decoded, size);
+            length += size;
+        }
+        p++;
+    }
+    out[length] = '\0';
+    return p + 1;
+}
+
+static const char *SkipSpace(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+// Skip a scalar value we don't care about
+static const char *SkipJsonValue(const char *p) {
+    static char scratch[IMPORT_TITLE_MAX];
+    if (*p == '"') {
+        return ParseJsonString(p + 1, scratch, sizeof(scratch));
+    }
+    while (*p != '\0' && *p != ',' && *p != '}') {
+        p++;
+    }
+    return p;
+}
+
+// One flat JSON object per line; nested values are not supported
+static bool ParseJsonLine(const char *line, char *title, bool *completed) {
+    char key[64];
+    bool hasTitle = false;
+    *completed = false;
+
+    const char *p = SkipSpace(line);
+    if (*p++ != '{') {
+        return false;
+    }
+    for (;;) {
+        p = SkipSpace(p);
+        if (*p == '}') {
+            return hasTitle;
+        }
+        if (*p++ != '"' || (p = ParseJsonString(p, key, sizeof(key))) == NULL) {
+            return false;
+        }
+        p = SkipSpace(p);
+        if (*p++ != ':') {
+            return false;
+        }
+        p = SkipSpace(p);
+
+        if (strcmp(key, "title") == 0 && *p == '"') {
+            p = ParseJsonString(p + 1, title, IMPORT_TITLE_MAX);
+            hasTitle = p != NULL;
+        } else if (strcmp(key, "completed") == 0) {
+            *completed = strncmp(p, "true", 4) == 0 || *p == '1';
+            p = SkipJsonValue(p);
+        } else {
+            p = SkipJsonValue(p);
+        }
+        if (p == NULL) {
+            return false;
+        }
+        p = SkipSpace(p);
+        if (*p == ',') {
+            p++;
+        } else if (*p != '}') {
+            return false;
+        }
+    }
+}
+
+static void EndJsonLine(char *line, int length, bool overflowed, ImportSink *sink) {
+    static char title[IMPORT_TITLE_MAX];
+    bool completed;
+    line[length] = '\0';
+    if (SkipSpace(line)[0] == '\0') {
+        return;
+    }
+    if (!overflowed && ParseJsonLine(line, title, &completed)) {
+        SinkRow(sink, title, completed);
+    } else {
+        sink->stats->skipped++;
+    }
+}
+
+bool ImportTasks(Database *db, int userId, FILE *in, TaskFormat format, TransferStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    ImportSink sink = {db, userId, 0, false, stats};
+    double start = NowSeconds();
+
+    char *chunk = malloc(IMPORT_CHUNK_SIZE);
+    CsvParser *csv = calloc(1, sizeof(CsvParser));
+    // A JSON line can hold a full-length title with every byte escaped
+    int lineCapacity = IMPORT_TITLE_MAX * 6 + 256;
+    char *line = malloc(lineCapacity + 1);
+    int lineLength = 0;
+    bool lineOverflowed = false;
+    csv->firstRecord = true;
+    csv->titleColumn = 0;
+    csv->completedColumn = 1;
+
+    size_t read;
+    while (!sink.failed && (read = fread(chunk, 1, IMPORT_CHUNK_SIZE, in)) > 0) {
+        if (format == TASK_FORMAT_CSV) {
+            FeedCsv(csv, &sink, chunk, read);
+            continue;
+        }
+        for (size_t i = 0; i < read; i++) {
+            if (chunk[i] == '\n') {
+                EndJsonLine(line, lineLength, lineOverflowed, &sink);
+                lineLength = 0;
+                lineOverflowed = false;
+            } else if (lineLength < lineCapacity) {
+                line[lineLength++] = chunk[i];
+            } else {
+                lineOverflowed = true;
+            }
+        }
+    }
+    if (!sink.failed) {
+        if (format == TASK_FORMAT_CSV) {
+            FinishCsv(csv, &sink);
+        } else if (lineLength > 0) {
+            EndJsonLine(line, lineLength, lineOverflowed, &sink);
+        }
+    }
+    FinishSink(&sink);
+
+    free(line);
+    free(csv);
+    free(chunk);
+    stats->seconds = NowSeconds() - start;
+    return !sink.failed && !ferror(in);
+}
+
+static void WriteCsvField(FILE *out, const char *text) {
+    if (strpbrk(text, ",\"\r\n") == NULL) {
+        fputs(text, out);
+        return;
+    }
+    fputc('"', out);
+    for (const char *p = text; *p != '\0'; p++) {
+        if (*p == '"') {
+            fputc('"', out);
+        }
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void WriteJsonString(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; p++) {
+        switch (*p) {
+            case '"': fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out); break;
+            case '\r': fputs("\\r", out); break;
+            case '\t': fputs("\\t", out); break;
+            default:
+                if (*p < 0x20) {
+                    fprintf(out, "\\u%04x", *p);
+                } else {
+                    fputc(*p, out);
+                }
+                break;
+        }
+    }
+    fputc('"', out);
+}
+
+// Rows are written straight from the cursor, so memory use doesn't depend on
+// how many tasks there are. Give out a large buffer with setvbuf first.
+bool ExportTasks(Database *db, int userId, FILE *out, TaskFormat format, TransferStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    double start = NowSeconds();
+
+    if (format == TASK_FORMAT_CSV) {
+        fputs("title,completed\n", out);
+    }
+
+    sqlite3_stmt *stmt = BeginStatement(db, STMT_EXPORT_TASKS);
+    sqlite3_bind_int(stmt, 1, userId);
+    int rc;
+    while ((rc = StepStatement(db, stmt)) == SQLITE_ROW) {
+        const char *title = (const char *)sqlite3_column_text(stmt, 1);
+        bool completed = sqlite3_column_int(stmt, 2);
+        if (format == TASK_FORMAT_CSV) {
+            WriteCsvField(out, title);
+            fputs(completed ? ",1\n" : ",0\n", out);
+        } else {
+            fputs("{\"title\":", out);
+            WriteJsonString(out, title);
+            fputs(completed ? ",\"completed\":true}\n" : ",\"completed\":false}\n", out);
+        }
+        stats->rows++;
+    }
+    EndStatement(db, stmt);
+
+    bool ok = rc == SQLITE_DONE && fflush(out) == 0 && !ferror(out);
+    stats->seconds = NowSeconds() - start;
+    return ok;
+}
+
+void PrintTransferStats(const char *verb, const TransferStats *stats) {
+    double rate = stats->seconds > 0 ? stats->rows / stats->seconds : 0;
+    printf("%s %ld tasks in %.2f s (%.0f rows/s)", verb, stats->rows, stats->seconds, rate);
+    if (stats->skipped > 0) {
+        printf(", %ld malformed rows skipped", stats->skipped);
+    }
+    printf("\n");
+}
@@ -0,0 +1,28 @@
+#ifndef TASKIO_H
+#define TASKIO_H
+
+#include "db.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+#define IMPORT_CHUNK_SIZE 65536
+#define IMPORT_BATCH_SIZE 10000
+#define IMPORT_TITLE_MAX 4096
+
+typedef enum {
+    TASK_FORMAT_CSV,   // title,completed with an optional header row
+    TASK_FORMAT_JSONL  // one {"title": ..., "completed": ...} object per line
+} TaskFormat;
+
+typedef struct {
+    long rows;
+    long skipped;     // Malformed records
+    double seconds;
+} TransferStats;
+
+TaskFormat GuessTaskFormat(const char *path);
+bool ImportTasks(Database *db, int userId, FILE *in, TaskFormat format, TransferStats *stats);
+bool ExportTasks(Database *db, int userId, FILE *out, TaskFormat format, TransferStats *stats);
+void PrintTransferStats(const char *verb, const TransferStats *stats);
+
+#endif
@@ -0,0 +1,244 @@
+#include "tasklist.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TASK_LIST_MIN_CAPACITY 64
+#define TASK_TITLE_MIN_CAPACITY 1024
+
+void InitTaskList(TaskList *list) {
+    *list = (TaskList){0};
+}
+
+void FreeTaskList(TaskList *list) {
+    free(list->ids);
+    free(list->ranks);
+    free(list->flags);
+    free(list->dueAts);
+    free(list->repeats);
+    free(list->titleOffsets);
+    free(list->titles);
+    InitTaskList(list);
+}
+
+void TruncateTaskList(TaskList *list, int count) {
+    if (count >= list->count) {
+        return;
+    }
+    list->titleBytes = count > 0 ? list->titleOffsets[count] : 0;
+    list->count = count;
+}
+
+static bool GrowColumns(TaskList *list) {
+    int capacity = list->capacity > 0 ? list->capacity * 2 : TASK_LIST_MIN_CAPACITY;
+    int *ids = realloc(list->ids, capacity * sizeof(int));
+    if (ids != NULL) {
+        list->ids = ids;
+    }
+    double *ranks = realloc(list->ranks, capacity * sizeof(double));
+    if (ranks != NULL) {
+        list->ranks = ranks;
+    }
+    unsigned char *flags = realloc(list->flags, capacity);
+    if (flags != NULL) {
+        list->flags = flags;
+    }
+    long long *dueAts = realloc(list->dueAts, capacity * sizeof(long long));
+    if (dueAts != NULL) {
+        list->dueAts = dueAts;
+    }
+    int *repeats = realloc(list->repeats, capacity * sizeof(int));
+    if (repeats != NULL) {
+        list->repeats = repeats;
+    }
+    // One extra offset so the end of the last title is always at hand
+    unsigned *offsets = realloc(list->titleOffsets, (capacity + 1) * sizeof(unsigned));
+    if (offsets != NULL) {
+        list->titleOffsets = offsets;
+    }
+    if (ids == NULL || ranks == NULL || flags == NULL || dueAts == NULL || repeats == NULL || offsets == NULL) {
+        return false;
+    }
+    list->capacity = capacity;
+    return true;
+}
+
+static bool GrowTitles(TaskList *list, size_t needed) {
+    size_t capacity = list->titleCapacity > 0 ? list->titleCapacity : TASK_TITLE_MIN_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    char *titles = realloc(list->titles, capacity);
+    if (titles == NULL) {
+        return false;
+    }
+    list->titles = titles;
+    list->titleCapacity = capacity;
+    return true;
+}
+
+bool AppendTask(TaskList *list, int id, double rank, const char *title, bool completed) {
+    size_t length = strlen(title) + 1;
+    if (list->count == list->capacity && !GrowColumns(list)) {
+        return false;
+    }
+    if (list->titleBytes + length > list->titleCapacity && !GrowTitles(list, list->titleBytes + length)) {
+        return false;
+    }
+
+    memcpy(list->titles + list->titleBytes, title, length);
+    list->ids[list->count] = id;
+    list->ranks[list->count] = rank;
+    list->flags[list->count] = completed ? TASK_COMPLETED : 0;
+    list->dueAts[list->count] = 0;
+    list->repeats[list->count] = 0;
+    list->titleOffsets[list->count] = (unsigned)list->titleBytes;
+    list->titleBytes += length;
+    list->count++;
+    list->titleOffsets[list->count] = (unsigned)list->titleBytes;
+    return true;
+}
+
+// Shifts the later titles down over the removed one and rebases their offsets
+void RemoveTaskAt(TaskList *list, int index) {
+    if (index < 0 || index >= list->count) {
+        return;
+    }
+    unsigned start = list->titleOffsets[index];
+    unsigned end = list->titleOffsets[index + 1];
+    unsigned length = end - start;
+    memmove(list->titles + start, list->titles + end, list->titleBytes - end);
+    list->titleBytes -= length;
+
+    int after = list->count - index - 1;
+    memmove(&list->ids[index], &list->ids[index + 1], after * sizeof(int));
+    memmove(&list->ranks[index], &list->ranks[index + 1], after * sizeof(double));
+    memmove(&list->flags[index], &list->flags[index + 1], after);
+    memmove(&list->dueAts[index], &list->dueAts[index + 1], after * sizeof(long long));
+    memmove(&list->repeats[index], &list->repeats[index + 1], after * sizeof(int));
+    for (int i = index; i < list->count; i++) {
+        list->titleOffsets[i] = list->titleOffsets[i + 1] - length;
+    }
+    list->count--;
+}
+
+// Rotates the columns and the stretch of arena between the two positions
+bool MoveTaskAt(TaskList *list, int from, int to) {
+    if (from < 0 || to < 0 || from >= list->count || to >= list->count) {
+        return false;
+    }
+    if (from == to) {
+        return true;
+    }
+    int id = list->ids[from];
+    double rank = list->ranks[from];
+    unsigned char flags = list->flags[from];
+    long long dueAt = list->dueAts[from];
+    int repeatEvery = list->repeats[from];
+    unsigned start = list->titleOffsets[from];
+    unsigned length = list->titleOffsets[from + 1] - start;
+    char *title = malloc(length);
+    if (title == NULL) {
+        return false;
+    }
+    memcpy(title, list->titles + start, length);
+
+    if (from < to) {
+        unsigned end = list->titleOffsets[to + 1];
+        memmove(list->titles + start, list->titles + start + length, end - start - length);
+        memcpy(list->titles + end - length, title, length);
+        memmove(&list->ids[from], &list->ids[from + 1], (to - from) * sizeof(int));
+        memmove(&list->ranks[from], &list->ranks[from + 1], (to - from) * sizeof(double));
+        memmove(&list->flags[from], &list->flags[from + 1], to - from);
+        memmove(&list->dueAts[from], &list->dueAts[from + 1], (to - from) * sizeof(long long));
+        memmove(&list->repeats[from], &list->repeats[from + 1], (to - from) * sizeof(int));
+        for (int i = from; i < to; i++) {
+            list->titleOffsets[i] = list->titleOffsets[i + 1] - length;
+        }
+        list->titleOffsets[to] = end - length;
+    } else {
+        unsigned first = list->titleOffsets[to];
+        memmove(list->titles + first + length, list->titles + first, start - first);
+        memcpy(list->titles + first, title, length);
+        memmove(&list->ids[to + 1], &list->ids[to], (from - to) * sizeof(int));
+        memmove(&list->ranks[to + 1], &list->ranks[to], (from - to) * sizeof(double));
+        memmove(&list->flags[to + 1], &list->flags[to], from - to);
+        memmove(&list->dueAts[to + 1], &list->dueAts[to], (from - to) * sizeof(long long));
+        memmove(&list->repeats[to + 1], &list->repeats[to], (from - to) * sizeof(int));
+        for (int i = from; i > to; i--) {
+            list->titleOffsets[i] = list->titleOffsets[i - 1] + length;
+        }
+    }
+    free(title);
+    list->ids[to] = id;
+    list->ranks[to] = rank;
+    list->flags[to] = flags;
+    list->dueAts[to] = dueAt;
+    list->repeats[to] = repeatEvery;
+    return true;
+}
+
+void SetTaskCompleted(TaskList *list, int index, bool completed) {
+    if (completed) {
+        list->flags[index] |= TASK_COMPLETED;
+    } else {
+        list->flags[index] &= (unsigned char)~TASK_COMPLETED;
+    }
+}
+
+void SetTaskDueAt(TaskList *list, int index, long long dueAt, int repeatEvery) {
+    list->dueAts[index] = dueAt;
+    list->repeats[index] = repeatEvery;
+}
+
+int FindTaskIndex(const TaskList *list, int id) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->ids[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+Task GetTaskAt(const TaskList *list, int index) {
+    Task task = {
+        .id = list->ids[index],
+        .rank = list->ranks[index],
+        .title = list->titles + list->titleOffsets[index],
+        .completed = (list->flags[index] & TASK_COMPLETED) != 0,
+        .dueAt = list->dueAts[index],
+        .repeatEvery = list->repeats[index],
+    };
+    return task;
+}
+
+TaskKey GetTaskKey(const TaskList *list, int index) {
+    return (TaskKey){list->ranks[index], list->ids[index]};
+}
+
+size_t GetTaskListBytes(const TaskList *list) {
+    size_t columns = list->capacity > 0 ? (size_t)list->capacity * (sizeof(int) * 2 + sizeof(double) + sizeof(long long) + 1) + (list->capacity + 1) * sizeof(unsigned) : 0;
+    return columns + list->titleCapacity;
+}
+
+int CompareTaskKeys(TaskKey a, TaskKey b) {
+    if (a.rank != b.rank) {
+        return a.rank < b.rank ? -1 : 1;
+    }
+    return (a.id > b.id) - (a.id < b.id);
+}
+
+int FindTaskSpan(const TaskSpan *spans, int count, TaskKey key) {
+    int low = 0;
+    int high = count - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (CompareTaskKeys(key, spans[mid].first) < 0) {
+            high = mid - 1;
+        } else if (CompareTaskKeys(key, spans[mid].last) > 0) {
+            low = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,80 @@
+#ifndef TASKLIST_H
+#define TASKLIST_H
+
+#include <float.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TASK_COMPLETED 1 // flags bit
+
+// Where a task sits in its user's list: by rank, ties broken by id
+typedef struct {
+    double rank;
+    int id;
+} TaskKey;
+
+// Before every real task
+#define TASK_KEY_FIRST ((TaskKey){-DBL_MAX, 0})
+#define TASK_KEY_LAST ((TaskKey){DBL_MAX, INT_MAX})
+
+// One task as handed to readers. title points into the owning TaskList's
+// arena and stays valid until that list is next changed.
+typedef struct {
+    int id;
+    double rank;
+    const char *title;
+    bool completed;
+    long long dueAt;  // Unix seconds; 0 for none
+    int repeatEvery;  // Seconds between occurrences; 0 if it doesn't recur
+} Task;
+
+// An inclusive range of list positions, by key. Bulk operations take
+// sorted, disjoint lists of these, so a range over rows that were never
+// loaded is one entry.
+typedef struct {
+    TaskKey first;
+    TaskKey last;
+} TaskSpan;
+
+// Tasks stored column-wise: ids, flags and title offsets in dense arrays,
+// and every title NUL-terminated back to back in one bump arena. A title
+// costs its length plus one byte instead of a fixed buffer, and id lookups
+// only walk the ids. Removing a task closes its gap in the arena, so the
+// arena never holds dead bytes.
+typedef struct {
+    int *ids;
+    double *ranks;
+    unsigned char *flags;
+    long long *dueAts;
+    int *repeats;
+    unsigned *titleOffsets;
+    int count;
+    int capacity;
+    char *titles;
+    size_t titleBytes;
+    size_t titleCapacity;
+} TaskList;
+
+void InitTaskList(TaskList *list);
+void FreeTaskList(TaskList *list);
+// Drops every task from count on; the allocations are kept for reuse
+void TruncateTaskList(TaskList *list, int count);
+bool AppendTask(TaskList *list, int id, double rank, const char *title, bool completed);
+void RemoveTaskAt(TaskList *list, int index);
+// Shifts the tasks in between over by one; the rank is left to the caller
+bool MoveTaskAt(TaskList *list, int from, int to);
+void SetTaskCompleted(TaskList *list, int index, bool completed);
+// Appended tasks start without a due date
+void SetTaskDueAt(TaskList *list, int index, long long dueAt, int repeatEvery);
+// -1 if id isn't in the list
+int FindTaskIndex(const TaskList *list, int id);
+Task GetTaskAt(const TaskList *list, int index);
+TaskKey GetTaskKey(const TaskList *list, int index);
+// Everything the list has allocated, used or not
+size_t GetTaskListBytes(const TaskList *list);
+int CompareTaskKeys(TaskKey a, TaskKey b);
+// Index of the span containing key in a sorted, disjoint list, or -1
+int FindTaskSpan(const TaskSpan *spans, int count, TaskKey key);
+
+#endif
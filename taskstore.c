@@ -0,0 +1,853 @@
+#include "taskstore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+
+static void ClearPage(TaskPage *page) {
+    TruncateTaskList(&page->tasks, 0);
+    page->pageIndex = -1;
+    page->stale = false;
+}
+
+static TaskPage *FindPage(TaskStore *store, int pageIndex) {
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        if (store->window[i].pageIndex == pageIndex) {
+            return &store->window[i];
+        }
+    }
+    return NULL;
+}
+
+// False if the index couldn't grow, leaving the start unknown
+static bool SetPageStart(TaskStore *store, int pageIndex, TaskKey start) {
+    if (pageIndex < store->pageStartCount) {
+        store->pageStarts[pageIndex] = start;
+        return true;
+    }
+    if (pageIndex >= store->pageStartCapacity) {
+        int capacity = store->pageStartCapacity > 0 ? store->pageStartCapacity * 2 : 64;
+        while (capacity <= pageIndex) {
+            capacity *= 2;
+        }
+        TaskKey *starts = realloc(store->pageStarts, capacity * sizeof(TaskKey));
+        if (starts == NULL) {
+            return false;
+        }
+        store->pageStarts = starts;
+        store->pageStartCapacity = capacity;
+    }
+    store->pageStarts[pageIndex] = start;
+    store->pageStartCount = pageIndex + 1;
+    return true;
+}
+
+// Page starts the loader works out with the lock dropped, where nothing
+// else may touch pageStarts: starts[i] is where page first + i begins.
+// Installed once the lock is held again.
+typedef struct {
+    int first;
+    TaskKey *starts;
+    int count;
+    int capacity;
+} FoundStarts;
+
+static bool AddFoundStart(FoundStarts *found, TaskKey start) {
+    if (found->count == found->capacity) {
+        int capacity = found->capacity > 0 ? found->capacity * 2 : 16;
+        TaskKey *starts = realloc(found->starts, capacity * sizeof(TaskKey));
+        if (starts == NULL) {
+            return false;
+        }
+        found->starts = starts;
+        found->capacity = capacity;
+    }
+    found->starts[found->count++] = start;
+    return true;
+}
+
+// Walk page boundaries forward from the known start of page knownIndex
+// until we know where pageIndex starts
+static bool FindPageStart(TaskStore *store, int knownIndex, TaskKey known, int pageIndex, FoundStarts *found, TaskKey *start) {
+    *start = known;
+    for (int p = knownIndex; p < pageIndex; p++) {
+        sqlite3_stmt *stmt = BeginStatement(store->reader, STMT_SELECT_PAGE_START);
+        sqlite3_bind_int(stmt, 1, store->userId);
+        sqlite3_bind_double(stmt, 2, start->rank);
+        sqlite3_bind_int(stmt, 3, start->id);
+        sqlite3_bind_int(stmt, 4, TASK_PAGE_SIZE - 1);
+        atomic_fetch_add(&store->taskQueries, 1);
+        bool exists = StepStatement(store->reader, stmt) == SQLITE_ROW;
+        TaskKey nextStart = {0};
+        if (exists) {
+            nextStart.rank = sqlite3_column_double(stmt, 0);
+            nextStart.id = sqlite3_column_int(stmt, 1);
+        }
+        EndStatement(store->reader, stmt);
+        if (!exists || !AddFoundStart(found, nextStart)) {
+            return false;
+        }
+        *start = nextStart;
+    }
+    return true;
+}
+
+// Runs unlocked; the starts it finds past knownIndex are left in found
+static void LoadPage(TaskStore *store, int pageIndex, int knownIndex, TaskKey known, FoundStarts *found, TaskPage *page) {
+    ClearPage(page);
+    page->pageIndex = pageIndex;
+    found->first = knownIndex + 1;
+    found->count = 0;
+
+    TaskKey start;
+    if (!FindPageStart(store, knownIndex, known, pageIndex, found, &start)) {
+        return;
+    }
+
+    atomic_fetch_add(&store->taskQueries, 1);
+    int count = ListTasks(store->userId, start, &page->tasks, TASK_PAGE_SIZE, store->reader);
+    if (count == TASK_PAGE_SIZE) {
+        AddFoundStart(found, GetTaskKey(&page->tasks, count - 1));
+    }
+}
+
+// Called with the lock held, once the page they came with has been taken
+static void InstallFoundStarts(TaskStore *store, const FoundStarts *found) {
+    if (store->pageStartCount == 0 && !SetPageStart(store, 0, TASK_KEY_FIRST)) {
+        return;
+    }
+    for (int i = 0; i < found->count && found->first + i <= store->pageStartCount; i++) {
+        if (!SetPageStart(store, found->first + i, found->starts[i])) {
+            return;
+        }
+    }
+}
+
+// A lookup in task_counts rather than a count over the user's rows, plus
+// the first open task due after now, when overdue next goes up
+static TaskCounts ReadCounts(TaskStore *store, long long *nextDueAt) {
+    long long now = time(NULL);
+    TaskCounts counts = {0};
+    if (!ReadTaskCounts(store->userId, now, &counts, store->reader)) {
+        // No counts row, which VerifyTaskCounts reports; the list only needs the total
+        sqlite3_stmt *stmt = BeginStatement(store->reader, STMT_COUNT_TASKS);
+        sqlite3_bind_int(stmt, 1, store->userId);
+        counts.total = StepStatement(store->reader, stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+        EndStatement(store->reader, stmt);
+    }
+
+    sqlite3_stmt *stmt = BeginStatement(store->reader, STMT_SELECT_DUE_TASKS);
+    sqlite3_bind_int(stmt, 1, store->userId);
+    sqlite3_bind_int64(stmt, 2, now);
+    sqlite3_bind_int(stmt, 3, INT_MAX);
+    sqlite3_bind_int64(stmt, 4, LLONG_MAX);
+    sqlite3_bind_int(stmt, 5, 1);
+    *nextDueAt = StepStatement(store->reader, stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 1) : 0;
+    EndStatement(store->reader, stmt);
+    return counts;
+}
+
+// After rows came or went
+static TaskCounts CountTasks(TaskStore *store, long long *nextDueAt) {
+    atomic_fetch_add(&store->taskQueries, 1);
+    return ReadCounts(store, nextDueAt);
+}
+
+static int ReadDataVersion(TaskStore *store) {
+    sqlite3_stmt *stmt = BeginStatement(store->reader, STMT_DATA_VERSION);
+    int version = StepStatement(store->reader, stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    EndStatement(store->reader, stmt);
+    return version;
+}
+
+typedef struct {
+    int taskId;
+    TaskChangeKind kind;
+    double rank;   // Where the row was; where it went for an insert
+    int row;       // Index into TaskFeed.rows, or -1 once the task is gone
+} TaskChange;
+
+// One batch off task_changes, read by the loader without the lock held
+typedef struct {
+    TaskChange changes[TASK_FEED_BATCH];
+    int count;
+    long long lastSeq;
+    TaskList rows;  // The changed tasks as they are now
+} TaskFeed;
+
+// Oldest and newest sequence numbers still in task_changes
+static void ReadFeedBounds(TaskStore *store, long long *oldest, long long *newest) {
+    sqlite3_stmt *stmt = BeginStatement(store->reader, STMT_FEED_BOUNDS);
+    bool found = StepStatement(store->reader, stmt) == SQLITE_ROW;
+    *oldest = found ? sqlite3_column_int64(stmt, 0) : 0;
+    *newest = found ? sqlite3_column_int64(stmt, 1) : 0;
+    EndStatement(store->reader, stmt);
+}
+
+// False when changes after `after` were trimmed before we read them, or the
+// batch couldn't be read in full
+static bool ReadTaskFeed(TaskStore *store, long long after, TaskFeed *feed) {
+    feed->count = 0;
+    feed->lastSeq = after;
+    TruncateTaskList(&feed->rows, 0);
+
+    long long oldest, newest;
+    ReadFeedBounds(store, &oldest, &newest);
+    if (oldest > after + 1) {
+        return false;
+    }
+
+    atomic_fetch_add(&store->taskQueries, 1);
+    sqlite3_stmt *stmt = BeginStatement(store->reader, STMT_SELECT_CHANGES);
+    sqlite3_bind_int(stmt, 1, store->userId);
+    sqlite3_bind_int64(stmt, 2, after);
+    sqlite3_bind_int(stmt, 3, TASK_FEED_BATCH);
+    int rc;
+    while ((rc = StepStatement(store->reader, stmt)) == SQLITE_ROW) {
+        TaskChange *change = &feed->changes[feed->count++];
+        feed->lastSeq = sqlite3_column_int64(stmt, 0);
+        change->taskId = sqlite3_column_int(stmt, 1);
+        change->kind = (TaskChangeKind)sqlite3_column_int(stmt, 2);
+        change->rank = sqlite3_column_double(stmt, 3);
+        change->row = -1;
+        if (sqlite3_column_type(stmt, 6) != SQLITE_NULL) {
+            if (!AppendTask(&feed->rows, change->taskId, sqlite3_column_double(stmt, 6),
+                            (const char *)sqlite3_column_text(stmt, 4), sqlite3_column_int(stmt, 5) != 0)) {
+                break;
+            }
+            change->row = feed->rows.count - 1;
+            SetTaskDueAt(&feed->rows, change->row, sqlite3_column_int64(stmt, 7), sqlite3_column_int(stmt, 8));
+        }
+    }
+    EndStatement(store->reader, stmt);
+    return rc == SQLITE_DONE;
+}
+
+// Pick the slot furthest from the wanted range so scrolling back is cheap
+static TaskPage *PickVictim(TaskStore *store, int first, int last) {
+    TaskPage *victim = &store->window[0];
+    int victimDistance = -1;
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        TaskPage *page = &store->window[i];
+        if (page->pageIndex < 0) {
+            return page;
+        }
+        int distance = page->pageIndex < first ? first - page->pageIndex
+                     : page->pageIndex > last ? page->pageIndex - last : 0;
+        if (distance > victimDistance) {
+            victim = page;
+            victimDistance = distance;
+        }
+    }
+    return victim;
+}
+
+// Next page the window is missing, or -1 when everything wanted is resident
+static int NextMissingPage(TaskStore *store) {
+    int lastPage = store->totalTasks > 0 ? (store->totalTasks - 1) / TASK_PAGE_SIZE : 0;
+    // One page of read-ahead past what is on screen
+    int last = store->wantedLastPage + 1;
+    if (last - store->wantedFirstPage >= TASK_WINDOW_PAGES) {
+        last = store->wantedFirstPage + TASK_WINDOW_PAGES - 1;
+    }
+    if (last > lastPage) {
+        last = lastPage;
+    }
+    for (int p = store->wantedFirstPage; p <= last; p++) {
+        TaskPage *page = FindPage(store, p);
+        // A short page should end the list; if the count says otherwise,
+        // rows arrived since it was read
+        if (page == NULL || page->stale ||
+            (page->tasks.count < TASK_PAGE_SIZE && p * TASK_PAGE_SIZE + page->tasks.count < store->totalTasks)) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+static TaskPage *FindTaskPage(TaskStore *store, int id, int *slot) {
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        *slot = FindTaskIndex(&store->window[i].tasks, id);
+        if (*slot >= 0) {
+            return &store->window[i];
+        }
+    }
+    return NULL;
+}
+
+// The page key falls on, going by the page starts we know. Lock held, as for
+// FindCoveringPage; the loader only installs starts it found once relocked
+static int FindKeyPage(TaskStore *store, TaskKey key) {
+    int known = store->pageStartCount < store->pageStartLimit ? store->pageStartCount : store->pageStartLimit;
+    int low = 0;
+    int high = known - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (CompareTaskKeys(store->pageStarts[mid], key) < 0) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+// The resident page whose stretch of the list key falls in, if any. A full
+// page ends at its last row; a short one is the end of the list.
+static TaskPage *FindCoveringPage(TaskStore *store, TaskKey key) {
+    TaskPage *page = FindPage(store, FindKeyPage(store, key));
+    if (page == NULL) {
+        return NULL;
+    }
+    int count = page->tasks.count;
+    if (count == TASK_PAGE_SIZE && CompareTaskKeys(key, GetTaskKey(&page->tasks, count - 1)) > 0) {
+        return NULL;
+    }
+    return page;
+}
+
+// A row we don't hold appeared or went at key: its page and every later
+// one shift by a row, while earlier ones are untouched
+static void ShiftPagesAt(TaskStore *store, TaskKey key) {
+    int pageIndex = FindKeyPage(store, key);
+    TaskPage *page = FindCoveringPage(store, key);
+    if (page != NULL) {
+        page->stale = true;
+    }
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        if (store->window[i].pageIndex > pageIndex) {
+            ClearPage(&store->window[i]);
+        }
+    }
+    if (store->pageStartLimit > pageIndex + 1) {
+        store->pageStartLimit = pageIndex + 1;
+    }
+}
+
+// A move that stays inside one resident page, and doesn't take or replace
+// the page's last row (the next page's start key), is patched in place;
+// anything else shifts rows across page boundaries and is reloaded.
+static void MoveCachedTask(TaskStore *store, int id, double rank) {
+    int slot;
+    TaskPage *page = FindTaskPage(store, id, &slot);
+    TaskKey key = {rank, id};
+    bool patched = false;
+    if (page != NULL && page->pageIndex < store->pageStartCount) {
+        TaskList *tasks = &page->tasks;
+        int last = tasks->count - 1;
+        bool inside = slot != last && CompareTaskKeys(key, store->pageStarts[page->pageIndex]) > 0 &&
+                      CompareTaskKeys(key, GetTaskKey(tasks, last)) < 0;
+        if (inside) {
+            int to = 0;
+            for (int i = 0; i < tasks->count; i++) {
+                if (i != slot && CompareTaskKeys(GetTaskKey(tasks, i), key) < 0) {
+                    to++;
+                }
+            }
+            patched = MoveTaskAt(tasks, slot, to);
+            if (patched) {
+                tasks->ranks[to] = rank;
+            }
+        }
+    }
+    if (!patched) {
+        store->generation++;
+        store->stats.invalidations++;
+        pthread_cond_signal(&store->wake);
+    }
+}
+
+// Removing a row shifts every later row back by one, so later pages are
+// dropped and the row's own page is marked for a refill of its tail. Pages
+// before it are untouched. False if the row isn't resident.
+static bool RemoveCachedTask(TaskStore *store, int id) {
+    int slot;
+    TaskPage *page = FindTaskPage(store, id, &slot);
+    if (page == NULL) {
+        return false;
+    }
+    int pageIndex = page->pageIndex;
+    RemoveTaskAt(&page->tasks, slot);
+    store->totalTasks--;
+    page->stale = store->totalTasks > pageIndex * TASK_PAGE_SIZE + page->tasks.count;
+
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        if (store->window[i].pageIndex > pageIndex) {
+            ClearPage(&store->window[i]);
+        }
+    }
+    if (store->pageStartLimit > pageIndex + 1) {
+        store->pageStartLimit = pageIndex + 1;
+    }
+    return true;
+}
+
+// A row we don't hold arriving anywhere in the list: appended when it lands
+// past the last row of a tail page we hold, the usual insert; otherwise
+// everything from its page on reloads
+static void InsertCachedTask(TaskStore *store, const Task *task) {
+    TaskKey key = {task->rank, task->id};
+    TaskPage *tail = FindCoveringPage(store, key);
+    int count = tail != NULL ? tail->tasks.count : 0;
+    if (tail != NULL && !tail->stale && count < TASK_PAGE_SIZE &&
+        (count == 0 || CompareTaskKeys(key, GetTaskKey(&tail->tasks, count - 1)) > 0) &&
+        AppendTask(&tail->tasks, task->id, task->rank, task->title, task->completed)) {
+        SetTaskDueAt(&tail->tasks, count, task->dueAt, task->repeatEvery);
+        store->totalTasks++;
+        return;
+    }
+    ShiftPagesAt(store, key);
+}
+
+// Bring the window in line with one changed row as it is now. Everything is
+// checked against what is resident, so a change that was already patched in
+// (our own, or one a page was read after) leaves the window as it is.
+static void ApplyFeedChange(TaskStore *store, const TaskChange *change, const TaskList *rows) {
+    int slot;
+    TaskPage *page = FindTaskPage(store, change->taskId, &slot);
+    if (page != NULL) {
+        if (change->row < 0) {
+            RemoveCachedTask(store, change->taskId);
+            return;
+        }
+        Task task = GetTaskAt(rows, change->row);
+        SetTaskCompleted(&page->tasks, slot, task.completed);
+        SetTaskDueAt(&page->tasks, slot, task.dueAt, task.repeatEvery);
+        // Titles live in the page's arena, so a renamed row reloads its page
+        if (strcmp(GetTaskAt(&page->tasks, slot).title, task.title) != 0) {
+            page->stale = true;
+        }
+        if (page->tasks.ranks[slot] != task.rank) {
+            MoveCachedTask(store, task.id, task.rank);
+        }
+        return;
+    }
+
+    // A row leaving a stretch we hold has already been patched out of it
+    TaskKey was = {change->rank, change->taskId};
+    if ((change->kind == TASK_CHANGE_MOVED || change->kind == TASK_CHANGE_DELETED) &&
+        FindCoveringPage(store, was) == NULL) {
+        ShiftPagesAt(store, was);
+    }
+    if (change->row < 0 || change->kind == TASK_CHANGE_UPDATED) {
+        return;
+    }
+
+    Task task = GetTaskAt(rows, change->row);
+    InsertCachedTask(store, &task);
+}
+
+// Apply every change since feedSeq, a batch at a time. Called and returns
+// with the lock held. False when the feed can't bring the window up to date
+// and it has to be reloaded.
+static bool FollowTaskFeed(TaskStore *store, TaskFeed *feed) {
+    for (;;) {
+        long long after = store->feedSeq;
+        int generation = store->generation;
+        pthread_mutex_unlock(&store->lock);
+        bool complete = ReadTaskFeed(store, after, feed);
+        pthread_mutex_lock(&store->lock);
+        if (generation != store->generation) {
+            // Already reloading, which starts over from the newest change
+            return true;
+        }
+        if (!complete) {
+            return false;
+        }
+
+        // Pages read since a row came or went may already count it, so the
+        // counts are read again rather than adjusted
+        for (int i = 0; i < feed->count; i++) {
+            ApplyFeedChange(store, &feed->changes[i], &feed->rows);
+        }
+        store->recount |= feed->count > 0;
+        store->feedSeq = feed->lastSeq;
+        store->stats.feedChanges += feed->count;
+        if (feed->count > 0) {
+            atomic_fetch_add(&store->changeCount, 1);
+        }
+        if (feed->count < TASK_FEED_BATCH) {
+            return true;
+        }
+    }
+}
+
+static void *LoaderMain(void *arg) {
+    TaskStore *store = arg;
+    // Pages are read here unlocked, then swapped into their window slot
+    TaskPage loading;
+    InitTaskList(&loading.tasks);
+    TaskFeed feed;
+    InitTaskList(&feed.rows);
+    FoundStarts found = {0};
+
+    pthread_mutex_lock(&store->lock);
+    while (!store->quit) {
+        if (store->loadedGeneration != store->generation) {
+            int generation = store->generation;
+            pthread_mutex_unlock(&store->lock);
+            // Feed rows committed while the pages load are applied again on
+            // top of them, which changes nothing
+            int version = ReadDataVersion(store);
+            long long oldest, newest;
+            ReadFeedBounds(store, &oldest, &newest);
+            long long nextDueAt;
+            TaskCounts counts = CountTasks(store, &nextDueAt);
+            pthread_mutex_lock(&store->lock);
+            store->dataVersion = version;
+            if (generation == store->generation) {
+                for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+                    ClearPage(&store->window[i]);
+                }
+                store->pageStartCount = 0;
+                store->pageStartLimit = INT_MAX;
+                SetPageStart(store, 0, TASK_KEY_FIRST);
+                store->totalTasks = counts.total;
+                store->counts = counts;
+                store->nextDueAt = nextDueAt;
+                store->feedSeq = newest;
+                store->recount = false;
+                store->loadedGeneration = generation;
+                atomic_fetch_add(&store->changeCount, 1);
+            }
+            continue;
+        }
+
+        if (store->recount) {
+            store->recount = false;
+            int generation = store->generation;
+            pthread_mutex_unlock(&store->lock);
+            long long nextDueAt;
+            TaskCounts counts = CountTasks(store, &nextDueAt);
+            pthread_mutex_lock(&store->lock);
+            if (generation == store->generation) {
+                store->totalTasks = counts.total;
+                store->counts = counts;
+                store->nextDueAt = nextDueAt;
+                atomic_fetch_add(&store->changeCount, 1);
+            }
+            continue;
+        }
+
+        int pageIndex = NextMissingPage(store);
+        if (pageIndex < 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += DATA_VERSION_POLL_MS / 1000;
+            deadline.tv_nsec += (DATA_VERSION_POLL_MS % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            if (pthread_cond_timedwait(&store->wake, &store->lock, &deadline) != ETIMEDOUT) {
+                continue;
+            }
+
+            // Idle: a cheap pragma tells us whether anyone else committed
+            pthread_mutex_unlock(&store->lock);
+            int version = ReadDataVersion(store);
+            pthread_mutex_lock(&store->lock);
+            store->stats.versionChecks++;
+            if (version != store->dataVersion && store->loadedGeneration == store->generation) {
+                store->dataVersion = version;
+                if (!FollowTaskFeed(store, &feed)) {
+                    store->generation++;
+                    store->stats.invalidations++;
+                }
+            } else if (store->nextDueAt > 0 && time(NULL) >= store->nextDueAt) {
+                // Nothing committed, but an open task has fallen overdue
+                int generation = store->generation;
+                pthread_mutex_unlock(&store->lock);
+                long long nextDueAt;
+                TaskCounts counts = ReadCounts(store, &nextDueAt);
+                pthread_mutex_lock(&store->lock);
+                store->stats.overdueRefreshes++;
+                if (generation == store->generation && !store->recount) {
+                    store->nextDueAt = nextDueAt;
+                    if (counts.overdue != store->counts.overdue) {
+                        store->counts.overdue = counts.overdue;
+                        atomic_fetch_add(&store->changeCount, 1);
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Deletes only record how much of the page start index went stale;
+        // it is trimmed here, and the nearest start the query below can
+        // walk on from is copied out, since it runs unlocked
+        if (store->pageStartCount > store->pageStartLimit) {
+            store->pageStartCount = store->pageStartLimit;
+        }
+        store->pageStartLimit = INT_MAX;
+        int knownIndex = 0;
+        TaskKey known = TASK_KEY_FIRST;
+        if (store->pageStartCount > 0) {
+            knownIndex = pageIndex < store->pageStartCount ? pageIndex : store->pageStartCount - 1;
+            known = store->pageStarts[knownIndex];
+        }
+
+        int generation = store->generation;
+        int deltaSerial = store->deltaSerial;
+        pthread_mutex_unlock(&store->lock);
+        LoadPage(store, pageIndex, knownIndex, known, &found, &loading);
+        pthread_mutex_lock(&store->lock);
+
+        // A page read while a delta landed may predate it, and so may the
+        // starts found on the way; drop them and retry
+        if (generation == store->generation && deltaSerial == store->deltaSerial) {
+            InstallFoundStarts(store, &found);
+            // Rows went since the count was taken
+            int count = loading.tasks.count;
+            if (count < TASK_PAGE_SIZE && pageIndex * TASK_PAGE_SIZE + count < store->totalTasks) {
+                store->recount = true;
+            }
+            TaskPage *slot = FindPage(store, pageIndex);
+            if (slot == NULL) {
+                slot = PickVictim(store, store->wantedFirstPage, store->wantedLastPage);
+            }
+            TaskPage evicted = *slot;
+            *slot = loading;
+            loading = evicted;
+            atomic_fetch_add(&store->changeCount, 1);
+        }
+        ClearPage(&loading);
+    }
+    pthread_mutex_unlock(&store->lock);
+    FreeTaskList(&loading.tasks);
+    FreeTaskList(&feed.rows);
+    free(found.starts);
+    return NULL;
+}
+
+TaskStore *CreateTaskStore(const char *path, int userId) {
+    TaskStore *store = calloc(1, sizeof(TaskStore));
+    if (store == NULL) {
+        return NULL;
+    }
+
+    store->reader = OpenDatabase(path);
+    if (store->reader == NULL) {
+        free(store);
+        return NULL;
+    }
+
+    store->userId = userId;
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        store->window[i].pageIndex = -1;
+        InitTaskList(&store->window[i].tasks);
+    }
+    store->totalTasks = -1;
+    store->generation = 1;
+    store->pageStartLimit = INT_MAX;
+    SetPageStart(store, 0, TASK_KEY_FIRST);
+
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->wake, NULL);
+    pthread_create(&store->loader, NULL, LoaderMain, store);
+    return store;
+}
+
+void DestroyTaskStore(TaskStore *store) {
+    if (store == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&store->lock);
+    store->quit = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+    pthread_join(store->loader, NULL);
+
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        FreeTaskList(&store->window[i].tasks);
+    }
+    free(store->pageStarts);
+    pthread_cond_destroy(&store->wake);
+    pthread_mutex_destroy(&store->lock);
+    CloseDatabase(store->reader);
+    free(store);
+}
+
+// Mark the cached pages stale; the current window stays visible until the
+// loader has the new count
+void InvalidateTaskStore(TaskStore *store) {
+    pthread_mutex_lock(&store->lock);
+    store->generation++;
+    store->stats.invalidations++;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Tell the loader which rows are on screen
+void RequestTaskRange(TaskStore *store, int first, int last) {
+    int firstPage = first / TASK_PAGE_SIZE;
+    int lastPage = last / TASK_PAGE_SIZE;
+
+    pthread_mutex_lock(&store->lock);
+    if (firstPage != store->wantedFirstPage || lastPage != store->wantedLastPage) {
+        store->wantedFirstPage = firstPage;
+        store->wantedLastPage = lastPage;
+        pthread_cond_signal(&store->wake);
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+// New rows are ranked after every other, so they always land at the end.
+// The feed may have got there first, in which case the row is resident;
+// when it can't be appended we can't tell, so the counts are read again.
+void ApplyTaskAdded(TaskStore *store, int id, double rank, const char *title, long long dueAt, int repeatEvery) {
+    pthread_mutex_lock(&store->lock);
+    int slot;
+    if (store->totalTasks >= 0 && FindTaskPage(store, id, &slot) == NULL) {
+        TaskPage *tail = FindPage(store, store->totalTasks / TASK_PAGE_SIZE);
+        if (tail != NULL && tail->tasks.count == store->totalTasks % TASK_PAGE_SIZE &&
+            AppendTask(&tail->tasks, id, rank, title, false)) {
+            SetTaskDueAt(&tail->tasks, tail->tasks.count - 1, dueAt, repeatEvery);
+        }
+        store->totalTasks++;
+    }
+    store->deltaSerial++;
+    store->recount = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+void ApplyTaskCompleted(TaskStore *store, int id, bool completed) {
+    pthread_mutex_lock(&store->lock);
+    int slot;
+    TaskPage *page = FindTaskPage(store, id, &slot);
+    if (page != NULL) {
+        SetTaskCompleted(&page->tasks, slot, completed);
+    }
+    store->deltaSerial++;
+    store->recount = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+void ApplyTaskDue(TaskStore *store, int id, long long dueAt, int repeatEvery) {
+    pthread_mutex_lock(&store->lock);
+    int slot;
+    TaskPage *page = FindTaskPage(store, id, &slot);
+    if (page != NULL) {
+        SetTaskDueAt(&page->tasks, slot, dueAt, repeatEvery);
+    }
+    store->deltaSerial++;
+    store->recount = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+void ApplyTasksCompleted(TaskStore *store, const TaskSpan *spans, int spanCount, bool completed) {
+    pthread_mutex_lock(&store->lock);
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        TaskList *tasks = &store->window[i].tasks;
+        for (int j = 0; j < tasks->count; j++) {
+            if (FindTaskSpan(spans, spanCount, GetTaskKey(tasks, j)) >= 0) {
+                SetTaskCompleted(tasks, j, completed);
+            }
+        }
+    }
+    store->deltaSerial++;
+    store->recount = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+void ApplyTaskMoved(TaskStore *store, int id, double rank) {
+    pthread_mutex_lock(&store->lock);
+    MoveCachedTask(store, id, rank);
+    store->deltaSerial++;
+    pthread_mutex_unlock(&store->lock);
+}
+
+// A deleted row put back where it was, which can be anywhere in the list
+void ApplyTaskRestored(TaskStore *store, const Task *task) {
+    pthread_mutex_lock(&store->lock);
+    int slot;
+    if (store->totalTasks >= 0 && FindTaskPage(store, task->id, &slot) == NULL) {
+        InsertCachedTask(store, task);
+    }
+    store->deltaSerial++;
+    store->recount = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+void ApplyTaskDeleted(TaskStore *store, int id) {
+    pthread_mutex_lock(&store->lock);
+    if (!RemoveCachedTask(store, id)) {
+        // Not resident, so we can't tell which page shifted
+        store->generation++;
+        store->stats.invalidations++;
+    }
+    store->deltaSerial++;
+    store->recount = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+void LockTaskStore(TaskStore *store) {
+    pthread_mutex_lock(&store->lock);
+}
+
+void UnlockTaskStore(TaskStore *store) {
+    pthread_mutex_unlock(&store->lock);
+}
+
+bool GetTask(TaskStore *store, int index, Task *task) {
+    if (index < 0 || index >= store->totalTasks) {
+        return false;
+    }
+    TaskPage *page = FindPage(store, index / TASK_PAGE_SIZE);
+    if (page == NULL || index % TASK_PAGE_SIZE >= page->tasks.count) {
+        return false;
+    }
+    *task = GetTaskAt(&page->tasks, index % TASK_PAGE_SIZE);
+    return true;
+}
+
+int GetTaskCount(TaskStore *store) {
+    return store->totalTasks < 0 ? 0 : store->totalTasks;
+}
+
+unsigned GetTaskStoreChangeCount(TaskStore *store) {
+    return atomic_load(&store->changeCount);
+}
+
+// True once the count is current and every requested page is resident
+bool IsTaskStoreSettled(TaskStore *store) {
+    pthread_mutex_lock(&store->lock);
+    bool settled = store->loadedGeneration == store->generation && !store->recount && NextMissingPage(store) < 0;
+    pthread_mutex_unlock(&store->lock);
+    return settled;
+}
+
+TaskCounts GetTaskStoreCounts(TaskStore *store) {
+    pthread_mutex_lock(&store->lock);
+    TaskCounts counts = store->counts;
+    pthread_mutex_unlock(&store->lock);
+    return counts;
+}
+
+TaskStoreStats GetTaskStoreStats(TaskStore *store) {
+    pthread_mutex_lock(&store->lock);
+    TaskStoreStats stats = store->stats;
+    for (int i = 0; i < TASK_WINDOW_PAGES; i++) {
+        stats.residentTasks += store->window[i].tasks.count;
+        stats.residentBytes += GetTaskListBytes(&store->window[i].tasks);
+    }
+    pthread_mutex_unlock(&store->lock);
+    stats.taskQueries = atomic_load(&store->taskQueries);
+    return stats;
+}
+
+void PrintTaskStoreStats(TaskStore *store) {
+    TaskStoreStats stats = GetTaskStoreStats(store);
+    printf("Task store: %ld task queries, %ld version checks, %ld overdue refreshes, %ld feed changes, %ld invalidations\n",
+           stats.taskQueries, stats.versionChecks, stats.overdueRefreshes, stats.feedChanges, stats.invalidations);
+    printf("Task store: %d resident tasks in %zu bytes (%.1f bytes/task)\n", stats.residentTasks,
+           stats.residentBytes, stats.residentTasks > 0 ? (double)stats.residentBytes / stats.residentTasks : 0.0);
+}
@@ -0,0 +1,112 @@
+#ifndef TASKSTORE_H
+#define TASKSTORE_H
+
+#include "db.h"
+#include "taskcore.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define TASK_PAGE_SIZE 64
+#define TASK_WINDOW_PAGES 4
+#define DATA_VERSION_POLL_MS 1000
+#define TASK_FEED_BATCH 256 // Changes read from task_changes per query
+
+// task_changes.kind, as written by the schema's triggers
+typedef enum {
+    TASK_CHANGE_ADDED,
+    TASK_CHANGE_UPDATED,  // Anything but the rank
+    TASK_CHANGE_MOVED,
+    TASK_CHANGE_DELETED
+} TaskChangeKind;
+
+typedef struct {
+    int pageIndex;  // -1 when the slot is empty
+    bool stale;     // Lost a row to a delete and must be refilled
+    TaskList tasks; // Allocations are kept across reloads of the slot
+} TaskPage;
+
+typedef struct {
+    long taskQueries;    // Page, boundary and count queries against tasks
+    long versionChecks;
+    long overdueRefreshes; // Idle recounts because an open task fell due
+    long invalidations;
+    long feedChanges;    // Rows read from the change feed
+    int residentTasks;   // Rows held in the window right now...
+    size_t residentBytes; // ...and everything their pages have allocated
+} TaskStoreStats;
+
+// Keyset-paginated view of one user's tasks. Only TASK_WINDOW_PAGES pages are
+// kept in memory; a loader thread with its own connection fills the window
+// around the rows the UI asks for and prefetches the page after it.
+//
+// Our own mutations are patched into the resident pages with the ApplyTask*
+// calls. When the loader sees PRAGMA data_version move it tails the
+// task_changes feed from the last sequence number it applied and patches in
+// just those rows, whichever connection or process wrote them; patching is
+// idempotent, so our own changes coming back through the feed are no-ops.
+// Row counts are re-queried after rows come or go. The whole cache is only
+// dropped by InvalidateTaskStore (an explicit resync), for changes whose
+// effect on page boundaries can't be worked out, or when the loader fell so
+// far behind that the feed was trimmed past it.
+typedef struct {
+    int userId;
+    Database *reader;
+
+    pthread_t loader;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool quit;
+
+    TaskPage window[TASK_WINDOW_PAGES];
+    int totalTasks;      // -1 until counted
+    int wantedFirstPage;
+    int wantedLastPage;
+    int generation;      // Bumped by InvalidateTaskStore
+    int loadedGeneration;
+    int dataVersion;     // As of the last reload
+    int deltaSerial;     // Bumped by every ApplyTask* call
+    long long feedSeq;   // Last task_changes row applied
+    TaskCounts counts;   // From task_counts, as of the last count
+    long long nextDueAt; // First open task due after that count, 0 if none
+    bool recount;        // totalTasks and counts may be off since a write
+    int pageStartLimit;  // Page starts at or past this index are stale
+    atomic_long taskQueries; // Counted outside the lock by the loader
+    atomic_uint changeCount; // Bumped whenever the loader changes what GetTask returns
+    TaskStoreStats stats;
+
+    // pageStarts[p] is the key every row on page p comes after. Only read or
+    // written with the lock held, loader included
+    TaskKey *pageStarts;
+    int pageStartCount;
+    int pageStartCapacity;
+} TaskStore;
+
+TaskStore *CreateTaskStore(const char *path, int userId);
+void DestroyTaskStore(TaskStore *store);
+void InvalidateTaskStore(TaskStore *store);
+void RequestTaskRange(TaskStore *store, int first, int last);
+void ApplyTaskAdded(TaskStore *store, int id, double rank, const char *title, long long dueAt, int repeatEvery);
+void ApplyTaskCompleted(TaskStore *store, int id, bool completed);
+void ApplyTaskDeleted(TaskStore *store, int id);
+void ApplyTaskRestored(TaskStore *store, const Task *task);
+void ApplyTaskMoved(TaskStore *store, int id, double rank);
+void ApplyTaskDue(TaskStore *store, int id, long long dueAt, int repeatEvery);
+// One bulk commit that set completed on every task inside spans
+void ApplyTasksCompleted(TaskStore *store, const TaskSpan *spans, int spanCount, bool completed);
+
+// GetTask and GetTaskCount must be called between LockTaskStore/UnlockTaskStore,
+// and the title GetTask fills in is only valid until the unlock. GetTask
+// returns false while the row's page is still loading.
+void LockTaskStore(TaskStore *store);
+void UnlockTaskStore(TaskStore *store);
+bool GetTask(TaskStore *store, int index, Task *task);
+int GetTaskCount(TaskStore *store);
+TaskStoreStats GetTaskStoreStats(TaskStore *store);
+// Locks on its own; the loader refreshes overdue while idle
+TaskCounts GetTaskStoreCounts(TaskStore *store);
+unsigned GetTaskStoreChangeCount(TaskStore *store);
+bool IsTaskStoreSettled(TaskStore *store);
+void PrintTaskStoreStats(TaskStore *store);
+
+#endif
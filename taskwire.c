@@ -0,0 +1,186 @@
+#include "taskwire.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WIRE_INITIAL_CAPACITY 4096
+
+void InitWireBuffer(WireBuffer *buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->failed = false;
+}
+
+void FreeWireBuffer(WireBuffer *buffer) {
+    free(buffer->data);
+    InitWireBuffer(buffer);
+}
+
+bool ReserveWireBuffer(WireBuffer *buffer, size_t size) {
+    if (buffer->failed) {
+        return false;
+    }
+    if (buffer->capacity - buffer->length >= size) {
+        return true;
+    }
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : WIRE_INITIAL_CAPACITY;
+    while (capacity - buffer->length < size) {
+        capacity *= 2;
+    }
+    unsigned char *data = realloc(buffer->data, capacity);
+    if (data == NULL) {
+        buffer->failed = true;
+        return false;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+void ConsumeWireBuffer(WireBuffer *buffer, size_t size) {
+    if (size >= buffer->length) {
+        buffer->length = 0;
+        return;
+    }
+    memmove(buffer->data, buffer->data + size, buffer->length - size);
+    buffer->length -= size;
+}
+
+static void PutBytes(WireBuffer *buffer, const void *bytes, size_t size) {
+    if (ReserveWireBuffer(buffer, size)) {
+        memcpy(buffer->data + buffer->length, bytes, size);
+        buffer->length += size;
+    }
+}
+
+static void StoreU32(unsigned char *bytes, unsigned value) {
+    bytes[0] = (unsigned char)(value >> 24);
+    bytes[1] = (unsigned char)(value >> 16);
+    bytes[2] = (unsigned char)(value >> 8);
+    bytes[3] = (unsigned char)value;
+}
+
+static unsigned LoadU32(const unsigned char *bytes) {
+    return (unsigned)bytes[0] << 24 | (unsigned)bytes[1] << 16 | (unsigned)bytes[2] << 8 | bytes[3];
+}
+
+size_t BeginWireFrame(WireBuffer *buffer) {
+    size_t start = buffer->length;
+    PutWireU32(buffer, 0);
+    return start;
+}
+
+void EndWireFrame(WireBuffer *buffer, size_t start) {
+    if (!buffer->failed) {
+        StoreU32(buffer->data + start, (unsigned)(buffer->length - start - WIRE_HEADER_LEN));
+    }
+}
+
+void PutWireU8(WireBuffer *buffer, unsigned value) {
+    unsigned char byte = (unsigned char)value;
+    PutBytes(buffer, &byte, 1);
+}
+
+void PutWireU16(WireBuffer *buffer, unsigned value) {
+    unsigned char bytes[2] = {(unsigned char)(value >> 8), (unsigned char)value};
+    PutBytes(buffer, bytes, 2);
+}
+
+void PutWireU32(WireBuffer *buffer, unsigned value) {
+    unsigned char bytes[4];
+    StoreU32(bytes, value);
+    PutBytes(buffer, bytes, 4);
+}
+
+void PutWireI64(WireBuffer *buffer, long long value) {
+    PutWireU32(buffer, (unsigned)((unsigned long long)value >> 32));
+    PutWireU32(buffer, (unsigned)value);
+}
+
+void PutWireF64(WireBuffer *buffer, double value) {
+    long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutWireI64(buffer, bits);
+}
+
+void PutWireString(WireBuffer *buffer, const char *text) {
+    size_t length = strlen(text);
+    if (length > 0xffff) {
+        length = 0xffff;
+    }
+    PutWireU16(buffer, (unsigned)length);
+    PutBytes(buffer, text, length);
+}
+
+long PeekWireFrame(const unsigned char *data, size_t length, size_t maxPayload) {
+    if (length < WIRE_HEADER_LEN) {
+        return 0;
+    }
+    size_t payload = LoadU32(data);
+    if (payload > maxPayload) {
+        return -1;
+    }
+    return length - WIRE_HEADER_LEN >= payload ? (long)(WIRE_HEADER_LEN + payload) : 0;
+}
+
+void InitWireReader(WireReader *reader, const unsigned char *payload, size_t length) {
+    reader->data = payload;
+    reader->length = length;
+    reader->offset = 0;
+    reader->failed = false;
+}
+
+// The next size bytes, or NULL once the payload runs out
+static const unsigned char *TakeBytes(WireReader *reader, size_t size) {
+    if (reader->failed || reader->length - reader->offset < size) {
+        reader->failed = true;
+        return NULL;
+    }
+    const unsigned char *bytes = reader->data + reader->offset;
+    reader->offset += size;
+    return bytes;
+}
+
+unsigned GetWireU8(WireReader *reader) {
+    const unsigned char *bytes = TakeBytes(reader, 1);
+    return bytes != NULL ? bytes[0] : 0;
+}
+
+unsigned GetWireU16(WireReader *reader) {
+    const unsigned char *bytes = TakeBytes(reader, 2);
+    return bytes != NULL ? (unsigned)bytes[0] << 8 | bytes[1] : 0;
+}
+
+unsigned GetWireU32(WireReader *reader) {
+    const unsigned char *bytes = TakeBytes(reader, 4);
+    return bytes != NULL ? LoadU32(bytes) : 0;
+}
+
+long long GetWireI64(WireReader *reader) {
+    unsigned long long high = GetWireU32(reader);
+    unsigned long long low = GetWireU32(reader);
+    return (long long)(high << 32 | low);
+}
+
+double GetWireF64(WireReader *reader) {
+    long long bits = GetWireI64(reader);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void GetWireString(WireReader *reader, char *text, size_t capacity) {
+    size_t length = GetWireU16(reader);
+    const unsigned char *bytes = length < capacity ? TakeBytes(reader, length) : NULL;
+    if (bytes == NULL) {
+        reader->failed = true;
+        text[0] = '\0';
+        return;
+    }
+    memcpy(text, bytes, length);
+    text[length] = '\0';
+}
+
+bool IsWireReaderDone(const WireReader *reader) {
+    return !reader->failed && reader->offset == reader->length;
+}
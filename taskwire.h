@@ -0,0 +1,103 @@
+#ifndef TASKWIRE_H
+#define TASKWIRE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Requests bigger than this are rejected and the connection dropped, since
+// the stream can't be resynchronised past them
+#define WIRE_MAX_REQUEST 4096
+// Responses carry list pages, so they may be larger
+#define WIRE_MAX_RESPONSE (1 << 20)
+#define WIRE_HEADER_LEN 4
+
+// The task server's protocol. Every message is a frame: a 4-byte length,
+// then that many bytes of payload. A request's payload is an op byte and
+// its arguments; a response's is a status byte and, on WIRE_OK, its
+// results. Integers are big-endian and strings a 2-byte length then the
+// bytes, without a terminator. Responses come back in request order, so a
+// client may send any number of requests before reading.
+//
+//   REGISTER  username, password      ->                 (also logs in)
+//   LOGIN     username, password      ->
+//   ADD       title[ @DUE]            -> u32 id
+//   LIST      f64 afterRank,          -> u16 count, then per task:
+//             u32 afterId, u16 limit     u32 id, u8 completed, i64 dueAt,
+//                                        u32 repeatEvery, title;
+//                                        then f64 rank, u32 id to list after
+//   COMPLETE  u32 id                  ->
+//   DELETE    u32 id                  ->
+//
+// LIST starts after the (rank, id) key the previous page ended with, or at
+// the top when afterId is 0. The key needn't still be a task, so a delete
+// between pages doesn't lose the client's place. An f64 is the big-endian
+// bits of an IEEE double.
+typedef enum {
+    WIRE_REGISTER = 1,
+    WIRE_LOGIN,
+    WIRE_ADD,
+    WIRE_LIST,
+    WIRE_COMPLETE,
+    WIRE_DELETE
+} WireOp;
+
+typedef enum {
+    WIRE_OK,
+    WIRE_FAILED,         // Bad credentials, a taken username or no such task
+    WIRE_BAD_REQUEST,
+    WIRE_NOT_LOGGED_IN,
+    WIRE_BUSY            // Too much in flight, or the database gave up
+} WireStatus;
+
+// Growable byte buffer frames are built in and read from. failed sticks
+// once an allocation fails, so callers check it once at the end.
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} WireBuffer;
+
+// Reads the arguments out of one payload; failed sticks on the first read
+// past the end or string that doesn't fit
+typedef struct {
+    const unsigned char *data;
+    size_t length;
+    size_t offset;
+    bool failed;
+} WireReader;
+
+void InitWireBuffer(WireBuffer *buffer);
+void FreeWireBuffer(WireBuffer *buffer);
+// Room for at least size more bytes past length
+bool ReserveWireBuffer(WireBuffer *buffer, size_t size);
+// Drops the first size bytes
+void ConsumeWireBuffer(WireBuffer *buffer, size_t size);
+
+// Starts a frame and returns where; EndWireFrame fills in its length
+size_t BeginWireFrame(WireBuffer *buffer);
+void EndWireFrame(WireBuffer *buffer, size_t start);
+void PutWireU8(WireBuffer *buffer, unsigned value);
+void PutWireU16(WireBuffer *buffer, unsigned value);
+void PutWireU32(WireBuffer *buffer, unsigned value);
+void PutWireI64(WireBuffer *buffer, long long value);
+void PutWireF64(WireBuffer *buffer, double value);
+// Strings longer than a u16 are cut short
+void PutWireString(WireBuffer *buffer, const char *text);
+
+// Length of the frame at the front of data, header included: 0 while it
+// is still incomplete, -1 if its payload claims more than maxPayload
+long PeekWireFrame(const unsigned char *data, size_t length, size_t maxPayload);
+
+void InitWireReader(WireReader *reader, const unsigned char *payload, size_t length);
+unsigned GetWireU8(WireReader *reader);
+unsigned GetWireU16(WireReader *reader);
+unsigned GetWireU32(WireReader *reader);
+long long GetWireI64(WireReader *reader);
+double GetWireF64(WireReader *reader);
+// NUL-terminates into text; fails if it won't fit in capacity
+void GetWireString(WireReader *reader, char *text, size_t capacity);
+// Everything read and nothing left over
+bool IsWireReaderDone(const WireReader *reader);
+
+#endif
@@ -0,0 +1,197 @@
+#include "textcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The same spacing DrawText uses for the default font
+static float DefaultSpacing(int fontSize) {
+    return (float)((fontSize < 10 ? 10 : fontSize) / 10);
+}
+
+static float GlyphAdvance(Font font, int codepoint, float scale) {
+    int index = GetGlyphIndex(font, codepoint);
+    int advance = font.glyphs[index].advanceX;
+    return (advance != 0 ? (float)advance : font.recs[index].width) * scale;
+}
+
+static unsigned HashLayoutKey(const char *text, int fontSize, int maxWidth) {
+    unsigned hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    hash = (hash ^ (unsigned)fontSize) * 16777619u;
+    return (hash ^ (unsigned)maxWidth) * 16777619u;
+}
+
+static void FreeLayout(TextLayout *layout) {
+    free(layout->text);
+    free(layout->codepoints);
+    free(layout->offsets);
+    *layout = (TextLayout){0};
+}
+
+// Decode and place every glyph once, then cut the run at the last glyph
+// that still leaves room for the ellipsis
+static bool BuildLayout(TextLayout *layout, const char *text, unsigned hash, int fontSize, int maxWidth) {
+    size_t length = strlen(text);
+    int capacity = (int)length + (int)strlen(TEXT_ELLIPSIS);
+    *layout = (TextLayout){
+        .text = malloc(length + 1),
+        .hash = hash,
+        .fontSize = fontSize,
+        .maxWidth = maxWidth,
+        .codepoints = malloc(capacity * sizeof(int)),
+        .offsets = malloc((capacity + 1) * sizeof(float)),
+    };
+    if (layout->text == NULL || layout->codepoints == NULL || layout->offsets == NULL) {
+        FreeLayout(layout);
+        return false;
+    }
+    memcpy(layout->text, text, length + 1);
+
+    Font font = GetFontDefault();
+    float scale = (float)fontSize / font.baseSize;
+    float spacing = DefaultSpacing(fontSize);
+    float x = 0;
+    int count = 0;
+    for (size_t i = 0; i < length;) {
+        int size = 0;
+        int codepoint = GetCodepoint(text + i, &size);
+        i += size > 0 ? size : 1;
+        layout->codepoints[count] = codepoint;
+        layout->offsets[count] = x;
+        x += GlyphAdvance(font, codepoint, scale) + spacing;
+        count++;
+    }
+    layout->offsets[count] = x;
+    layout->fullWidth = count > 0 ? x - spacing : 0;
+    layout->width = layout->fullWidth;
+    layout->glyphCount = count;
+
+    if (maxWidth > 0 && layout->fullWidth > maxWidth) {
+        float dot = GlyphAdvance(font, '.', scale) + spacing;
+        int dots = (int)strlen(TEXT_ELLIPSIS);
+        float ellipsisWidth = dots * dot - spacing;
+        int keep = count;
+        while (keep > 0 && layout->offsets[keep] + ellipsisWidth > maxWidth) {
+            keep--;
+        }
+        while (keep > 0 && layout->codepoints[keep - 1] == ' ') {
+            keep--;
+        }
+        float start = layout->offsets[keep];
+        for (int i = 0; i < dots; i++) {
+            layout->codepoints[keep + i] = '.';
+            layout->offsets[keep + i] = start + i * dot;
+        }
+        layout->glyphCount = keep + dots;
+        layout->width = start + ellipsisWidth;
+        layout->truncated = true;
+    }
+    return true;
+}
+
+void InitTextCache(TextCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+void FreeTextCache(TextCache *cache) {
+    for (int i = 0; i < TEXT_CACHE_SLOTS; i++) {
+        FreeLayout(&cache->slots[i]);
+    }
+    FreeLayout(&cache->overflow);
+    cache->live = 0;
+}
+
+void BeginTextCacheFrame(TextCache *cache) {
+    cache->frame++;
+}
+
+static TextLayout *FindSlot(TextCache *cache, unsigned hash, const char *text, int fontSize, int maxWidth) {
+    unsigned index = hash & (TEXT_CACHE_SLOTS - 1);
+    for (;;) {
+        TextLayout *slot = &cache->slots[index];
+        if (slot->text == NULL ||
+            (slot->hash == hash && slot->fontSize == fontSize && slot->maxWidth == maxWidth && strcmp(slot->text, text) == 0)) {
+            return slot;
+        }
+        index = (index + 1) & (TEXT_CACHE_SLOTS - 1);
+    }
+}
+
+// Drop every layout not drawn this frame and re-probe the survivors
+static void SweepTextCache(TextCache *cache) {
+    TextLayout *survivors = malloc(cache->live * sizeof(TextLayout));
+    int kept = 0;
+    for (int i = 0; i < TEXT_CACHE_SLOTS; i++) {
+        TextLayout *slot = &cache->slots[i];
+        if (slot->text == NULL) {
+            continue;
+        }
+        if (slot->lastUsed == cache->frame && survivors != NULL) {
+            survivors[kept++] = *slot;
+        } else {
+            free(slot->text);
+            free(slot->codepoints);
+            free(slot->offsets);
+            cache->stats.evictions++;
+        }
+        *slot = (TextLayout){0};
+    }
+    for (int i = 0; i < kept; i++) {
+        *FindSlot(cache, survivors[i].hash, survivors[i].text, survivors[i].fontSize, survivors[i].maxWidth) = survivors[i];
+    }
+    cache->live = kept;
+    free(survivors);
+}
+
+const TextLayout *LayoutText(TextCache *cache, const char *text, int fontSize, int maxWidth) {
+    unsigned hash = HashLayoutKey(text, fontSize, maxWidth);
+    TextLayout *slot = FindSlot(cache, hash, text, fontSize, maxWidth);
+    if (slot->text != NULL) {
+        cache->stats.hits++;
+        slot->lastUsed = cache->frame;
+        return slot;
+    }
+
+    cache->stats.misses++;
+    if (cache->live >= TEXT_CACHE_MAX_LIVE) {
+        SweepTextCache(cache);
+        slot = FindSlot(cache, hash, text, fontSize, maxWidth);
+    }
+    if (cache->live >= TEXT_CACHE_MAX_LIVE) {
+        FreeLayout(&cache->overflow);
+        slot = &cache->overflow;
+    }
+    if (!BuildLayout(slot, text, hash, fontSize, maxWidth)) {
+        return NULL;
+    }
+    slot->lastUsed = cache->frame;
+    if (slot != &cache->overflow) {
+        cache->live++;
+    }
+    return slot;
+}
+
+void DrawTextLayout(const TextLayout *layout, int x, int y, Color color) {
+    if (layout == NULL) {
+        return;
+    }
+    Font font = GetFontDefault();
+    for (int i = 0; i < layout->glyphCount; i++) {
+        int codepoint = layout->codepoints[i];
+        if (codepoint != ' ' && codepoint != '\t') {
+            DrawTextCodepoint(font, codepoint, (Vector2){x + layout->offsets[i], (float)y}, (float)layout->fontSize, color);
+        }
+    }
+}
+
+void DrawCachedText(TextCache *cache, const char *text, int x, int y, int fontSize, int maxWidth, Color color) {
+    DrawTextLayout(LayoutText(cache, text, fontSize, maxWidth), x, y, color);
+}
+
+void PrintTextCacheStats(const TextCache *cache) {
+    long lookups = cache->stats.hits + cache->stats.misses;
+    printf("Text cache: %ld lookups, %.1f%% hits, %ld evictions, %d live layouts\n", lookups,
+           lookups > 0 ? 100.0 * cache->stats.hits / lookups : 0.0, cache->stats.evictions, cache->live);
+}
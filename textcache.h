@@ -0,0 +1,56 @@
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "raylib.h"
+#include <stdbool.h>
+
+#define TEXT_CACHE_SLOTS 1024 // Power of two
+#define TEXT_CACHE_MAX_LIVE (TEXT_CACHE_SLOTS * 3 / 4)
+#define TEXT_ELLIPSIS "..."
+
+// A string laid out once in the default font: its glyphs with their x
+// offsets, cut short with an ellipsis if it is wider than maxWidth
+typedef struct {
+    char *text;          // The key string; NULL for an empty slot
+    unsigned hash;
+    int fontSize;
+    int maxWidth;        // 0 for no limit
+    float width;         // Of the glyph run below
+    float fullWidth;     // Of the whole string
+    bool truncated;
+    int glyphCount;
+    int *codepoints;
+    float *offsets;
+    unsigned lastUsed;   // Frame stamp for eviction
+} TextLayout;
+
+typedef struct {
+    long hits;
+    long misses;
+    long evictions;
+} TextCacheStats;
+
+// Layouts keyed by (string, font size, max width). The key is the string's
+// contents, so an edited title simply misses and gets a new entry; entries
+// nobody drew in the current frame are swept out once the table fills up.
+typedef struct {
+    TextLayout slots[TEXT_CACHE_SLOTS];
+    TextLayout overflow; // Only used if one frame draws more than fits
+    int live;
+    unsigned frame;
+    TextCacheStats stats;
+} TextCache;
+
+void InitTextCache(TextCache *cache);
+void FreeTextCache(TextCache *cache);
+// Call once per drawn frame, before any LayoutText
+void BeginTextCacheFrame(TextCache *cache);
+// The returned layout stays valid until the next BeginTextCacheFrame, or
+// NULL if it couldn't be allocated
+const TextLayout *LayoutText(TextCache *cache, const char *text, int fontSize, int maxWidth);
+void DrawTextLayout(const TextLayout *layout, int x, int y, Color color);
+// LayoutText plus DrawTextLayout, for drop-in use where DrawText was
+void DrawCachedText(TextCache *cache, const char *text, int x, int y, int fontSize, int maxWidth, Color color);
+void PrintTextCacheStats(const TextCache *cache);
+
+#endif
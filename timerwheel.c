@@ -0,0 +1,113 @@
+#include "timerwheel.h"
+#include <stdlib.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+bool InitTimerWheel(TimerWheel *wheel, int capacity, long long now) {
+    *wheel = (TimerWheel){.capacity = capacity, .now = now};
+    wheel->timers = malloc(capacity * sizeof(Timer));
+    if (wheel->timers == NULL) {
+        return false;
+    }
+    ClearTimerWheel(wheel);
+    return true;
+}
+
+void FreeTimerWheel(TimerWheel *wheel) {
+    free(wheel->timers);
+    wheel->timers = NULL;
+    wheel->capacity = 0;
+    wheel->count = 0;
+}
+
+void ClearTimerWheel(TimerWheel *wheel) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            wheel->slots[level][slot] = -1;
+        }
+    }
+    for (int i = 0; i < wheel->capacity; i++) {
+        wheel->timers[i].next = i + 1 < wheel->capacity ? i + 1 : -1;
+    }
+    wheel->freeList = wheel->capacity > 0 ? 0 : -1;
+    wheel->count = 0;
+}
+
+// File a timer in the lowest level whose slots still tell at apart from
+// now. Past the span it goes to the furthest top-level slot and is filed
+// again when that slot cascades.
+static void FileTimer(TimerWheel *wheel, int index, long long at) {
+    long long delta = at - wheel->now;
+    if (delta >= TIMER_WHEEL_SPAN) {
+        at = wheel->now + TIMER_WHEEL_SPAN - 1;
+        delta = TIMER_WHEEL_SPAN - 1;
+    }
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= 1LL << (TIMER_WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    int *slot = &wheel->slots[level][(at >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+    wheel->timers[index].next = *slot;
+    *slot = index;
+}
+
+bool AddTimer(TimerWheel *wheel, int taskId, long long expires) {
+    int index = wheel->freeList;
+    if (index < 0) {
+        return false;
+    }
+    wheel->freeList = wheel->timers[index].next;
+    wheel->timers[index].expires = expires;
+    wheel->timers[index].taskId = taskId;
+    wheel->count++;
+    // The current tick has already been processed
+    FileTimer(wheel, index, expires > wheel->now ? expires : wheel->now + 1);
+    return true;
+}
+
+static void CascadeSlot(TimerWheel *wheel, int level, int slot) {
+    int index = wheel->slots[level][slot];
+    wheel->slots[level][slot] = -1;
+    while (index >= 0) {
+        int next = wheel->timers[index].next;
+        FileTimer(wheel, index, wheel->timers[index].expires);
+        wheel->cascaded++;
+        index = next;
+    }
+}
+
+// Higher levels go first, so a timer they hand down into the block that
+// starts now is cascaded again before level 0 expires
+static void ProcessTick(TimerWheel *wheel, TimerExpired expired, void *context) {
+    long long tick = wheel->now;
+    for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        if ((tick & ((1LL << (TIMER_WHEEL_BITS * level)) - 1)) == 0) {
+            CascadeSlot(wheel, level, (int)((tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK));
+        }
+    }
+
+    int *slot = &wheel->slots[0][tick & SLOT_MASK];
+    int index = *slot;
+    *slot = -1;
+    while (index >= 0) {
+        Timer timer = wheel->timers[index];
+        wheel->timers[index].next = wheel->freeList;
+        wheel->freeList = index;
+        wheel->count--;
+        wheel->fired++;
+        expired(timer.taskId, timer.expires, context);
+        index = timer.next;
+    }
+}
+
+void AdvanceTimerWheel(TimerWheel *wheel, long long now, TimerExpired expired, void *context) {
+    while (wheel->now < now) {
+        // Nothing to fire or cascade, so the clock can jump straight there
+        if (wheel->count == 0) {
+            wheel->now = now;
+            return;
+        }
+        wheel->now++;
+        ProcessTick(wheel, expired, context);
+    }
+}
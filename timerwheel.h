@@ -0,0 +1,50 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdbool.h>
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 3
+// Ticks the wheel can hold without clamping: 64^3 seconds is about three days
+#define TIMER_WHEEL_SPAN (1LL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+typedef struct {
+    long long expires; // Tick the timer fires on
+    int taskId;
+    int next;          // Next timer in the same slot, or in the free list; -1 ends
+} Timer;
+
+typedef void (*TimerExpired)(int taskId, long long expires, void *context);
+
+// Hierarchical timer wheel over a fixed pool of timers. Level 0 has a slot
+// per tick; each level above has slots TIMER_WHEEL_SLOTS times as wide, and
+// a slot is cascaded down a level when the ticks reach it. Adding a timer is
+// O(1) and every tick does O(1) work plus the timers it fires or cascades,
+// which is at most TIMER_WHEEL_LEVELS - 1 moves per timer over its life.
+// Timers can't be cancelled; owners check whether one still applies when
+// it fires.
+typedef struct {
+    Timer *timers;
+    int capacity;
+    int count;
+    int freeList;
+    int slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    long long now;     // Last tick processed
+    long fired;
+    long cascaded;
+} TimerWheel;
+
+bool InitTimerWheel(TimerWheel *wheel, int capacity, long long now);
+void FreeTimerWheel(TimerWheel *wheel);
+// Drops every timer; the clock is left where it is
+void ClearTimerWheel(TimerWheel *wheel);
+// False when the pool is full. Timers for a tick already processed fire on
+// the next one; ones further out than TIMER_WHEEL_SPAN are held at the top
+// level and re-filed as the wheel turns.
+bool AddTimer(TimerWheel *wheel, int taskId, long long expires);
+// Process every tick up to and including now, calling expired for each
+// timer that comes due, in tick order
+void AdvanceTimerWheel(TimerWheel *wheel, long long now, TimerExpired expired, void *context);
+
+#endif